@@ -243,6 +243,8 @@ class TBufferedTransport
   }
 
   void close() {
+    // Unread input belongs to the connection being closed
+    setReadBuffer(rBuf_.get(), 0);
     flush();
     transport_->close();
   }
@@ -371,6 +373,8 @@ class TFramedTransport
   }
 
   void close() {
+    // Unread input belongs to the connection being closed
+    setReadBuffer(rBuf_.get(), 0);
     flush();
     transport_->close();
   }
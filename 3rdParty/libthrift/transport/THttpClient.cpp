@@ -30,15 +30,19 @@ namespace apache { namespace thrift { namespace transport {
 using namespace std;
 
 THttpClient::THttpClient(boost::shared_ptr<TTransport> transport, std::string host, std::string path) :
-  THttpTransport(transport), host_(host), path_(path) {
+  THttpTransport(transport), host_(host), path_(path), acceptGzip_(true) {
 }
 
 THttpClient::THttpClient(string host, int port, string path) :
-  THttpTransport(boost::shared_ptr<TTransport>(new TSocket(host, port))), host_(host), path_(path) {
+  THttpTransport(boost::shared_ptr<TTransport>(new TSocket(host, port))), host_(host), path_(path), acceptGzip_(true) {
 }
 
 THttpClient::~THttpClient() {}
 
+void THttpClient::setAcceptGzip(bool accept) {
+  acceptGzip_ = accept;
+}
+
 void THttpClient::parseHeader(char* header) {
   char* colon = strchr(header, ':');
   if (colon == NULL) {
@@ -53,6 +57,22 @@ void THttpClient::parseHeader(char* header) {
   } else if (boost::istarts_with(header, "Content-Length")) {
     chunked_ = false;
     contentLength_ = atoi(value);
+  } else if (boost::istarts_with(header, "Content-Encoding")) {
+    // deflate means zlib wrapped, inflate tells both apart from gzip
+    if (boost::icontains(value, "gzip") || boost::icontains(value, "deflate")) {
+      compressed_ = true;
+    }
+  } else if (boost::istarts_with(header, "Connection")) {
+    if (boost::icontains(value, "close")) {
+      keepAlive_ = false;
+    } else if (boost::icontains(value, "keep-alive")) {
+      keepAlive_ = true;
+    }
+  } else if (boost::istarts_with(header, "Keep-Alive")) {
+    char* timeout = strstr(value, "timeout=");
+    if (timeout != NULL) {
+      serverIdleTimeout_ = atoi(timeout + strlen("timeout="));
+    }
   }
 }
 
@@ -67,6 +87,9 @@ bool THttpClient::parseStatusLine(char* status) {
   *code = '\0';
   while (*(code++) == ' ') {};
 
+  // HTTP/1.1 keeps the connection open unless told otherwise, 1.0 closes it
+  keepAlive_ = (strcmp(http, "HTTP/1.0") != 0);
+
   char* msg = strchr(code, ' ');
   if (msg == NULL) {
     throw TTransportException(string("Bad Status: ") + status);
@@ -85,6 +108,11 @@ bool THttpClient::parseStatusLine(char* status) {
 }
 
 void THttpClient::flush() {
+  // Don't send the request on a connection the server may have dropped already
+  if (isStale()) {
+    reconnect();
+  }
+
   // Fetch the contents of the write buffer
   uint8_t* buf;
   uint32_t len;
@@ -97,7 +125,12 @@ void THttpClient::flush() {
     "Host: " << host_ << CRLF <<
     "Content-Type: application/x-thrift" << CRLF <<
     "Content-Length: " << len << CRLF <<
-    "Accept: application/x-thrift" << CRLF <<
+    "Accept: application/x-thrift" << CRLF;
+  if (acceptGzip_) {
+    h << "Accept-Encoding: gzip" << CRLF;
+  }
+  h <<
+    "Connection: keep-alive" << CRLF <<
     "User-Agent: Thrift/" << VERSION << " (C++/THttpClient)" << CRLF <<
     CRLF;
   string header = h.str();
@@ -112,6 +145,7 @@ void THttpClient::flush() {
   // Reset the buffer and header variables
   writeBuffer_.resetBuffer();
   readHeaders_ = true;
+  responsePending_ = true;
 }
 
 }}} // apache::thrift::transport
@@ -34,10 +34,17 @@ class THttpClient : public THttpTransport {
 
   virtual void flush();
 
+  /**
+   * Ask the server for gzip compressed responses. On by default. Responses
+   * are decoded transparently, uncompressed ones are read as they are.
+   */
+  void setAcceptGzip(bool accept);
+
  protected:
 
   std::string host_;
   std::string path_;
+  bool acceptGzip_;
 
   virtual void parseHeader(char* header);
   virtual bool parseStatusLine(char* status);
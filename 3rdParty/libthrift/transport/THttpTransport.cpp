@@ -17,9 +17,18 @@
  * under the License.
  */
 
+#include <thrift-config.h>
+
+#include <algorithm>
 #include <sstream>
+#include <zlib.h>
+#ifdef HAVE_SYS_POLL_H
+#include <sys/poll.h>
+#endif
 
 #include <transport/THttpTransport.h>
+#include <transport/TSocket.h>
+#include <transport/PlatformSocket.h>
 
 namespace apache { namespace thrift { namespace transport {
 
@@ -28,6 +37,7 @@ using namespace std;
 // Yeah, yeah, hacky to put these here, I know.
 const char* THttpTransport::CRLF = "\r\n";
 const int THttpTransport::CRLF_LEN = 2;
+const uint32_t THttpTransport::CONTENT_SLICE_SIZE = 64 * 1024;
 
 THttpTransport::THttpTransport(boost::shared_ptr<TTransport> transport) :
   transport_(transport),
@@ -37,6 +47,17 @@ THttpTransport::THttpTransport(boost::shared_ptr<TTransport> transport) :
   chunkedDone_(false),
   chunkSize_(0),
   contentLength_(0),
+  contentRemaining_(0),
+  keepAlive_(true),
+  responsePending_(false),
+  responseRead_(false),
+  idleTimeout_(30),
+  serverIdleTimeout_(-1),
+  lastActivity_(0),
+  compressed_(false),
+  inflateStream_(NULL),
+  bodyBytesReceived_(0),
+  bodyBytesDecoded_(0),
   httpBuf_(NULL),
   httpPos_(0),
   httpBufLen_(0),
@@ -56,6 +77,36 @@ THttpTransport::~THttpTransport() {
   if (httpBuf_ != NULL) {
     std::free(httpBuf_);
   }
+  if (inflateStream_ != NULL) {
+    inflateEnd(inflateStream_);
+    delete inflateStream_;
+  }
+}
+
+void THttpTransport::open() {
+  transport_->open();
+  lastActivity_ = time(NULL);
+  responseRead_ = false;
+}
+
+void THttpTransport::setIdleTimeout(int seconds) {
+  idleTimeout_ = seconds;
+}
+
+int THttpTransport::getIdleTimeout() const {
+  return idleTimeout_;
+}
+
+uint64_t THttpTransport::getBodyBytesReceived() const {
+  return bodyBytesReceived_;
+}
+
+uint64_t THttpTransport::getBodyBytesDecoded() const {
+  return bodyBytesDecoded_;
+}
+
+void THttpTransport::setInterruptCheck(const boost::function<bool ()>& interruptCheck) {
+  interruptCheck_ = interruptCheck;
 }
 
 uint32_t THttpTransport::read(uint8_t* buf, uint32_t len) {
@@ -70,31 +121,54 @@ uint32_t THttpTransport::read(uint8_t* buf, uint32_t len) {
 }
 
 uint32_t THttpTransport::readEnd() {
-  // Read any pending chunked data (footers etc.)
+  // Read any pending chunked data (footers etc.), the next response on this
+  // connection starts right after it
   if (chunked_) {
     while (!chunkedDone_) {
       readChunked();
     }
+  } else if (!readHeaders_) {
+    while (contentRemaining_ > 0) {
+      readBuffer_.resetBuffer();
+      readMoreData();
+    }
   }
+  // Anything the protocol didn't consume still belongs to this response
+  readBuffer_.resetBuffer();
   return 0;
 }
 
 uint32_t THttpTransport::readMoreData() {
   uint32_t size;
 
-  // Get more data!
-  refill();
-
+  // No refill here: readLine() and readContent() go to the network only when
+  // the buffer runs dry. With keep-alive the rest of the response may already
+  // be buffered and the server won't send anything else until we ask again.
   if (readHeaders_) {
     readHeaders();
   }
 
-  if (chunked_) {
-    size = readChunked();
-  } else {
-    size = readContent(contentLength_);
-  }
-  readHeaders_ = true;
+  // A chunk of a compressed body doesn't necessarily decode to anything
+  // by itself, keep going until there is something to hand out
+  do {
+    if (chunked_) {
+      if (chunkedDone_) {
+        break;
+      }
+      readChunked();
+    } else {
+      uint32_t slice = std::min(contentRemaining_, CONTENT_SLICE_SIZE);
+      readContent(slice);
+      contentRemaining_ -= slice;
+      if (contentRemaining_ == 0) {
+        readHeaders_ = true;
+        endResponse();
+        break;
+      }
+    }
+  } while (readBuffer_.available_read() == 0);
+
+  size = readBuffer_.available_read();
   return size;
 }
 
@@ -120,6 +194,7 @@ void THttpTransport::readChunkedFooters() {
     char* line = readLine();
     if (strlen(line) == 0) {
       chunkedDone_ = true;
+      endResponse();
       break;
     }
   }
@@ -152,13 +227,63 @@ uint32_t THttpTransport::readContent(uint32_t size) {
     if (need < give) {
       give = need;
     }
-    readBuffer_.write((uint8_t*)(httpBuf_+httpPos_), give);
+    writeBody((uint8_t*)(httpBuf_+httpPos_), give);
     httpPos_ += give;
     need -= give;
   }
   return size;
 }
 
+void THttpTransport::writeBody(const uint8_t* data, uint32_t len) {
+  bodyBytesReceived_ += len;
+  if (!compressed_) {
+    readBuffer_.write(data, len);
+    bodyBytesDecoded_ += len;
+    return;
+  }
+
+  // Inflate straight into the read buffer, a few KB at a time
+  const uint32_t outSize = 16 * 1024;
+  inflateStream_->next_in = const_cast<Bytef*>(data);
+  inflateStream_->avail_in = len;
+  // Also go on while the output filled up, zlib may be holding back more
+  do {
+    inflateStream_->next_out = readBuffer_.getWritePtr(outSize);
+    inflateStream_->avail_out = outSize;
+    int rv = inflate(inflateStream_, Z_SYNC_FLUSH);
+    uint32_t got = outSize - inflateStream_->avail_out;
+    readBuffer_.wroteBytes(got);
+    bodyBytesDecoded_ += got;
+    if (rv == Z_STREAM_END) {
+      // Nothing valid follows the end of the stream
+      break;
+    }
+    if (rv != Z_OK && rv != Z_BUF_ERROR) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                std::string("Could not inflate response body: ") +
+                                (inflateStream_->msg != NULL ? inflateStream_->msg : "unknown error"));
+    }
+    if (got == 0 && rv == Z_BUF_ERROR) {
+      break;
+    }
+  } while (inflateStream_->avail_in > 0 || inflateStream_->avail_out == 0);
+}
+
+void THttpTransport::startInflate() {
+  if (inflateStream_ == NULL) {
+    inflateStream_ = new z_stream;
+    std::memset(inflateStream_, 0, sizeof(z_stream));
+    // 32 lets zlib detect gzip and zlib headers by itself
+    if (inflateInit2(inflateStream_, 32 + MAX_WBITS) != Z_OK) {
+      delete inflateStream_;
+      inflateStream_ = NULL;
+      throw TTransportException("Could not initialize zlib");
+    }
+  } else {
+    inflateReset(inflateStream_);
+  }
+}
+
 char* THttpTransport::readLine() {
   while (true) {
     char* eol = NULL;
@@ -195,6 +320,10 @@ void THttpTransport::shift() {
 }
 
 void THttpTransport::refill() {
+  if (interruptCheck_ && interruptCheck_()) {
+    throw TTransportException(TTransportException::INTERRUPTED, "Interrupted");
+  }
+
   uint32_t avail = httpBufSize_ - httpBufLen_;
   if (avail <= (httpBufSize_ / 4)) {
     httpBufSize_ *= 2;
@@ -220,6 +349,9 @@ void THttpTransport::readHeaders() {
   chunked_ = false;
   chunkedDone_ = false;
   chunkSize_ = 0;
+  keepAlive_ = true;
+  serverIdleTimeout_ = -1;
+  compressed_ = false;
 
   // Control state flow
   bool statusLine = true;
@@ -232,6 +364,10 @@ void THttpTransport::readHeaders() {
     if (strlen(line) == 0) {
       if (finished) {
         readHeaders_ = false;
+        contentRemaining_ = contentLength_;
+        if (compressed_) {
+          startInflate();
+        }
         return;
       } else {
         // Must have been an HTTP 100, keep going for another status line
@@ -252,6 +388,80 @@ void THttpTransport::write(const uint8_t* buf, uint32_t len) {
   writeBuffer_.write(buf, len);
 }
 
+void THttpTransport::endResponse() {
+  responsePending_ = false;
+  responseRead_ = true;
+  lastActivity_ = time(NULL);
+}
+
+bool THttpTransport::isStale() {
+  // An unfinished response leaves the connection at an unknown position
+  if (!transport_->isOpen() || !keepAlive_ || responsePending_) {
+    return true;
+  }
+  if (lastActivity_ != 0) {
+    int timeout = idleTimeout_;
+    // Leave a second of margin, so we don't send just as the server hangs up
+    if (serverIdleTimeout_ >= 0 && serverIdleTimeout_ - 1 < timeout) {
+      timeout = serverIdleTimeout_ - 1;
+    }
+    if (difftime(time(NULL), lastActivity_) >= timeout) {
+      return true;
+    }
+  }
+  // A new connection may be readable without the server closing it. TLS 1.3
+  // servers send their session tickets after the handshake, those are only
+  // consumed along with the first response.
+  return responseRead_ && peerClosed();
+}
+
+bool THttpTransport::peerClosed() {
+  boost::shared_ptr<TTransport> transport = transport_;
+  boost::shared_ptr<TBufferedTransport> buffered = boost::dynamic_pointer_cast<TBufferedTransport>(transport);
+  if (buffered) {
+    transport = buffered->getUnderlyingTransport();
+  }
+  boost::shared_ptr<TSocket> socket = boost::dynamic_pointer_cast<TSocket>(transport);
+  if (!socket) {
+    return false;
+  }
+
+  // Nothing is supposed to arrive between a response and the next request.
+  // If the socket is readable, it's the server closing (EOF, TLS close_notify)
+  // or an error.
+  struct THRIFT_POLLFD fds[1];
+  std::memset(fds, 0, sizeof(fds));
+  fds[0].fd = socket->getSocketFD();
+  fds[0].events = THRIFT_POLLIN;
+  return THRIFT_POLL(fds, 1, 0) != 0;
+}
+
+void THttpTransport::reconnect() {
+  try {
+    transport_->close();
+  } catch (const TTransportException&) {
+    // It's going away anyway
+  }
+
+  // Drop whatever was left over from the old connection
+  httpPos_ = 0;
+  httpBufLen_ = 0;
+  httpBuf_[httpBufLen_] = '\0';
+  readBuffer_.resetBuffer();
+  // A response may have been abandoned halfway, the next one starts afresh
+  readHeaders_ = true;
+  chunked_ = false;
+  chunkedDone_ = false;
+  contentLength_ = 0;
+  contentRemaining_ = 0;
+  keepAlive_ = true;
+  responsePending_ = false;
+  serverIdleTimeout_ = -1;
+  compressed_ = false;
+
+  open();
+}
+
 const std::string THttpTransport::getOrigin() {
   std::ostringstream oss;
   if ( !origin_.empty()) {
@@ -20,9 +20,15 @@
 #ifndef _THRIFT_TRANSPORT_THTTPTRANSPORT_H_
 #define _THRIFT_TRANSPORT_THTTPTRANSPORT_H_ 1
 
+#include <ctime>
+
+#include <boost/function.hpp>
+
 #include <transport/TBufferTransports.h>
 #include <transport/TVirtualTransport.h>
 
+struct z_stream_s;
+
 namespace apache { namespace thrift { namespace transport {
 
 /**
@@ -38,9 +44,7 @@ class THttpTransport : public TVirtualTransport<THttpTransport> {
 
   virtual ~THttpTransport();
 
-  void open() {
-    transport_->open();
-  }
+  void open();
 
   bool isOpen() {
     return transport_->isOpen();
@@ -64,6 +68,30 @@ class THttpTransport : public TVirtualTransport<THttpTransport> {
 
   virtual const std::string getOrigin();
 
+  /**
+   * Seconds a kept-alive connection may sit idle before the next request
+   * opens a new one instead. Servers drop idle connections on their own
+   * schedule, a shorter Keep-Alive timeout announced by the server wins.
+   * 0 opens a new connection for every request.
+   */
+  void setIdleTimeout(int seconds);
+  int getIdleTimeout() const;
+
+  /**
+   * Response body bytes as they came over the wire and after decoding a
+   * compressed Content-Encoding, summed over all responses.
+   */
+  uint64_t getBodyBytesReceived() const;
+  uint64_t getBodyBytesDecoded() const;
+
+  /**
+   * Asked before every read from the network. If it returns true, reading
+   * the response is given up with a TTransportException of type INTERRUPTED.
+   * The rest of the response is never read, so the next request goes out
+   * on a new connection. Called from the thread reading the response.
+   */
+  void setInterruptCheck(const boost::function<bool ()>& interruptCheck);
+
  protected:
 
   boost::shared_ptr<TTransport> transport_;
@@ -77,6 +105,27 @@ class THttpTransport : public TVirtualTransport<THttpTransport> {
   bool chunkedDone_;
   uint32_t chunkSize_;
   uint32_t contentLength_;
+  // Body bytes of a response with Content-Length not read from the network yet
+  uint32_t contentRemaining_;
+
+  // Connection reuse. keepAlive_ and serverIdleTimeout_ are taken from the
+  // last response, lastActivity_ is when it was read completely.
+  // responseRead_ tells whether a response came over this connection yet.
+  bool keepAlive_;
+  bool responsePending_;
+  bool responseRead_;
+  int idleTimeout_;
+  int serverIdleTimeout_;
+  time_t lastActivity_;
+
+  // The current response body is gzip or deflate encoded and goes through
+  // inflateStream_ on its way into readBuffer_
+  bool compressed_;
+  struct z_stream_s* inflateStream_;
+  uint64_t bodyBytesReceived_;
+  uint64_t bodyBytesDecoded_;
+
+  boost::function<bool ()> interruptCheck_;
 
   char* httpBuf_;
   uint32_t httpPos_;
@@ -97,12 +146,22 @@ class THttpTransport : public TVirtualTransport<THttpTransport> {
   uint32_t parseChunkSize(char* line);
 
   uint32_t readContent(uint32_t size);
+  void writeBody(const uint8_t* data, uint32_t len);
+  void startInflate();
 
   void refill();
   void shift();
 
+  void endResponse();
+  bool isStale();
+  bool peerClosed();
+  void reconnect();
+
   static const char* CRLF;
   static const int CRLF_LEN;
+  // Most body bytes taken from the network per readMoreData() for a response
+  // with Content-Length, so a large body never has to fit into memory at once
+  static const uint32_t CONTENT_SLICE_SIZE;
 };
 
 }}} // apache::thrift::transport
@@ -136,7 +136,8 @@ static bool matchName(const char* host, const char* pattern, int size);
 static char uppercase(char c);
 
 // SSLContext implementation
-SSLContext::SSLContext(const SSLProtocol& protocol) {
+SSLContext::SSLContext(const SSLProtocol& protocol):
+  fullHandshakes_(0), resumedHandshakes_(0) {
   if(protocol == SSLTLS)
   {
     ctx_ = SSL_CTX_new(SSLv23_method());
@@ -175,9 +176,18 @@ SSLContext::SSLContext(const SSLProtocol& protocol) {
   {
     SSL_CTX_set_options(ctx_, SSL_OP_NO_SSLv2);
   }
+
+  // Hand client sessions to newSessionCallback(), for restoreSession()
+  SSL_CTX_set_app_data(ctx_, this);
+  SSL_CTX_set_session_cache_mode(ctx_, SSL_CTX_get_session_cache_mode(ctx_) | SSL_SESS_CACHE_CLIENT);
+  SSL_CTX_sess_set_new_cb(ctx_, newSessionCallback);
 }
 
 SSLContext::~SSLContext() {
+  for (std::map<string, SSL_SESSION*>::iterator it = sessions_.begin(); it != sessions_.end(); ++it) {
+    SSL_SESSION_free(it->second);
+  }
+  sessions_.clear();
   if (ctx_ != NULL) {
     SSL_CTX_free(ctx_);
     ctx_ = NULL;
@@ -194,6 +204,64 @@ SSL* SSLContext::createSSL() {
   return ssl;
 }
 
+void SSLContext::restoreSession(SSL* ssl, const string& peer) {
+  Guard guard(mutex_);
+  std::map<string, SSL_SESSION*>::iterator it = sessions_.find(peer);
+  if (it != sessions_.end()) {
+    SSL_set_session(ssl, it->second);
+  }
+}
+
+void SSLContext::storeSession(const string& peer, SSL_SESSION* session) {
+  Guard guard(mutex_);
+  SSL_SESSION*& stored = sessions_[peer];
+  if (stored != NULL) {
+    SSL_SESSION_free(stored);
+  }
+  stored = session;
+}
+
+void SSLContext::removeSession(const string& peer) {
+  Guard guard(mutex_);
+  std::map<string, SSL_SESSION*>::iterator it = sessions_.find(peer);
+  if (it != sessions_.end()) {
+    SSL_SESSION_free(it->second);
+    sessions_.erase(it);
+  }
+}
+
+void SSLContext::countHandshake(bool resumed) {
+  Guard guard(mutex_);
+  if (resumed) {
+    resumedHandshakes_++;
+  } else {
+    fullHandshakes_++;
+  }
+}
+
+uint64_t SSLContext::fullHandshakes() const {
+  Guard guard(mutex_);
+  return fullHandshakes_;
+}
+
+uint64_t SSLContext::resumedHandshakes() const {
+  Guard guard(mutex_);
+  return resumedHandshakes_;
+}
+
+// Called by OpenSSL whenever the server hands out a session, at the end of
+// the handshake or, with TLS 1.3, any time later as a ticket.
+int SSLContext::newSessionCallback(SSL* ssl, SSL_SESSION* session) {
+  SSLContext* context = (SSLContext*)SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+  TSSLSocket* socket = (TSSLSocket*)SSL_get_app_data(ssl);
+  if (context == NULL || socket == NULL || socket->server()) {
+    return 0;
+  }
+  // Returning 1 keeps the reference OpenSSL passed to us
+  context->storeSession(socket->sessionKey(), session);
+  return 1;
+}
+
 // TSSLSocket implementation
 TSSLSocket::TSSLSocket(boost::shared_ptr<SSLContext> ctx):
   TSocket(), server_(false), ssl_(NULL), ctx_(ctx) {
@@ -334,10 +402,12 @@ void TSSLSocket::checkHandshake() {
   }
   ssl_ = ctx_->createSSL();
   SSL_set_fd(ssl_, socket_);
+  SSL_set_app_data(ssl_, this);
   int rc;
   if (server()) {
     rc = SSL_accept(ssl_);
   } else {
+    ctx_->restoreSession(ssl_, sessionKey());
     rc = SSL_connect(ssl_);
   }
   if (rc <= 0) {
@@ -345,11 +415,20 @@ void TSSLSocket::checkHandshake() {
     string fname(server() ? "SSL_accept" : "SSL_connect");
     string errors;
     buildErrors(errors, errno_copy);
+    if (!server()) {
+      // Don't offer that session again, in case it was the problem
+      ctx_->removeSession(sessionKey());
+    }
     throw TSSLException(fname + ": " + errors);
   }
+  ctx_->countHandshake(SSL_session_reused(ssl_) != 0);
 //  authorize();
 }
 
+string TSSLSocket::sessionKey() {
+  return getHost() + ":" + boost::lexical_cast<string>(getPort());
+}
+
 void TSSLSocket::authorize() {
   int rc = SSL_get_verify_result(ssl_);
   if (rc != X509_V_OK) {  // verify authentication result
@@ -483,6 +562,14 @@ TSSLSocketFactory::~TSSLSocketFactory() {
   }
 }
 
+uint64_t TSSLSocketFactory::fullHandshakes() const {
+  return ctx_->fullHandshakes();
+}
+
+uint64_t TSSLSocketFactory::resumedHandshakes() const {
+  return ctx_->resumedHandshakes();
+}
+
 boost::shared_ptr<TSSLSocket> TSSLSocketFactory::createSocket() {
   boost::shared_ptr<TSSLSocket> ssl(new TSSLSocket(ctx_));
   setup(ssl);
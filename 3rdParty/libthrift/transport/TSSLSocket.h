@@ -20,6 +20,7 @@
 #ifndef _THRIFT_TRANSPORT_TSSLSOCKET_H_
 #define _THRIFT_TRANSPORT_TSSLSOCKET_H_ 1
 
+#include <map>
 #include <string>
 #include <boost/shared_ptr.hpp>
 #include <openssl/ssl.h>
@@ -120,12 +121,17 @@ protected:
    * Initiate SSL handshake if not already initiated.
    */
   void checkHandshake();
+  /**
+   * Key of the peer in the SSLContext's session cache.
+   */
+  std::string sessionKey();
 
   bool server_;
   SSL* ssl_;
   boost::shared_ptr<SSLContext> ctx_;
   boost::shared_ptr<AccessManager> access_;
   friend class TSSLSocketFactory;
+  friend class SSLContext;
 };
 
 /**
@@ -221,6 +227,12 @@ class TSSLSocketFactory {
   static void setManualOpenSSLInitialization(bool manualOpenSSLInitialization) {
     manualOpenSSLInitialization_ = manualOpenSSLInitialization;
   }
+  /**
+   * Number of handshakes done by sockets of this factory, either negotiating
+   * a new session or resuming an earlier one.
+   */
+  uint64_t fullHandshakes() const;
+  uint64_t resumedHandshakes() const;
  protected:
   boost::shared_ptr<SSLContext> ctx_;
 
@@ -268,8 +280,28 @@ class SSLContext {
   virtual ~SSLContext();
   SSL* createSSL();
   SSL_CTX* get() { return ctx_; }
+
+  /**
+   * Client side session cache. The last session negotiated with a peer
+   * ("host:port") is kept, by session ID or ticket, and offered again by the
+   * next socket connecting there, so reconnects can skip the full handshake.
+   */
+  void restoreSession(SSL* ssl, const std::string& peer);
+  void storeSession(const std::string& peer, SSL_SESSION* session);
+  void removeSession(const std::string& peer);
+
+  void countHandshake(bool resumed);
+  uint64_t fullHandshakes() const;
+  uint64_t resumedHandshakes() const;
  private:
   SSL_CTX* ctx_;
+
+  mutable concurrency::Mutex mutex_;
+  std::map<std::string, SSL_SESSION*> sessions_;
+  uint64_t fullHandshakes_;
+  uint64_t resumedHandshakes_;
+
+  static int newSessionCallback(SSL* ssl, SSL_SESSION* session);
 };
 
 /**
@@ -20,6 +20,7 @@
  */
 
 #include "evernoteconnection.h"
+#include "notesstoreconnection.h"
 #include "jobs/evernotejob.h"
 #include "logging.h"
 
@@ -55,20 +56,32 @@ EvernoteConnection* EvernoteConnection::s_instance = 0;
 QString EDAM_CLIENT_NAME = QStringLiteral("Reminders/0.4; Ubuntu/14.10");
 QString EDAM_USER_STORE_PATH = QStringLiteral("/edam/user");
 
+// Evernote counts the calls of an API key per user and hour
+static const int s_rateLimitWindowSecs = 3600;
+
 EvernoteConnection::EvernoteConnection(QObject *parent) :
     QObject(parent),
     m_useSSL(true),
     m_isConnected(false),
-    m_currentJob(0),
-    m_notesStoreClient(0),
-    m_notesStoreHttpClient(0),
+    m_duplicateJobCount(0),
+    m_requestBucket(50, 0),
+    m_connectionCount(3),
     m_userstoreClient(0),
     m_userStoreHttpClient(0)
 {
     qRegisterMetaType<EvernoteConnection::ErrorCode>("EvernoteConnection::ErrorCode");
 
+    // One worker per NoteStore connection, see setupNotesStore()
+    m_jobPool.setExpiryTimeout(-1);
+
     m_reconnectTimer.setSingleShot(true);
     connect(&m_reconnectTimer, &QTimer::timeout, this, &EvernoteConnection::connectToEvernote);
+
+    m_rateLimitTimer.setSingleShot(true);
+    connect(&m_rateLimitTimer, &QTimer::timeout, this, &EvernoteConnection::startJobQueue);
+    m_throttleTimer.setSingleShot(true);
+    connect(&m_throttleTimer, &QTimer::timeout, this, &EvernoteConnection::startJobQueue);
+    m_requestClock.start();
 }
 
 void EvernoteConnection::setupUserStore()
@@ -81,8 +94,10 @@ void EvernoteConnection::setupUserStore()
     boost::shared_ptr<TSocket> socket;
 
     if (m_useSSL) {
-        boost::shared_ptr<TSSLSocketFactory> sslSocketFactory(new TSSLSocketFactory());
-        socket = sslSocketFactory->createSocket(m_hostname.toStdString(), 443);
+        if (!m_sslSocketFactory) {
+            m_sslSocketFactory = boost::shared_ptr<TSSLSocketFactory>(new TSSLSocketFactory());
+        }
+        socket = m_sslSocketFactory->createSocket(m_hostname.toStdString(), 443);
         qCDebug(dcConnection) << "created UserStore SSL socket to host " << m_hostname;
     } else {
         // Create a non-secure socket
@@ -102,31 +117,22 @@ void EvernoteConnection::setupUserStore()
 
 void EvernoteConnection::setupNotesStore()
 {
-    if (m_notesStoreClient != 0) {
-        delete m_notesStoreClient;
-        m_notesStoreHttpClient.reset();
+    // Jobs still running from before a reconnect hold on to their connection. They finish
+    // in the background, the connection goes away once its job is done.
+    foreach (NotesStoreConnection *connection, m_notesStoreConnections) {
+        if (connection->job()) {
+            qCDebug(dcConnection) << "Retiring connection still in use by:" << connection->job()->toString();
+            m_retiredConnections.append(connection);
+        } else {
+            delete connection;
+        }
     }
+    m_notesStoreConnections.clear();
 
-    boost::shared_ptr<TSocket> socket;
-
-    if (m_useSSL) {
-        boost::shared_ptr<TSSLSocketFactory> sslSocketFactory(new TSSLSocketFactory());
-        socket = sslSocketFactory->createSocket(m_hostname.toStdString(), 443);
-        qCDebug(dcConnection) << "created NotesStore SSL socket to host " << m_hostname;
-    } else {
-        // Create a non-secure socket
-        socket = boost::shared_ptr<TSocket> (new TSocket(m_hostname.toStdString(), 80));
-        qCDebug(dcConnection) << "created insecure NotesStore socket to host " << m_hostname;
+    for (int i = 0; i < m_connectionCount; i++) {
+        m_notesStoreConnections.append(new NotesStoreConnection(m_hostname, m_notesStorePath, m_sslSocketFactory));
     }
-
-    // setup NotesStore client
-    boost::shared_ptr<TBufferedTransport> bufferedTransport(new TBufferedTransport(socket));
-    m_notesStoreHttpClient = boost::shared_ptr<THttpClient>(new THttpClient(bufferedTransport,
-                                                                        m_hostname.toStdString(),
-                                                                        m_notesStorePath.toStdString()));
-
-    boost::shared_ptr<TProtocol> notesstoreiprot(new TBinaryProtocol(m_notesStoreHttpClient));
-    m_notesStoreClient = new evernote::edam::NoteStoreClient(notesstoreiprot);
+    m_jobPool.setMaxThreadCount(m_connectionCount + m_retiredConnections.count());
 }
 
 EvernoteConnection *EvernoteConnection::instance()
@@ -139,14 +145,14 @@ EvernoteConnection *EvernoteConnection::instance()
 
 EvernoteConnection::~EvernoteConnection()
 {
+    // The running job still uses the clients
+    m_jobPool.waitForDone();
     if (m_userstoreClient) {
         delete m_userstoreClient;
         m_userStoreHttpClient.reset();
     }
-    if (m_notesStoreClient) {
-        delete m_notesStoreClient;
-        m_notesStoreHttpClient.reset();
-    }
+    qDeleteAll(m_notesStoreConnections);
+    qDeleteAll(m_retiredConnections);
 }
 
 void EvernoteConnection::disconnectFromEvernote()
@@ -161,31 +167,23 @@ void EvernoteConnection::disconnectFromEvernote()
         return;
     }
 
-    foreach (EvernoteJob *job, m_highPriorityJobQueue) {
+    foreach (EvernoteJob *job, m_jobQueue.takeAll()) {
         job->emitJobDone(EvernoteConnection::ErrorCodeConnectionLost, "Disconnected from Evernote");
         job->deleteLater();
     }
-    m_highPriorityJobQueue.clear();
-
-    foreach (EvernoteJob *job, m_mediumPriorityJobQueue) {
-        job->emitJobDone(EvernoteConnection::ErrorCodeConnectionLost, "Disconnected from Evernote");
-        job->deleteLater();
-    }
-    m_mediumPriorityJobQueue.clear();
-
-    foreach (EvernoteJob *job, m_lowPriorityJobQueue) {
-        job->emitJobDone(EvernoteConnection::ErrorCodeConnectionLost, "Disconnected from Evernote");
-        job->deleteLater();
-    }
-    m_lowPriorityJobQueue.clear();
+    m_rateLimitTimer.stop();
+    m_throttleTimer.stop();
 
     m_errorMessage.clear();
     emit errorChanged();
 
     try {
-        m_notesStoreHttpClient->close();
+        foreach (NotesStoreConnection *connection, m_notesStoreConnections) {
+            connection->close();
+        }
         m_userStoreHttpClient->close();
     } catch (...) {}
+    qCDebug(dcConnection) << "TLS handshakes:" << fullTlsHandshakes() << "full," << resumedTlsHandshakes() << "resumed";
     emit isConnectedChanged();
 }
 
@@ -369,13 +367,9 @@ bool EvernoteConnection::connectUserStore()
 
 bool EvernoteConnection::connectNotesStore()
 {
-    if (m_notesStoreHttpClient->isOpen()) {
-        m_notesStoreHttpClient->close();
-    }
-
+    // Open the first one to see if we can reach the server. The others open when first used.
     try {
-        m_notesStoreHttpClient->open();
-        qCDebug(dcConnection) << "NotesStoreClient socket opened." << m_notesStoreHttpClient->isOpen();
+        m_notesStoreConnections.first()->open();
         return true;
 
     } catch (const TTransportException & e) {
@@ -393,39 +387,19 @@ bool EvernoteConnection::connectNotesStore()
 void EvernoteConnection::attachDuplicate(EvernoteJob *original, EvernoteJob *duplicate)
 {
     if (duplicate->originatingObject() && duplicate->originatingObject() != original->originatingObject()) {
-        duplicate->attachToDuplicate(m_currentJob);
+        duplicate->attachToDuplicate(original);
     }
     connect(original, &EvernoteJob::jobFinished, duplicate, &EvernoteJob::deleteLater);
 }
 
-EvernoteJob* EvernoteConnection::findExistingDuplicate(EvernoteJob *job)
+void EvernoteConnection::supersede(EvernoteJob *job, EvernoteJob *superseded)
 {
-    qCDebug(dcJobQueue) << "Length:"
-                        << m_highPriorityJobQueue.count() + m_mediumPriorityJobQueue.count() + m_lowPriorityJobQueue.count()
-                        << "(High:" << m_highPriorityJobQueue.count() << "Medium:" << m_mediumPriorityJobQueue.count() << "Low:" << m_lowPriorityJobQueue.count() << ")";
-
-    foreach (EvernoteJob *queuedJob, m_highPriorityJobQueue) {
-        // explicitly use custom operator==()
-        if (job->operator ==(queuedJob)) {
-            qCDebug(dcJobQueue) << "Found duplicate in high priority queue";
-            return queuedJob;
-        }
-    }
-    foreach (EvernoteJob *queuedJob, m_mediumPriorityJobQueue) {
-        // explicitly use custom operator==()
-        if (job->operator ==(queuedJob)) {
-            qCDebug(dcJobQueue) << "Found duplicate in medium priority queue";
-            return queuedJob;
-        }
-    }
-    foreach (EvernoteJob *queuedJob, m_lowPriorityJobQueue) {
-        // explicitly use custom operator==()
-        if (job->operator ==(queuedJob)) {
-            qCDebug(dcJobQueue) << "Found duplicate in low priority queue";
-            return queuedJob;
-        }
-    }
-    return nullptr;
+    // Unlike a duplicate, the superseded job reports the result in any case. Whoever queued
+    // it waits for an answer to each save.
+    disconnect(superseded, 0, this, 0);
+    superseded->attachToDuplicate(job);
+    // Finishing it lets jobs superseded by it in turn finish as well
+    connect(job, &EvernoteJob::jobFinished, superseded, &EvernoteJob::jobFinished);
 }
 
 void EvernoteConnection::enqueue(EvernoteJob *job)
@@ -436,58 +410,40 @@ void EvernoteConnection::enqueue(EvernoteJob *job)
         job->deleteLater();
         return;
     }
-    if (m_currentJob && m_currentJob->operator ==(job)) {
-        qCDebug(dcJobQueue) << "Duplicate of new job request already running:" << job->toString();
-        if (m_currentJob->isFinished()) {
-            qCWarning(dcJobQueue) << "Job seems to be stuck in a loop. Deleting it:" << job->toString();
-            job->deleteLater();
-        } else {
-            attachDuplicate(m_currentJob, job);
+    foreach (NotesStoreConnection *connection, m_notesStoreConnections) {
+        EvernoteJob *runningJob = connection->job();
+        // A cancelled one won't deliver a result any more, the new request has to run by itself
+        if (runningJob && !runningJob->isCancelled() && runningJob->operator ==(job)) {
+            qCDebug(dcJobQueue) << "Duplicate of new job request already running:" << job->toString();
+            if (runningJob->isFinished()) {
+                qCWarning(dcJobQueue) << "Job seems to be stuck in a loop. Deleting it:" << job->toString();
+                job->deleteLater();
+            } else {
+                m_duplicateJobCount++;
+                attachDuplicate(runningJob, job);
+            }
+            return;
         }
-        return;
     }
 
-    EvernoteJob *existingJob = findExistingDuplicate(job);
+    EvernoteJob *existingJob = m_jobQueue.findDuplicate(job);
     if (existingJob) {
         qCDebug(dcJobQueue) << "Duplicate job already queued:" << job->toString();
+        m_duplicateJobCount++;
         attachDuplicate(existingJob, job);
-        // reprioritze the repeated request
-        if (job->jobPriority() == EvernoteJob::JobPriorityHigh) {
-            qCDebug(dcJobQueue) << "Reprioritising duplicate job in high priority queue:" << job->toString();
+        // reprioritze the repeated request, unless the queued one is more important already
+        if (job->jobPriority() <= existingJob->jobPriority()) {
+            qCDebug(dcJobQueue) << "Reprioritising duplicate job with priority" << job->jobPriority() << ":" << job->toString();
             existingJob->setJobPriority(job->jobPriority());
-            if (m_highPriorityJobQueue.contains(existingJob)) {
-                m_highPriorityJobQueue.prepend(m_highPriorityJobQueue.takeAt(m_highPriorityJobQueue.indexOf(existingJob)));
-            } else if (m_mediumPriorityJobQueue.contains(existingJob)){
-                m_highPriorityJobQueue.prepend(m_mediumPriorityJobQueue.takeAt(m_mediumPriorityJobQueue.indexOf(existingJob)));
-            } else {
-                m_highPriorityJobQueue.prepend(m_lowPriorityJobQueue.takeAt(m_lowPriorityJobQueue.indexOf(existingJob)));
-            }
-        } else if (job->jobPriority() == EvernoteJob::JobPriorityMedium){
-            if (m_mediumPriorityJobQueue.contains(existingJob)) {
-                qCDebug(dcJobQueue) << "Reprioritising duplicate job in medium priority queue:" << job->toString();
-                m_mediumPriorityJobQueue.prepend(m_mediumPriorityJobQueue.takeAt(m_mediumPriorityJobQueue.indexOf(existingJob)));
-            } else if (m_lowPriorityJobQueue.contains(existingJob)) {
-                m_mediumPriorityJobQueue.prepend(m_lowPriorityJobQueue.takeAt(m_lowPriorityJobQueue.indexOf(existingJob)));
-            }
-        } else if (job->jobPriority() == EvernoteJob::JobPriorityLow) {
-            if (m_lowPriorityJobQueue.contains(existingJob)) {
-                qCDebug(dcJobQueue) << "Reprioritising duplicate job in low priority queue:" << job->toString();
-                m_lowPriorityJobQueue.prepend(m_lowPriorityJobQueue.takeAt(m_lowPriorityJobQueue.indexOf(existingJob)));
-            }
+            m_jobQueue.requeue(existingJob);
         }
     } else {
         connect(job, &EvernoteJob::jobFinished, job, &EvernoteJob::deleteLater);
         connect(job, &EvernoteJob::jobFinished, this, &EvernoteConnection::startNextJob);
-        if (job->jobPriority() == EvernoteJob::JobPriorityHigh) {
-            qCDebug(dcJobQueue) << "Adding high priority job request:" << job->toString();
-            m_highPriorityJobQueue.prepend(job);
-        } else if (job->jobPriority() == EvernoteJob::JobPriorityMedium){
-            qCDebug(dcJobQueue) << "Adding medium priority job request:" << job->toString();
-            m_mediumPriorityJobQueue.prepend(job);
-        } else {
-            qCDebug(dcJobQueue) << "Adding low priority job request:" << job->toString();
-            m_lowPriorityJobQueue.prepend(job);
-        }
+        connect(job, &EvernoteJob::rateLimitReached, this, &EvernoteConnection::jobRateLimited);
+        qCDebug(dcJobQueue) << "Adding job request with priority" << job->jobPriority() << ":" << job->toString();
+        m_jobQueue.enqueue(job);
+        qCDebug(dcJobQueue) << "Queue length:" << m_jobQueue.count() << "Duplicates so far:" << m_duplicateJobCount;
         startJobQueue();
     }
 }
@@ -502,17 +458,59 @@ void EvernoteConnection::enqueueWrite(EvernoteJob *job)
     }
     connect(job, &EvernoteJob::jobFinished, job, &EvernoteJob::deleteLater);
     connect(job, &EvernoteJob::jobFinished, this, &EvernoteConnection::startNextJob);
+    connect(job, &EvernoteJob::rateLimitReached, this, &EvernoteConnection::jobRateLimited);
+    job->m_write = true;
+
+    // Saving the same object again while the previous save is still waiting: upload the
+    // newest state only. Queue it last, it may depend on writes queued in the meantime.
+    for (int i = 0; i < m_writeJobQueue.count(); i++) {
+        EvernoteJob *queuedJob = m_writeJobQueue.at(i);
+        if (job->supersedes(queuedJob)) {
+            qCDebug(dcJobQueue) << "Replacing queued write:" << queuedJob->toString();
+            m_writeJobQueue.removeAt(i);
+            m_duplicateJobCount++;
+            supersede(job, queuedJob);
+            break;
+        }
+    }
     m_writeJobQueue.append(job);
     startJobQueue();
 }
 
+int EvernoteConnection::cancel(const QString &guid, int priority)
+{
+    int count = 0;
+    foreach (EvernoteJob *job, m_jobQueue.jobs()) {
+        if (job->guid() != guid || job->jobPriority() < priority) {
+            continue;
+        }
+        qCDebug(dcJobQueue) << "Dropping cancelled job:" << job->toString();
+        m_jobQueue.remove(job);
+        job->cancel();
+        job->emitJobDone(ErrorCodeCancelled, QStringLiteral("Cancelled."));
+        // Never started, finish it here so duplicates attached to it go away with it
+        disconnect(job, 0, this, 0);
+        emit job->jobFinished();
+        count++;
+    }
+
+    foreach (NotesStoreConnection *connection, m_notesStoreConnections + m_retiredConnections) {
+        EvernoteJob *job = connection->job();
+        if (job && !job->m_write && job->guid() == guid && job->jobPriority() >= priority) {
+            qCDebug(dcJobQueue) << "Cancelling running job:" << job->toString();
+            job->cancel();
+            count++;
+        }
+    }
+    return count;
+}
+
 bool EvernoteConnection::isConnected() const
 {
     return m_userstoreClient != nullptr &&
             m_userStoreHttpClient->isOpen() &&
-            m_notesStoreClient != nullptr &&
-// The notesstoreHttpClient wont stay open for some reason, but still seems to work... ignore it...
-//            m_notesStoreHttpClient->isOpen() &&
+            !m_notesStoreConnections.isEmpty() &&
+            // NoteStore connections may be closed while idle, THttpClient reopens them on the next request
             !m_token.isEmpty();
 }
 
@@ -521,34 +519,192 @@ QString EvernoteConnection::error() const
     return m_errorMessage;
 }
 
-void EvernoteConnection::startJobQueue()
+int EvernoteConnection::connectionCount() const
 {
-    if (m_currentJob) {
-        return;
-    }
+    return m_connectionCount;
+}
 
-    if (!m_writeJobQueue.isEmpty()) {
-        m_currentJob = m_writeJobQueue.takeFirst();
-    } else if (!m_highPriorityJobQueue.isEmpty()) {
-        m_currentJob = m_highPriorityJobQueue.takeFirst();
-    } else if (!m_mediumPriorityJobQueue.isEmpty()){
-        m_currentJob = m_mediumPriorityJobQueue.takeFirst();
-    } else if (!m_lowPriorityJobQueue.isEmpty()){
-        m_currentJob = m_lowPriorityJobQueue.takeFirst();
+void EvernoteConnection::setConnectionCount(int connectionCount)
+{
+    connectionCount = qMax(1, connectionCount);
+    if (m_connectionCount != connectionCount) {
+        m_connectionCount = connectionCount;
+        emit connectionCountChanged();
+        // Takes effect with the next connectToEvernote()
     }
+}
+
+int EvernoteConnection::queueDepth() const
+{
+    return m_jobQueue.count() + m_writeJobQueue.count();
+}
+
+quint64 EvernoteConnection::duplicateJobCount() const
+{
+    return m_duplicateJobCount;
+}
 
-    if (!m_currentJob) {
-        qCDebug(dcJobQueue) << "Queue empty. Nothing to do.";
+quint64 EvernoteConnection::fullTlsHandshakes() const
+{
+    return m_sslSocketFactory ? m_sslSocketFactory->fullHandshakes() : 0;
+}
+
+quint64 EvernoteConnection::resumedTlsHandshakes() const
+{
+    return m_sslSocketFactory ? m_sslSocketFactory->resumedHandshakes() : 0;
+}
+
+int EvernoteConnection::requestBurst() const
+{
+    return m_requestBucket.capacity();
+}
+
+void EvernoteConnection::setRequestBurst(int requestBurst)
+{
+    m_requestBucket.setCapacity(requestBurst);
+}
+
+qreal EvernoteConnection::requestRate() const
+{
+    return m_requestBucket.rate();
+}
+
+void EvernoteConnection::setRequestRate(qreal requestRate)
+{
+    m_requestBucket.setRate(requestRate);
+    startJobQueue();
+}
+
+bool EvernoteConnection::isRateLimited() const
+{
+    return m_rateLimitTimer.isActive();
+}
+
+void EvernoteConnection::startJobQueue()
+{
+    if (m_rateLimitTimer.isActive()) {
+        // Everything waits for the rate limit to expire
         return;
     }
 
-    qCDebug(dcJobQueue) << QString("Starting job (Priority: %1):").arg(m_currentJob->jobPriority()) << m_currentJob->toString();
-    m_currentJob->start();
+    for (int i = 0; i < m_notesStoreConnections.count(); i++) {
+        NotesStoreConnection *connection = m_notesStoreConnections.at(i);
+        if (connection->job()) {
+            continue;
+        }
+
+        // The first connection is the write lane. Writes run there one after the other, in the
+        // order they were queued. Reads go to the other connections, unless there's only one.
+        bool write = i == 0 && !m_writeJobQueue.isEmpty() && !retiredWriteRunning();
+        bool read = !write && (i > 0 || m_notesStoreConnections.count() == 1) && !m_jobQueue.isEmpty();
+        if (!write && !read) {
+            continue;
+        }
+
+        if (!m_requestBucket.tryTake()) {
+            if (!m_throttleTimer.isActive()) {
+                qCDebug(dcJobQueue) << "Throttling requests. Queue length:" << queueDepth();
+                m_throttleTimer.start(m_requestBucket.msecsUntilAvailable());
+            }
+            return;
+        }
+
+        qint64 now = m_requestClock.elapsed();
+        m_requestTimes.enqueue(now);
+        while (m_requestTimes.head() < now - s_rateLimitWindowSecs * 1000) {
+            m_requestTimes.dequeue();
+        }
+
+        EvernoteJob *job = write ? m_writeJobQueue.takeFirst() : m_jobQueue.takeFirst();
+
+        qCDebug(dcJobQueue) << QString("Starting job on connection %1 (Priority: %2):").arg(i).arg(job->jobPriority()) << job->toString();
+        connection->setJob(job);
+        job->m_notesStoreConnection = connection;
+        m_jobPool.start(job);
+    }
 }
 
 void EvernoteConnection::startNextJob()
 {
-    qCDebug(dcJobQueue) << "Job done:" << m_currentJob->toString();
-    m_currentJob = 0;
+    EvernoteJob *job = static_cast<EvernoteJob*>(sender());
+    qCDebug(dcJobQueue) << "Job done:" << job->toString();
+    releaseConnection(job);
     startJobQueue();
 }
+
+void EvernoteConnection::releaseConnection(EvernoteJob *job)
+{
+    foreach (NotesStoreConnection *connection, m_notesStoreConnections) {
+        if (connection->job() == job) {
+            connection->setJob(0);
+        }
+    }
+    foreach (NotesStoreConnection *connection, m_retiredConnections) {
+        if (connection->job() == job) {
+            qCDebug(dcConnection) << "Last job done on retired connection. Closing it.";
+            m_retiredConnections.removeOne(connection);
+            delete connection;
+            m_jobPool.setMaxThreadCount(m_connectionCount + m_retiredConnections.count());
+        }
+    }
+}
+
+bool EvernoteConnection::retiredWriteRunning() const
+{
+    foreach (NotesStoreConnection *connection, m_retiredConnections) {
+        if (connection->job() && connection->job()->m_write) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void EvernoteConnection::jobRateLimited()
+{
+    EvernoteJob *job = static_cast<EvernoteJob*>(sender());
+    releaseConnection(job);
+    job->m_notesStoreConnection = 0;
+
+    // Put it back in front, writes must stay in order
+    if (job->m_write) {
+        m_writeJobQueue.prepend(job);
+    } else {
+        m_jobQueue.enqueue(job);
+    }
+
+    // The server counts calls over the last hour. Don't burst again right after the pause.
+    m_requestBucket.drain();
+    throttleAfterRateLimit(job->rateLimitDuration());
+
+    int msecs = job->rateLimitDuration() * 1000;
+    if (!m_rateLimitTimer.isActive() || m_rateLimitTimer.remainingTime() < msecs) {
+        qCWarning(dcJobQueue) << "Rate limit reached. Pausing the job queue for"
+                              << QTime(0, 0).addMSecs(msecs).toString("mm:ss") << "Queue length:" << queueDepth();
+        m_rateLimitTimer.start(msecs);
+    }
+}
+
+void EvernoteConnection::throttleAfterRateLimit(int waitSecs)
+{
+    // The window is over once we may call again. The calls made since it started are about
+    // as many as the server allows per window. Stay at 90% of that from now on. A tenth of
+    // it may go out at once, the rest is spread evenly over the window.
+    qint64 windowStart = m_requestClock.elapsed() - qMax(0, s_rateLimitWindowSecs - waitSecs) * 1000;
+    int calls = 0;
+    foreach (qint64 time, m_requestTimes) {
+        if (time >= windowStart) {
+            calls++;
+        }
+    }
+    int budget = qMax(1, calls * 9 / 10);
+    int burst = qBound(1, budget / 10, m_requestBucket.capacity());
+    qreal rate = (qreal)qMax(1, budget - burst) / s_rateLimitWindowSecs;
+
+    if (m_requestBucket.rate() > 0 && m_requestBucket.rate() <= rate) {
+        return;
+    }
+    qCDebug(dcJobQueue) << calls << "calls in the rate limit window. Throttling to" << rate * 60
+                        << "calls per minute, bursts of" << burst;
+    m_requestBucket.setCapacity(burst);
+    m_requestBucket.setRate(rate);
+}
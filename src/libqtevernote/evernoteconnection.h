@@ -22,13 +22,20 @@
 #ifndef EVERNOTECONNECTION_H
 #define EVERNOTECONNECTION_H
 
+#include "jobs/jobqueue.h"
+#include "utils/tokenbucket.h"
+
 #include <boost/shared_ptr.hpp>
 
 // Thrift
 #include <transport/THttpClient.h>
+#include <transport/TSSLSocket.h>
 
 #include <QObject>
+#include <QElapsedTimer>
+#include <QQueue>
 #include <QTimer>
+#include <QThreadPool>
 
 namespace evernote {
 namespace edam {
@@ -40,6 +47,7 @@ class UserStoreClient;
 using namespace apache::thrift::transport;
 
 class EvernoteJob;
+class NotesStoreConnection;
 
 class EvernoteConnection : public QObject
 {
@@ -48,6 +56,8 @@ class EvernoteConnection : public QObject
     Q_PROPERTY(QString token READ token WRITE setToken NOTIFY tokenChanged)
     Q_PROPERTY(bool isConnected READ isConnected NOTIFY isConnectedChanged)
     Q_PROPERTY(QString error READ error NOTIFY errorChanged)
+    // Number of parallel connections to the NoteStore. One of them is reserved for writes.
+    Q_PROPERTY(int connectionCount READ connectionCount WRITE setConnectionCount NOTIFY connectionCountChanged)
 
     friend class NotesStoreJob;
     friend class UserStoreJob;
@@ -62,7 +72,8 @@ public:
         ErrorCodeAuthExpired,
         ErrorCodeRateLimitExceeded,
         ErrorCodeLimitExceeded,
-        ErrorCodeQutaExceeded
+        ErrorCodeQutaExceeded,
+        ErrorCodeCancelled
     };
 
     static EvernoteConnection* instance();
@@ -88,13 +99,45 @@ public:
     //   multiple times.
     void enqueue(EvernoteJob *job);
 
-    // Use this to queue write calls. They won't be deduped and will be ordered
+    // Use this to queue write calls. They won't be deduped and will be ordered. They all run
+    // on the same connection, so a write never overtakes another one. A write superseding a
+    // queued one (see EvernoteJob::supersedes()) replaces it, the replaced job emits the
+    // results of the new one.
     void enqueueWrite(EvernoteJob *job);
 
+    // Cancels the reads about the given note, notebook or tag (see EvernoteJob::guid()) with
+    // the given EvernoteJob::JobPriority or a lower one, all of them by default. Queued ones
+    // are dropped, running ones abort at the next read from the network. They emit jobDone()
+    // with ErrorCodeCancelled. Writes are never cancelled. Returns the number of jobs cancelled.
+    int cancel(const QString &guid, int priority = 0);
+
     bool isConnected() const;
 
     QString error() const;
 
+    int connectionCount() const;
+    void setConnectionCount(int connectionCount);
+
+    // Jobs waiting for a connection, reads and writes
+    int queueDepth() const;
+    // Jobs which didn't need to run because an equal one was queued already
+    quint64 duplicateJobCount() const;
+
+    // TLS handshakes done so far, negotiating a new session or resuming an earlier one
+    quint64 fullTlsHandshakes() const;
+    quint64 resumedTlsHandshakes() const;
+
+    // Client side throttling of NoteStore calls: up to requestBurst() calls at once, then
+    // requestRate() calls per second. A rate of 0 disables it. That's the default, until the
+    // server's rate limit is hit the first time. The rate is derived from that then.
+    int requestBurst() const;
+    void setRequestBurst(int requestBurst);
+    qreal requestRate() const;
+    void setRequestRate(qreal requestRate);
+
+    // True while the server's rate limit holds back the job queue
+    bool isRateLimited() const;
+
 public slots:
     void connectToEvernote();
     void disconnectFromEvernote();
@@ -104,11 +147,13 @@ signals:
     void tokenChanged();
     void isConnectedChanged();
     void errorChanged();
+    void connectionCountChanged();
 
 private slots:
 
     void startJobQueue();
     void startNextJob();
+    void jobRateLimited();
 
 private:
     explicit EvernoteConnection(QObject *parent = 0);
@@ -120,10 +165,16 @@ private:
     bool connectUserStore();
     bool connectNotesStore();
 
-    EvernoteJob* findExistingDuplicate(EvernoteJob *job);
-
     // "duplicate" will be attached to "original"
     void attachDuplicate(EvernoteJob *original, EvernoteJob *duplicate);
+    // Makes the connection used by job available again
+    void releaseConnection(EvernoteJob *job);
+    // A write from before the last reconnect is still running. Writes must not overlap.
+    bool retiredWriteRunning() const;
+    // Lowers the request rate to stay below the server's limit, waitSecs is what it told us
+    void throttleAfterRateLimit(int waitSecs);
+    // "superseded" won't run but report the results of "job"
+    void supersede(EvernoteJob *job, EvernoteJob *superseded);
 
     bool m_useSSL;
     bool m_isConnected;
@@ -132,17 +183,32 @@ private:
     QString m_token;
     QString m_errorMessage;
 
-    // There must be only one job running at a time
+    // There must be only one job running per connection at a time
     // Do not start jobs other than with startJobQueue()
-    QList<EvernoteJob*> m_highPriorityJobQueue;
-    QList<EvernoteJob*> m_mediumPriorityJobQueue;
-    QList<EvernoteJob*> m_lowPriorityJobQueue;
+    JobQueue m_jobQueue;
     QList<EvernoteJob*> m_writeJobQueue;
-    EvernoteJob *m_currentJob;
-
-    // Those need to be mutexed
-    evernote::edam::NoteStoreClient *m_notesStoreClient;
-    boost::shared_ptr<THttpClient> m_notesStoreHttpClient;
+    quint64 m_duplicateJobCount;
+
+    // No job is started while the rate limit timer runs. The throttle timer restarts the
+    // queue once the request bucket has a token again.
+    QTimer m_rateLimitTimer;
+    QTimer m_throttleTimer;
+    TokenBucket m_requestBucket;
+    // When the calls of the last rate limit window were started, on m_requestClock
+    QQueue<qint64> m_requestTimes;
+    QElapsedTimer m_requestClock;
+
+    // Long-lived workers running the jobs, so we don't pay for a thread per job
+    QThreadPool m_jobPool;
+
+    // The first one is the write lane. Each is used by the job it's assigned to only.
+    int m_connectionCount;
+    QList<NotesStoreConnection*> m_notesStoreConnections;
+    // Replaced by a reconnect while a job was running on them. Deleted once the job is done.
+    QList<NotesStoreConnection*> m_retiredConnections;
+
+    // One SSL context for all connections, sharing the TLS session cache
+    boost::shared_ptr<TSSLSocketFactory> m_sslSocketFactory;
 
     evernote::edam::UserStoreClient *m_userstoreClient;
     boost::shared_ptr<THttpClient> m_userStoreHttpClient;
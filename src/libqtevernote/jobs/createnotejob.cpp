@@ -23,8 +23,8 @@
 CreateNoteJob::CreateNoteJob(Note *note, QObject *parent) :
     NotesStoreJob(parent)
 {
-    m_note = note->clone();
-    m_note->setParent(this);
+    // As startJob() will run in another thread we can't access the real note from there.
+    m_note = note->snapshot();
 }
 
 bool CreateNoteJob::operator==(const EvernoteJob *other) const
@@ -33,7 +33,7 @@ bool CreateNoteJob::operator==(const EvernoteJob *other) const
     if (!otherJob) {
         return false;
     }
-    return this->m_note->guid() == otherJob->m_note->guid();
+    return this->m_note.guid() == otherJob->m_note.guid();
 }
 
 void CreateNoteJob::attachToDuplicate(const EvernoteJob *other)
@@ -44,29 +44,30 @@ void CreateNoteJob::attachToDuplicate(const EvernoteJob *other)
 
 void CreateNoteJob::startJob()
 {
+    const NoteRecord &record = m_note.record();
     evernote::edam::Note input;
-    input.updateSequenceNum = m_note->updateSequenceNumber();
+    input.updateSequenceNum = record.updateSequenceNumber;
     input.__isset.updateSequenceNum = true;
 
-    input.title = m_note->title().toStdString();
+    input.title = record.title.toStdString();
     input.__isset.title = true;
-    if (!m_note->notebookGuid().isEmpty()) {
-        input.notebookGuid = m_note->notebookGuid().toStdString();
+    if (!record.notebookGuid.isEmpty()) {
+        input.notebookGuid = record.notebookGuid.toStdString();
         input.__isset.notebookGuid = true;
     }
-    if (!m_note->enmlContent().isEmpty()) {
-        input.content = m_note->enmlContent().toStdString();
+    if (!m_note.enmlContent().isEmpty()) {
+        input.content = m_note.enmlContent().toStdString();
         input.__isset.content = true;
-        input.contentLength = m_note->enmlContent().length();
+        input.contentLength = m_note.enmlContent().length();
         input.__isset.contentLength = true;
     }
-    input.created = m_note->created().toMSecsSinceEpoch();
+    input.created = record.created.toMSecsSinceEpoch();
     input.__isset.created = true;
-    input.updated = m_note->updated().toMSecsSinceEpoch();
+    input.updated = record.updated.toMSecsSinceEpoch();
     input.__isset.updated = true;
 
     std::vector<evernote::edam::Guid> tags;
-    foreach (const QString &tag, m_note->tagGuids()) {
+    foreach (const QString &tag, record.tagGuids) {
         tags.push_back(tag.toStdString());
     }
     input.tagGuids = tags;
@@ -77,5 +78,5 @@ void CreateNoteJob::startJob()
 
 void CreateNoteJob::emitJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage)
 {
-    emit jobDone(errorCode, errorMessage, m_note->guid(), m_resultNote);
+    emit jobDone(errorCode, errorMessage, m_note.guid(), m_resultNote);
 }
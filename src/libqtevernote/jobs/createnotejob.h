@@ -23,6 +23,7 @@
 
 #include "notesstorejob.h"
 #include "note.h"
+#include "notesnapshot.h"
 
 class CreateNoteJob : public NotesStoreJob
 {
@@ -41,7 +42,7 @@ protected:
     void emitJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage);
 
 private:
-    Note *m_note;
+    NoteSnapshot m_note;
 
     evernote::edam::Note m_resultNote;
 };
@@ -39,12 +39,18 @@ using namespace apache::thrift::protocol;
 using namespace apache::thrift::transport;
 
 EvernoteJob::EvernoteJob(QObject *originatingObject, JobPriority jobPriority) :
-    QThread(nullptr),
+    QObject(nullptr),
     m_token(EvernoteConnection::instance()->token()),
     m_jobPriority(jobPriority),
-    m_originatingObject(originatingObject)
+    m_originatingObject(originatingObject),
+    m_finished(0),
+    m_cancelled(0),
+    m_rateLimitDuration(0),
+    m_write(false),
+    m_notesStoreConnection(0)
 {
-    connect(this, &QThread::finished, this, &EvernoteJob::jobFinished);
+    // The job queue deletes us once jobFinished() arrived, not the pool
+    setAutoDelete(false);
 }
 
 EvernoteJob::~EvernoteJob()
@@ -62,6 +68,39 @@ void EvernoteJob::setJobPriority(EvernoteJob::JobPriority priority)
 }
 
 void EvernoteJob::run()
+{
+    m_rateLimitDuration = 0;
+    execute();
+    if (m_rateLimitDuration > 0) {
+        // Not done, the queue will run us again
+        emit rateLimitReached();
+        return;
+    }
+    m_finished.storeRelease(1);
+    emit jobFinished();
+}
+
+bool EvernoteJob::isFinished() const
+{
+    return m_finished.loadAcquire() != 0;
+}
+
+int EvernoteJob::rateLimitDuration() const
+{
+    return m_rateLimitDuration;
+}
+
+void EvernoteJob::cancel()
+{
+    m_cancelled.storeRelease(1);
+}
+
+bool EvernoteJob::isCancelled() const
+{
+    return m_cancelled.loadAcquire() != 0;
+}
+
+void EvernoteJob::execute()
 {
     if (!EvernoteConnection::instance()->isConnected()) {
         qCWarning(dcJobQueue) << "EvernoteConnection is not connected. (" << toString() << ")";
@@ -73,10 +112,25 @@ void EvernoteJob::run()
     int tryCount = 0;
     do {
         retry = false;
+        if (isCancelled()) {
+            qCDebug(dcJobQueue) << "Job cancelled:" << toString();
+            emitJobDone(EvernoteConnection::ErrorCodeCancelled, QStringLiteral("Cancelled."));
+            return;
+        }
         try {
             startJob();
             emitJobDone(EvernoteConnection::ErrorCodeNoError, QString());
         } catch (const TTransportException & e) {
+            if (e.getType() == TTransportException::INTERRUPTED && isCancelled()) {
+                // The rest of the response is still on its way. Start over on a fresh
+                // connection, so none of it ends up in front of the next job's response.
+                qCDebug(dcJobQueue) << "Job cancelled while running:" << toString();
+                try {
+                    resetConnection();
+                } catch(...) {}
+                emitJobDone(EvernoteConnection::ErrorCodeCancelled, QStringLiteral("Cancelled."));
+                return;
+            }
             qCWarning(dcJobQueue) << "TTransportException in" << metaObject()->className() << e.what();
             if (tryCount < 2) {
                 qCWarning(dcJobQueue) << "Resetting connection...";
@@ -168,6 +222,12 @@ void EvernoteJob::run()
             emitJobDone(errorCode, message);
         } catch (const evernote::edam::EDAMSystemException &e) {
             qCWarning(dcJobQueue) << "EDAMSystemException in" << metaObject()->className() << e.what() << e.errorCode << QString::fromStdString(e.message);
+            if (e.errorCode == evernote::edam::EDAMErrorCode::RATE_LIMIT_REACHED) {
+                // Don't fail the job for that, the queue pauses and retries it
+                m_rateLimitDuration = e.__isset.rateLimitDuration ? qMax(1, e.rateLimitDuration) : 60;
+                qCDebug(dcJobQueue) << "Rate limit reached. Retrying in" << m_rateLimitDuration << "seconds:" << toString();
+                return;
+            }
             QString message;
             EvernoteConnection::ErrorCode errorCode;
             switch (e.errorCode) {
@@ -179,10 +239,6 @@ void EvernoteJob::run()
                 message = "Limit exceeded.";
                 errorCode = EvernoteConnection::ErrorCodeLimitExceeded;
                 break;
-            case evernote::edam::EDAMErrorCode::RATE_LIMIT_REACHED:
-                message = "Rate limit exceeded.";
-                errorCode = EvernoteConnection::ErrorCodeRateLimitExceeded;
-                break;
             case evernote::edam::EDAMErrorCode::QUOTA_REACHED:
                 message = "Quota exceeded.";
                 errorCode = EvernoteConnection::ErrorCodeQutaExceeded;
@@ -199,6 +255,22 @@ void EvernoteJob::run()
     } while (retry);
 }
 
+QString EvernoteJob::key() const
+{
+    return metaObject()->className();
+}
+
+bool EvernoteJob::supersedes(const EvernoteJob *other) const
+{
+    Q_UNUSED(other)
+    return false;
+}
+
+QString EvernoteJob::guid() const
+{
+    return QString();
+}
+
 QString EvernoteJob::toString() const
 {
     return metaObject()->className();
@@ -209,6 +281,11 @@ QObject *EvernoteJob::originatingObject() const
     return m_originatingObject;
 }
 
+NotesStoreConnection *EvernoteJob::notesStoreConnection() const
+{
+    return m_notesStoreConnection;
+}
+
 QString EvernoteJob::token()
 {
     return m_token;
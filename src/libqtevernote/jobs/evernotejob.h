@@ -22,8 +22,11 @@
 #define EVERNOTEJOB_H
 
 #include "evernoteconnection.h"
+#include "notesstoreconnection.h"
 
-#include <QThread>
+#include <QObject>
+#include <QRunnable>
+#include <QAtomicInt>
 
 /* How to create a new Job type:
  * - Subclass EvernoteJob
@@ -35,11 +38,18 @@
  *   - NOTE: emitJobDone() might be called with an error even before startJob() is triggered.
  * - reimplement attachToDuplciate(). In case there's already the exact same job in the queue
  *   your job won't be executed but you should instead forward the other's job results.
+ * - reimplement key() if there may be many jobs of your type queued at once.
+ * - reimplement supersedes() for writes which upload an object's complete state, so only
+ *   the latest one of them is sent.
  *
  * Jobs can be enqueue()d in NotesStore.
  * The jobqueue will take care about starting them and deleting them.
+ * They are run by the EvernoteConnection's worker pool. jobDone() and jobFinished() are
+ * emitted from the worker thread, so receivers in the main thread get them queued.
+ * If the server says we're over the rate limit, the job emits rateLimitReached() instead
+ * of jobDone() and jobFinished() and the queue runs it again once the limit has expired.
  */
-class EvernoteJob : public QThread
+class EvernoteJob : public QObject, public QRunnable
 {
     Q_OBJECT
 public:
@@ -56,9 +66,32 @@ public:
     void setJobPriority(JobPriority priority = JobPriorityHigh);
 
     void run() final;
+    // True once run() returned. jobFinished() might still be on its way to the receivers.
+    bool isFinished() const;
+
+    // Seconds the server asked us to wait when the job last ran into the rate limit
+    int rateLimitDuration() const;
+
+    // Can be called from any thread. A job which didn't start yet won't, a running one gives
+    // up at the next read from the network. Either way it finishes with ErrorCodeCancelled.
+    void cancel();
+    bool isCancelled() const;
+
+    // The note, notebook or tag this job is about, if it is about a single one. Defaults to
+    // an empty string. Used by EvernoteConnection::cancel().
+    virtual QString guid() const;
 
     virtual bool operator==(const EvernoteJob *other) const = 0;
 
+    // Used by the job queue to look up duplicates. Equal jobs must have the same key, jobs
+    // with the same key are told apart by operator==. Defaults to the class name.
+    virtual QString key() const;
+
+    // For writes: true if this job makes the queued job "other" obsolete, e.g. because it
+    // saves a newer state of the same object. "other" is then attached to this one and
+    // doesn't run. Defaults to false.
+    virtual bool supersedes(const EvernoteJob *other) const;
+
     virtual void attachToDuplicate(const EvernoteJob *other) = 0;
 
     virtual QString toString() const;
@@ -69,6 +102,7 @@ signals:
     void connectionLost(const QString &errorMessage);
 
     void jobFinished();
+    void rateLimitReached();
 
 protected:
     virtual void resetConnection() = 0;
@@ -77,10 +111,21 @@ protected:
 
     QString token();
 
+    // The NoteStore connection this job has been assigned to while it runs
+    NotesStoreConnection *notesStoreConnection() const;
+
 private:
+    void execute();
+
     QString m_token;
     JobPriority m_jobPriority;
     QObject *m_originatingObject;
+    QAtomicInt m_finished;
+    QAtomicInt m_cancelled;
+    int m_rateLimitDuration;
+    // Queued with EvernoteConnection::enqueueWrite()
+    bool m_write;
+    NotesStoreConnection *m_notesStoreConnection;
 
     friend class EvernoteConnection;
 };
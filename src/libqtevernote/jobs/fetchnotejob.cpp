@@ -27,6 +27,10 @@ FetchNoteJob::FetchNoteJob(const QString &guid, LoadWhatFlags what, QObject *par
 {
     qRegisterMetaType<LoadWhat>("LoadWhat");
     qRegisterMetaType<LoadWhatFlags>("LoadWhatFlags");
+
+    // Just in case we error out or get cancelled before starting, make sure the reply can be
+    // idenfied by note guid
+    m_result.guid = m_guid.toStdString();
 }
 
 bool FetchNoteJob::operator==(const EvernoteJob *other) const
@@ -38,6 +42,16 @@ bool FetchNoteJob::operator==(const EvernoteJob *other) const
     return this->m_guid == otherJob->m_guid && this->m_what == otherJob->m_what;
 }
 
+QString FetchNoteJob::key() const
+{
+    return QString("%1:%2:%3").arg(metaObject()->className()).arg(m_guid).arg(int(m_what));
+}
+
+QString FetchNoteJob::guid() const
+{
+    return m_guid;
+}
+
 void FetchNoteJob::attachToDuplicate(const EvernoteJob *other)
 {
     const FetchNoteJob *otherJob = static_cast<const FetchNoteJob*>(other);
@@ -54,9 +68,8 @@ QString FetchNoteJob::toString() const
 
 void FetchNoteJob::startJob()
 {
-    // Just in case we error out, make sure the reply can be idenfied by note guid
-    m_result.guid = m_guid.toStdString();
-    client()->getNote(m_result, token().toStdString(), m_guid.toStdString(), m_what.testFlag(LoadContent), m_what.testFlag(LoadResources), false, false);
+    // Resource data is downloaded separately, getNote() would hold all of it in memory at once
+    client()->getNote(m_result, token().toStdString(), m_guid.toStdString(), m_what.testFlag(LoadContent), false, false, false);
 }
 
 void FetchNoteJob::emitJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage)
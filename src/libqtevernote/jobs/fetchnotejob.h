@@ -27,6 +27,9 @@ class FetchNoteJob : public NotesStoreJob
 {
     Q_OBJECT
 public:
+    // The note always comes with the list of its resources, but never with their data.
+    // LoadResources is for finding out which resources need to be fetched with a
+    // FetchResourceJob.
     enum LoadWhat {
         LoadContent = 0x01,
         LoadResources = 0x02
@@ -36,6 +39,8 @@ public:
     explicit FetchNoteJob(const QString &guid, LoadWhatFlags what, QObject *parent = 0);
 
     virtual bool operator==(const EvernoteJob *other) const override;
+    virtual QString key() const override;
+    virtual QString guid() const override;
     virtual void attachToDuplicate(const EvernoteJob *other) override;
     virtual QString toString() const override;
 
@@ -25,12 +25,15 @@
 // evernote sdk
 #include "Limits_constants.h"
 
+#include <QElapsedTimer>
+
 FetchNotesJob::FetchNotesJob(const QString &filterNotebookGuid, const QString &searchWords, int startIndex, int chunkSize, QObject *parent) :
     NotesStoreJob(parent),
     m_filterNotebookGuid(filterNotebookGuid),
     m_searchWords(searchWords),
     m_startIndex(startIndex),
-    m_chunkSize(chunkSize)
+    m_chunkSize(chunkSize),
+    m_elapsed(0)
 {
 }
 
@@ -46,6 +49,11 @@ bool FetchNotesJob::operator==(const EvernoteJob *other) const
             && this->m_chunkSize == otherJob->m_chunkSize;
 }
 
+QString FetchNotesJob::key() const
+{
+    return QString("%1:%2:%3:%4").arg(metaObject()->className()).arg(m_filterNotebookGuid).arg(m_startIndex).arg(m_chunkSize);
+}
+
 void FetchNotesJob::attachToDuplicate(const EvernoteJob *other)
 {
     const FetchNotesJob *otherJob = static_cast<const FetchNotesJob*>(other);
@@ -62,6 +70,16 @@ QString FetchNotesJob::toString() const
             .arg(m_chunkSize);
 }
 
+int FetchNotesJob::chunkSize() const
+{
+    return m_chunkSize;
+}
+
+qint64 FetchNotesJob::elapsed() const
+{
+    return m_elapsed;
+}
+
 void FetchNotesJob::startJob()
 {
     int32_t start = m_startIndex;
@@ -99,7 +117,10 @@ void FetchNotesJob::startJob()
     resultSpec.includeUpdateSequenceNum = true;
     resultSpec.__isset.includeUpdateSequenceNum = true;
 
+    QElapsedTimer timer;
+    timer.start();
     client()->findNotesMetadata(m_results, token().toStdString(), filter, start, max, resultSpec);
+    m_elapsed = timer.elapsed();
 }
 
 void FetchNotesJob::emitJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage)
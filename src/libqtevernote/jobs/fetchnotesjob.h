@@ -33,9 +33,14 @@ public:
     explicit FetchNotesJob(const QString &filterNotebookGuid = QString(), const QString &searchWords = QString(), int startIndex = 0, int chunkSize = 50, QObject *parent = 0);
 
     virtual bool operator==(const EvernoteJob *other) const override;
+    virtual QString key() const override;
     virtual void attachToDuplicate(const EvernoteJob *other) override;
     virtual QString toString() const override;
 
+    int chunkSize() const;
+    // How long the request took, 0 until it ran
+    qint64 elapsed() const;
+
 signals:
     void jobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const evernote::edam::NotesMetadataList &results, const QString &filterNotebookGuid);
 
@@ -49,6 +54,7 @@ private:
     evernote::edam::NotesMetadataList m_results;
     int m_startIndex;
     int m_chunkSize;
+    qint64 m_elapsed;
 };
 
 #endif // FETCHNOTESJOB_H
@@ -0,0 +1,224 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fetchresourcejob.h"
+#include "logging.h"
+
+#include <protocol/TProtocol.h>
+#include <transport/TTransport.h>
+
+#include <QCryptographicHash>
+#include <QFile>
+
+using namespace apache::thrift;
+using namespace apache::thrift::protocol;
+
+// Bytes copied from the connection to the file at once
+static const int s_blockSize = 64 * 1024;
+// Bytes between two progress reports
+static const qint64 s_progressInterval = 256 * 1024;
+
+FetchResourceJob::FetchResourceJob(const QString &noteGuid, const QString &resourceGuid, const QString &hash,
+                                   qint64 size, const QString &filePath, QObject *parent) :
+    NotesStoreJob(parent),
+    m_noteGuid(noteGuid),
+    m_resourceGuid(resourceGuid),
+    m_hash(hash),
+    m_size(size),
+    m_filePath(filePath)
+{
+}
+
+bool FetchResourceJob::operator==(const EvernoteJob *other) const
+{
+    const FetchResourceJob *otherJob = qobject_cast<const FetchResourceJob*>(other);
+    if (!otherJob) {
+        return false;
+    }
+    // The data is stored by hash. Same file, same data, even if it's another note's resource.
+    return this->m_filePath == otherJob->m_filePath;
+}
+
+QString FetchResourceJob::key() const
+{
+    return QString("%1:%2").arg(metaObject()->className()).arg(m_hash);
+}
+
+QString FetchResourceJob::guid() const
+{
+    return m_noteGuid;
+}
+
+void FetchResourceJob::attachToDuplicate(const EvernoteJob *other)
+{
+    const FetchResourceJob *otherJob = static_cast<const FetchResourceJob*>(other);
+    connect(otherJob, &FetchResourceJob::jobDone, this, &FetchResourceJob::jobDone);
+    connect(otherJob, &FetchResourceJob::progress, this, &FetchResourceJob::progress);
+}
+
+QString FetchResourceJob::toString() const
+{
+    return QString("%1, NoteGuid: %2, Hash: %3, Size: %4")
+            .arg(metaObject()->className())
+            .arg(m_noteGuid)
+            .arg(m_hash)
+            .arg(m_size);
+}
+
+void FetchResourceJob::startJob()
+{
+    m_errorMessage.clear();
+
+    // Written next to the final file and renamed once complete, so a dropped connection never
+    // leaves a truncated resource in the cache
+    QFile file(m_filePath + ".part");
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+        m_errorMessage = QString("Cannot write %1").arg(file.fileName());
+        return;
+    }
+
+    try {
+        evernote::edam::NoteStoreClient *noteStore = client();
+        noteStore->send_getResourceData(token().toStdString(), m_resourceGuid.toStdString());
+        receiveData(noteStore->getInputProtocol(), &file);
+    } catch (...) {
+        file.remove();
+        throw;
+    }
+
+    if (!m_errorMessage.isEmpty() || !file.flush()) {
+        file.remove();
+        return;
+    }
+    file.close();
+
+    // Somebody else might have stored it meanwhile, e.g. for another note with the same resource
+    QFile::remove(m_filePath);
+    if (!file.rename(m_filePath)) {
+        m_errorMessage = QString("Cannot rename %1 to %2").arg(file.fileName()).arg(m_filePath);
+        file.remove();
+    }
+}
+
+void FetchResourceJob::receiveData(const boost::shared_ptr<TProtocol> &iprot, QFile *file)
+{
+    // What recv_getResourceData() does, except for the body. Instead of reading it into one
+    // string, it goes to the file block by block. The connection speaks TBinaryProtocol, which
+    // sends a binary as its 32 bit length followed by the data.
+    std::string fname;
+    TMessageType mtype;
+    int32_t rseqid = 0;
+    iprot->readMessageBegin(fname, mtype, rseqid);
+    if (mtype == T_EXCEPTION) {
+        TApplicationException x;
+        x.read(iprot.get());
+        iprot->readMessageEnd();
+        iprot->getTransport()->readEnd();
+        throw x;
+    }
+    if (mtype != T_REPLY || fname != "getResourceData") {
+        iprot->skip(T_STRUCT);
+        iprot->readMessageEnd();
+        iprot->getTransport()->readEnd();
+        throw TApplicationException(mtype != T_REPLY ? TApplicationException::INVALID_MESSAGE_TYPE : TApplicationException::WRONG_METHOD_NAME);
+    }
+
+    bool success = false;
+    evernote::edam::EDAMUserException userException;
+    evernote::edam::EDAMSystemException systemException;
+    evernote::edam::EDAMNotFoundException notFoundException;
+    bool userError = false, systemError = false, notFound = false;
+
+    TType ftype;
+    int16_t fid;
+    iprot->readStructBegin(fname);
+    while (true) {
+        iprot->readFieldBegin(fname, ftype, fid);
+        if (ftype == T_STOP) {
+            break;
+        }
+        if (fid == 0 && ftype == T_STRING) {
+            int32_t size;
+            iprot->readI32(size);
+            if (size < 0) {
+                throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+            }
+
+            QCryptographicHash md5(QCryptographicHash::Md5);
+            QByteArray block(s_blockSize, Qt::Uninitialized);
+            qint64 received = 0;
+            qint64 reported = 0;
+            while (received < size) {
+                uint32_t length = qMin<qint64>(s_blockSize, size - received);
+                iprot->getTransport()->readAll(reinterpret_cast<uint8_t*>(block.data()), length);
+                received += length;
+                md5.addData(block.constData(), length);
+                // Keep reading on errors, the connection is usable again after the response
+                if (m_errorMessage.isEmpty() && file->write(block.constData(), length) != length) {
+                    m_errorMessage = QString("Error writing %1: %2").arg(file->fileName()).arg(file->errorString());
+                }
+                if (received - reported >= s_progressInterval || received == size) {
+                    reported = received;
+                    emit progress(m_noteGuid, m_hash, received, qMax<qint64>(m_size, size));
+                }
+            }
+            if (m_errorMessage.isEmpty() && md5.result().toHex() != m_hash) {
+                m_errorMessage = QString("Checksum mismatch for resource %1").arg(m_hash);
+            }
+            success = true;
+        } else if (fid == 1 && ftype == T_STRUCT) {
+            userException.read(iprot.get());
+            userError = true;
+        } else if (fid == 2 && ftype == T_STRUCT) {
+            systemException.read(iprot.get());
+            systemError = true;
+        } else if (fid == 3 && ftype == T_STRUCT) {
+            notFoundException.read(iprot.get());
+            notFound = true;
+        } else {
+            iprot->skip(ftype);
+        }
+        iprot->readFieldEnd();
+    }
+    iprot->readStructEnd();
+    iprot->readMessageEnd();
+    iprot->getTransport()->readEnd();
+
+    if (userError) {
+        throw userException;
+    }
+    if (systemError) {
+        throw systemException;
+    }
+    if (notFound) {
+        throw notFoundException;
+    }
+    if (!success) {
+        throw TApplicationException(TApplicationException::MISSING_RESULT, "getResourceData failed: unknown result");
+    }
+}
+
+void FetchResourceJob::emitJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage)
+{
+    if (errorCode == EvernoteConnection::ErrorCodeNoError && !m_errorMessage.isEmpty()) {
+        qCWarning(dcJobQueue) << "Error storing resource:" << m_errorMessage;
+        emit jobDone(EvernoteConnection::ErrorCodeSystemException, m_errorMessage, m_noteGuid, m_hash);
+        return;
+    }
+    emit jobDone(errorCode, errorMessage, m_noteGuid, m_hash);
+}
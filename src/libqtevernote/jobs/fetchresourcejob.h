@@ -0,0 +1,74 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FETCHRESOURCEJOB_H
+#define FETCHRESOURCEJOB_H
+
+#include "notesstorejob.h"
+
+#include <boost/shared_ptr.hpp>
+
+class QFile;
+
+namespace apache {
+namespace thrift {
+namespace protocol {
+class TProtocol;
+}
+}
+}
+
+// Downloads the data of a single resource straight into the given file. The body isn't
+// deserialized into memory as a whole but copied from the connection in small blocks,
+// so memory use doesn't depend on the resource's size.
+class FetchResourceJob : public NotesStoreJob
+{
+    Q_OBJECT
+public:
+    // size is only used to report progress, the hash to verify the data
+    explicit FetchResourceJob(const QString &noteGuid, const QString &resourceGuid, const QString &hash,
+                              qint64 size, const QString &filePath, QObject *parent = 0);
+
+    virtual bool operator==(const EvernoteJob *other) const override;
+    virtual QString key() const override;
+    virtual QString guid() const override;
+    virtual void attachToDuplicate(const EvernoteJob *other) override;
+    virtual QString toString() const override;
+
+signals:
+    void jobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const QString &noteGuid, const QString &hash);
+    void progress(const QString &noteGuid, const QString &hash, qint64 bytesReceived, qint64 bytesTotal);
+
+protected:
+    void startJob();
+    void emitJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage);
+
+private:
+    void receiveData(const boost::shared_ptr<apache::thrift::protocol::TProtocol> &iprot, QFile *file);
+
+    QString m_noteGuid;
+    QString m_resourceGuid;
+    QString m_hash;
+    qint64 m_size;
+    QString m_filePath;
+
+    // Set if the data arrived, but couldn't be stored
+    QString m_errorMessage;
+};
+
+#endif // FETCHRESOURCEJOB_H
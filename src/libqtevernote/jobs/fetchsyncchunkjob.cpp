@@ -0,0 +1,77 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fetchsyncchunkjob.h"
+
+FetchSyncChunkJob::FetchSyncChunkJob(qint32 afterUSN, int maxEntries, QObject *parent) :
+    NotesStoreJob(parent),
+    m_afterUSN(afterUSN),
+    m_maxEntries(maxEntries)
+{
+}
+
+bool FetchSyncChunkJob::operator==(const EvernoteJob *other) const
+{
+    const FetchSyncChunkJob *otherJob = qobject_cast<const FetchSyncChunkJob*>(other);
+    if (!otherJob) {
+        return false;
+    }
+    return this->m_afterUSN == otherJob->m_afterUSN
+            && this->m_maxEntries == otherJob->m_maxEntries;
+}
+
+QString FetchSyncChunkJob::key() const
+{
+    return QString("%1:%2").arg(metaObject()->className()).arg(m_afterUSN);
+}
+
+void FetchSyncChunkJob::attachToDuplicate(const EvernoteJob *other)
+{
+    const FetchSyncChunkJob *otherJob = static_cast<const FetchSyncChunkJob*>(other);
+    connect(otherJob, &FetchSyncChunkJob::jobDone, this, &FetchSyncChunkJob::jobDone);
+}
+
+QString FetchSyncChunkJob::toString() const
+{
+    return QString("%1, AfterUSN: %2, MaxEntries: %3")
+            .arg(metaObject()->className())
+            .arg(m_afterUSN)
+            .arg(m_maxEntries);
+}
+
+void FetchSyncChunkJob::startJob()
+{
+    evernote::edam::SyncChunkFilter filter;
+    filter.includeNotes = true;
+    filter.__isset.includeNotes = true;
+    filter.includeNoteAttributes = true;
+    filter.__isset.includeNoteAttributes = true;
+    filter.includeNotebooks = true;
+    filter.__isset.includeNotebooks = true;
+    filter.includeTags = true;
+    filter.__isset.includeTags = true;
+    filter.includeExpunged = true;
+    filter.__isset.includeExpunged = true;
+
+    client()->getFilteredSyncChunk(m_result, token().toStdString(), m_afterUSN, m_maxEntries, filter);
+}
+
+void FetchSyncChunkJob::emitJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage)
+{
+    emit jobDone(errorCode, errorMessage, m_result);
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FETCHSYNCCHUNKJOB_H
+#define FETCHSYNCCHUNKJOB_H
+
+#include "notesstorejob.h"
+
+// Fetches everything that changed on the server after the given USN: note metadata (without
+// content and resources), notebooks, tags and the guids of expunged objects.
+// The server may return less than maxEntries objects. Continue after chunkHighUSN until
+// it reaches the chunk's updateCount.
+class FetchSyncChunkJob : public NotesStoreJob
+{
+    Q_OBJECT
+public:
+    explicit FetchSyncChunkJob(qint32 afterUSN, int maxEntries = 100, QObject *parent = 0);
+
+    virtual bool operator==(const EvernoteJob *other) const override;
+    virtual QString key() const override;
+    virtual void attachToDuplicate(const EvernoteJob *other) override;
+    virtual QString toString() const override;
+
+signals:
+    void jobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const evernote::edam::SyncChunk &result);
+
+protected:
+    void startJob();
+    void emitJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage);
+
+private:
+    qint32 m_afterUSN;
+    int m_maxEntries;
+    evernote::edam::SyncChunk m_result;
+};
+
+#endif // FETCHSYNCCHUNKJOB_H
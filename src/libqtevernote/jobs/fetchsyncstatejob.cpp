@@ -0,0 +1,49 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fetchsyncstatejob.h"
+
+FetchSyncStateJob::FetchSyncStateJob(QObject *parent) :
+    NotesStoreJob(parent)
+{
+}
+
+bool FetchSyncStateJob::operator==(const EvernoteJob *other) const
+{
+    const FetchSyncStateJob *otherJob = qobject_cast<const FetchSyncStateJob*>(other);
+    if (!otherJob) {
+        return false;
+    }
+    return true;
+}
+
+void FetchSyncStateJob::attachToDuplicate(const EvernoteJob *other)
+{
+    const FetchSyncStateJob *otherJob = static_cast<const FetchSyncStateJob*>(other);
+    connect(otherJob, &FetchSyncStateJob::jobDone, this, &FetchSyncStateJob::jobDone);
+}
+
+void FetchSyncStateJob::startJob()
+{
+    client()->getSyncState(m_result, token().toStdString());
+}
+
+void FetchSyncStateJob::emitJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage)
+{
+    emit jobDone(errorCode, errorMessage, m_result);
+}
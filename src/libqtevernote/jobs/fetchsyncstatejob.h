@@ -0,0 +1,44 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FETCHSYNCSTATEJOB_H
+#define FETCHSYNCSTATEJOB_H
+
+#include "notesstorejob.h"
+
+class FetchSyncStateJob : public NotesStoreJob
+{
+    Q_OBJECT
+public:
+    explicit FetchSyncStateJob(QObject *parent = 0);
+
+    virtual bool operator==(const EvernoteJob *other) const override;
+    virtual void attachToDuplicate(const EvernoteJob *other) override;
+
+signals:
+    void jobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const evernote::edam::SyncState &result);
+
+protected:
+    void startJob();
+    void emitJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage);
+
+private:
+    evernote::edam::SyncState m_result;
+};
+
+#endif // FETCHSYNCSTATEJOB_H
@@ -0,0 +1,98 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "jobqueue.h"
+#include "evernotejob.h"
+
+JobQueue::JobQueue():
+    m_sequence(0)
+{
+}
+
+bool JobQueue::isEmpty() const
+{
+    return m_jobs.isEmpty();
+}
+
+int JobQueue::count() const
+{
+    return m_jobs.count();
+}
+
+void JobQueue::enqueue(EvernoteJob *job)
+{
+    Position position(job->jobPriority(), -(++m_sequence));
+    m_jobs.insert(position, job);
+    m_positions.insert(job, position);
+    m_jobsByKey.insert(job->key(), job);
+}
+
+void JobQueue::requeue(EvernoteJob *job)
+{
+    if (!m_positions.contains(job)) {
+        return;
+    }
+    m_jobs.remove(m_positions.value(job));
+    Position position(job->jobPriority(), -(++m_sequence));
+    m_jobs.insert(position, job);
+    m_positions.insert(job, position);
+}
+
+EvernoteJob *JobQueue::findDuplicate(const EvernoteJob *job) const
+{
+    // Equal jobs share a key, but the key doesn't need to tell everything apart
+    QString key = job->key();
+    QMultiHash<QString, EvernoteJob*>::const_iterator it = m_jobsByKey.constFind(key);
+    while (it != m_jobsByKey.constEnd() && it.key() == key) {
+        if (it.value()->operator ==(job)) {
+            return it.value();
+        }
+        ++it;
+    }
+    return 0;
+}
+
+EvernoteJob *JobQueue::takeFirst()
+{
+    if (m_jobs.isEmpty()) {
+        return 0;
+    }
+    EvernoteJob *job = m_jobs.first();
+    remove(job);
+    return job;
+}
+
+QList<EvernoteJob*> JobQueue::takeAll()
+{
+    QList<EvernoteJob*> jobs = m_jobs.values();
+    m_jobs.clear();
+    m_positions.clear();
+    m_jobsByKey.clear();
+    return jobs;
+}
+
+QList<EvernoteJob*> JobQueue::jobs() const
+{
+    return m_jobs.values();
+}
+
+void JobQueue::remove(EvernoteJob *job)
+{
+    m_jobs.remove(m_positions.take(job));
+    m_jobsByKey.remove(job->key(), job);
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JOBQUEUE_H
+#define JOBQUEUE_H
+
+#include <QHash>
+#include <QMap>
+#include <QMultiHash>
+#include <QPair>
+
+class EvernoteJob;
+
+// The jobs waiting for a connection, ordered by priority and, within a priority, the most
+// recently queued or requested one first. Positions and EvernoteJob::key()s are indexed, so
+// finding a duplicate, moving a job and taking the next one don't walk the queue. A full
+// sync queues thousands of jobs.
+class JobQueue
+{
+public:
+    JobQueue();
+
+    bool isEmpty() const;
+    int count() const;
+
+    // Queues the job in front of all others with the same priority
+    void enqueue(EvernoteJob *job);
+
+    // Moves a queued job in front of all others with its priority, e.g. after it was raised
+    void requeue(EvernoteJob *job);
+
+    // Returns the queued job equal to the given one, if any
+    EvernoteJob *findDuplicate(const EvernoteJob *job) const;
+
+    EvernoteJob *takeFirst();
+    QList<EvernoteJob*> takeAll();
+
+    // All queued jobs, in the order they'd be taken
+    QList<EvernoteJob*> jobs() const;
+    void remove(EvernoteJob *job);
+
+private:
+    // Priority first, then the reverse insertion order
+    typedef QPair<int, qint64> Position;
+
+    QMap<Position, EvernoteJob*> m_jobs;
+    QHash<EvernoteJob*, Position> m_positions;
+    QMultiHash<QString, EvernoteJob*> m_jobsByKey;
+    qint64 m_sequence;
+};
+
+#endif // JOBQUEUE_H
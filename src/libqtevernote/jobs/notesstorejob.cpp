@@ -29,11 +29,10 @@ NotesStoreJob::NotesStoreJob(QObject *parent) :
 
 void NotesStoreJob::resetConnection()
 {
-    EvernoteConnection::instance()->setupNotesStore();
-    EvernoteConnection::instance()->connectNotesStore();
+    notesStoreConnection()->reset();
 }
 
 evernote::edam::NoteStoreClient *NotesStoreJob::client() const
 {
-    return EvernoteConnection::instance()->m_notesStoreClient;
+    return notesStoreConnection()->client();
 }
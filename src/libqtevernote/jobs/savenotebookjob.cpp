@@ -40,6 +40,12 @@ bool SaveNotebookJob::operator==(const EvernoteJob *other) const
     return this->m_notebook == otherJob->m_notebook;
 }
 
+bool SaveNotebookJob::supersedes(const EvernoteJob *other) const
+{
+    const SaveNotebookJob *otherJob = qobject_cast<const SaveNotebookJob*>(other);
+    return otherJob && otherJob->m_notebook->guid() == m_notebook->guid();
+}
+
 void SaveNotebookJob::attachToDuplicate(const EvernoteJob *other)
 {
     const SaveNotebookJob *otherJob = static_cast<const SaveNotebookJob*>(other);
@@ -32,6 +32,7 @@ public:
     explicit SaveNotebookJob(Notebook *notebook, QObject *parent = 0);
 
     virtual bool operator==(const EvernoteJob *other) const override;
+    virtual bool supersedes(const EvernoteJob *other) const override;
     virtual void attachToDuplicate(const EvernoteJob *other) override;
 
 signals:
@@ -24,11 +24,8 @@
 SaveNoteJob::SaveNoteJob(Note *note, QObject *parent) :
     NotesStoreJob(parent)
 {
-    // Need to clone it. As startJob() will run in another thread we can't access the real note from there.
-    m_note = note->clone();
-
-    // Make sure we delete the clone when done
-    m_note->setParent(this);
+    // As startJob() will run in another thread we can't access the real note from there.
+    m_note = note->snapshot();
 }
 
 bool SaveNoteJob::operator==(const EvernoteJob *other) const
@@ -38,7 +35,14 @@ bool SaveNoteJob::operator==(const EvernoteJob *other) const
         return false;
     }
     return this->m_note == otherJob->m_note
-            && this->m_note->updateSequenceNumber() == otherJob->m_note->updateSequenceNumber();
+            && this->m_note.record().updateSequenceNumber == otherJob->m_note.record().updateSequenceNumber;
+}
+
+bool SaveNoteJob::supersedes(const EvernoteJob *other) const
+{
+    // We carry the complete state, anything queued earlier for the same guid is outdated
+    const SaveNoteJob *otherJob = qobject_cast<const SaveNoteJob*>(other);
+    return otherJob && otherJob->m_note.guid() == m_note.guid();
 }
 
 void SaveNoteJob::attachToDuplicate(const EvernoteJob *other)
@@ -51,35 +55,36 @@ QString SaveNoteJob::toString() const
 {
     return QString("%1, NoteGuid: %2, UpdateSeq: %3")
             .arg(metaObject()->className())
-            .arg(m_note->guid())
-            .arg(m_note->updateSequenceNumber());
+            .arg(m_note.guid())
+            .arg(m_note.record().updateSequenceNumber);
 }
 
 void SaveNoteJob::startJob()
 {
+    const NoteRecord &record = m_note.record();
     evernote::edam::Note note;
 
-    note.guid = m_note->guid().toStdString();
+    note.guid = m_note.guid().toStdString();
     note.__isset.guid = true;
 
-    note.updateSequenceNum = m_note->updateSequenceNumber();
+    note.updateSequenceNum = record.updateSequenceNumber;
     note.__isset.updateSequenceNum = true;
 
-    note.title = m_note->title().toStdString();
+    note.title = record.title.toStdString();
     note.__isset.title = true;
 
-    note.notebookGuid = m_note->notebookGuid().toStdString();
+    note.notebookGuid = record.notebookGuid.toStdString();
     note.__isset.notebookGuid = true;
 
-    note.updated = m_note->updated().toMSecsSinceEpoch();
+    note.updated = record.updated.toMSecsSinceEpoch();
     note.__isset.updated = true;
 
-    if (m_note->deleted()) {
-        note.active = !m_note->deleted();
-        note.__isset.active = m_note->deleted();
+    if (record.deleted) {
+        note.active = !record.deleted;
+        note.__isset.active = record.deleted;
     } else {
         std::vector<evernote::edam::Guid> tags;
-        foreach (const QString &tag, m_note->tagGuids()) {
+        foreach (const QString &tag, record.tagGuids) {
             tags.push_back(tag.toStdString());
         }
         note.tagGuids = tags;
@@ -89,38 +94,54 @@ void SaveNoteJob::startJob()
         note.__isset.active = true;
 
         note.__isset.attributes = true;
-        note.attributes.reminderOrder = m_note->reminderOrder();
+        note.attributes.reminderOrder = record.reminderOrder;
         note.attributes.__isset.reminderOrder = true;
-        note.attributes.reminderTime = m_note->reminderTime().toMSecsSinceEpoch();
+        note.attributes.reminderTime = record.reminderTime.toMSecsSinceEpoch();
         note.attributes.__isset.reminderTime = true;
-        note.attributes.reminderDoneTime = m_note->reminderDoneTime().toMSecsSinceEpoch();
+        note.attributes.reminderDoneTime = record.reminderDoneTime.toMSecsSinceEpoch();
         note.attributes.__isset.reminderDoneTime = true;
 
-        if (m_note->needsContentSync()) {
-            note.content = m_note->enmlContent().toStdString();
+        if (record.needsContentSync) {
+            note.content = m_note.enmlContent().toStdString();
             note.__isset.content = true;
-            note.contentLength = m_note->enmlContent().length();
+            note.contentLength = m_note.enmlContent().length();
 
+            // The list replaces the note's resources on the server. Those the server has already
+            // got are passed by guid and hash only, just new attachments carry their data.
             note.resources.clear();
-            foreach (Resource *resource, m_note->resources()) {
+            QList<ResourceRecord> resources = m_note.resources();
+            for (int i = 0; i < resources.count(); i++) {
+                const ResourceRecord &resource = resources.at(i);
                 evernote::edam::Resource evResource;
-                evResource.noteGuid = m_note->guid().toStdString();
+                evResource.noteGuid = m_note.guid().toStdString();
                 evResource.__isset.noteGuid = true;
-                evResource.mime = resource->type().toStdString();
+                evResource.mime = resource.type.toStdString();
                 evResource.__isset.mime = true;
 
-                evResource.data.bodyHash = resource->hash().toStdString();
+                QByteArray bodyHash = QByteArray::fromHex(resource.hash.toLatin1());
+                evResource.data.bodyHash.assign(bodyHash.constData(), bodyHash.size());
                 evResource.data.__isset.bodyHash = true;
 
-                QByteArray data = resource->data();
-                evResource.data.body.assign(data.data(), data.length());
-                evResource.data.__isset.body = true;
-
-                evResource.data.size = data.length();
-                evResource.data.__isset.size = true;
+                if (!resource.guid.isEmpty()) {
+                    evResource.guid = resource.guid.toStdString();
+                    evResource.__isset.guid = true;
+
+                    if (resource.size > 0) {
+                        evResource.data.size = resource.size;
+                        evResource.data.__isset.size = true;
+                    }
+                } else {
+                    // Copy straight from the mapped file into the request
+                    MappedFile data = m_note.resourceData(i);
+                    evResource.data.body.assign(data.data(), data.size());
+                    evResource.data.__isset.body = true;
+
+                    evResource.data.size = data.size();
+                    evResource.data.__isset.size = true;
+                }
                 evResource.__isset.data = true;
 
-                evResource.attributes.fileName = resource->fileName().toStdString();
+                evResource.attributes.fileName = resource.fileName.toStdString();
                 evResource.attributes.__isset.fileName = true;
                 evResource.__isset.attributes = true;
 
@@ -131,7 +152,7 @@ void SaveNoteJob::startJob()
     }
 
     // In some error cases it may happen that the resultNote is not filled in. Make sure we have at least the guid
-    m_resultNote.guid = m_note->guid().toStdString();
+    m_resultNote.guid = m_note.guid().toStdString();
 
     client()->updateNote(m_resultNote, token().toStdString(), note);
 }
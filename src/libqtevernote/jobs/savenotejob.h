@@ -22,6 +22,7 @@
 #define SAVENOTEJOB_H
 
 #include "notesstorejob.h"
+#include "notesnapshot.h"
 
 class Note;
 
@@ -32,6 +33,7 @@ public:
     explicit SaveNoteJob(Note *note, QObject *parent = 0);
 
     virtual bool operator==(const EvernoteJob *other) const override;
+    virtual bool supersedes(const EvernoteJob *other) const override;
     virtual void attachToDuplicate(const EvernoteJob *other) override;
 
     virtual QString toString() const override;
@@ -44,7 +46,7 @@ protected:
     void emitJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage);
 
 private:
-    Note* m_note;
+    NoteSnapshot m_note;
     evernote::edam::Note m_resultNote;
 };
 
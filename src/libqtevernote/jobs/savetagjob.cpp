@@ -40,6 +40,12 @@ bool SaveTagJob::operator==(const EvernoteJob *other) const
     return this->m_tag == otherJob->m_tag;
 }
 
+bool SaveTagJob::supersedes(const EvernoteJob *other) const
+{
+    const SaveTagJob *otherJob = qobject_cast<const SaveTagJob*>(other);
+    return otherJob && otherJob->m_tag->guid() == m_tag->guid();
+}
+
 void SaveTagJob::attachToDuplicate(const EvernoteJob *other)
 {
     const SaveTagJob *otherJob = static_cast<const SaveTagJob*>(other);
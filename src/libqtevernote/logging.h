@@ -28,6 +28,7 @@ Q_DECLARE_LOGGING_CATEGORY(dcNotesStore)
 Q_DECLARE_LOGGING_CATEGORY(dcJobQueue)
 Q_DECLARE_LOGGING_CATEGORY(dcConnection)
 Q_DECLARE_LOGGING_CATEGORY(dcSync)
+Q_DECLARE_LOGGING_CATEGORY(dcStorage)
 Q_DECLARE_LOGGING_CATEGORY(dcEnml)
 Q_DECLARE_LOGGING_CATEGORY(dcOrganizer)
 
@@ -33,95 +33,59 @@
 #include <QFile>
 
 Note::Note(const QString &guid, quint32 updateSequenceNumber, QObject *parent) :
+    Note(NoteDataPointer(new NoteData()), parent)
+{
+    m_data->guid = guid;
+    m_data->updateSequenceNumber = updateSequenceNumber;
+    m_data->updateSynced();
+}
+
+Note::Note(const NoteDataPointer &data, QObject *parent) :
     QObject(parent),
-    m_deleted(false),
-    m_isSearchResult(false),
-    m_updateSequenceNumber(updateSequenceNumber),
-    m_loading(false),
-    m_loaded(false),
-    m_needsContentSync(false),
-    m_syncError(false),
-    m_conflicting(false),
+    m_data(data),
     m_conflictingNote(nullptr)
 {
-    setGuid(guid);
-    m_cacheFile.setFileName(NotesStore::instance()->storageLocation() + "note-" + guid + ".enml");
-
-    QSettings infoFile(m_infoFile, QSettings::IniFormat);
-    m_created = infoFile.value("created").toDateTime();
-    m_title = infoFile.value("title").toString();
-    m_updated = infoFile.value("updated").toDateTime();
-    m_notebookGuid = infoFile.value("notebookGuid").toString();
-    m_tagGuids = infoFile.value("tagGuids").toStringList();
-    m_reminderOrder = infoFile.value("reminderOrder").toULongLong();
-    m_reminderTime = infoFile.value("reminderTime").toDateTime();
-    m_reminderDoneTime = infoFile.value("reminderDoneTime").toDateTime();
-    m_deleted = infoFile.value("deleted").toBool();
-    m_tagline = infoFile.value("tagline").toString();
-    m_lastSyncedSequenceNumber = infoFile.value("lastSyncedSequenceNumber", 0).toUInt();
-    m_needsContentSync = infoFile.value("needsContentSync", false).toBool();
-    m_synced = m_lastSyncedSequenceNumber == m_updateSequenceNumber;
-
-    infoFile.beginGroup("resources");
-    foreach (const QString &hash, infoFile.childGroups()) {
-        infoFile.beginGroup(hash);
-        addResource(hash, infoFile.value("fileName").toString(), infoFile.value("type").toString());
-        infoFile.endGroup();
-    }
-    infoFile.endGroup();
-
-    connect(NotesStore::instance(), &NotesStore::notebookGuidChanged, this, &Note::slotNotebookGuidChanged);
-    connect(NotesStore::instance(), &NotesStore::tagGuidChanged, this, &Note::slotTagGuidChanged);
+    m_data->view = this;
 }
 
 Note::~Note()
 {
-    qDeleteAll(m_resources.values());
+    if (m_data->view == this) {
+        m_data->view = nullptr;
+    }
 }
 
 bool Note::loading() const
 {
-    return m_loading;
+    return m_data->loading;
 }
 
 bool Note::synced() const
 {
-    return m_synced;
+    return m_data->synced;
 }
 
 bool Note::syncError() const
 {
-    return m_syncError;
+    return m_data->syncError;
 }
 
 QString Note::guid() const
 {
-    return m_guid;
+    return m_data->guid;
 }
 
 void Note::setGuid(const QString &guid)
 {
-    if (m_guid != guid) {
+    if (m_data->guid != guid) {
 
-        bool syncToFile = false;
-        if (!m_infoFile.isEmpty()) {
-            QFile ifile(m_infoFile);
-            ifile.remove();
-
-            syncToFile = true;
-        }
+        bool syncToFile = !m_data->guid.isEmpty();
 
-        m_guid = guid;
-        QString newCacheFileName = NotesStore::instance()->storageLocation() + "note-" + guid + ".enml";
-        if (m_cacheFile.exists()) {
-            m_cacheFile.rename(newCacheFileName);
-        } else {
-            m_cacheFile.setFileName(newCacheFileName);
-        }
-        m_infoFile = NotesStore::instance()->storageLocation() + "note-" + guid + ".info";
+        QString oldGuid = m_data->guid;
+        m_data->guid = guid;
+        m_data->renameCacheFile(oldGuid);
 
         if (syncToFile) {
-            syncToInfoFile();
             syncToCacheFile();
         }
         emit guidChanged();
@@ -130,345 +94,276 @@ void Note::setGuid(const QString &guid)
 
 QString Note::notebookGuid() const
 {
-    return m_notebookGuid;
+    return m_data->notebookGuid;
 }
 
 void Note::setNotebookGuid(const QString &notebookGuid)
 {
-    if (m_notebookGuid != notebookGuid) {
-        m_notebookGuid = notebookGuid;
+    if (m_data->notebookGuid != notebookGuid) {
+        m_data->notebookGuid = notebookGuid;
         emit notebookGuidChanged();
     }
 }
 
 QDateTime Note::created() const
 {
-    return m_created;
+    return m_data->created;
 }
 
 void Note::setCreated(const QDateTime &created)
 {
-    if (m_created != created) {
-        m_created = created;
+    if (m_data->created != created) {
+        m_data->created = created;
         emit createdChanged();
     }
 }
 
 QString Note::createdString() const
 {
-    QDate createdDate = m_created.date();
-    QDate today = QDate::currentDate();
-    if (createdDate == today) {
-        return gettext("Today");
-    }
-    if (createdDate == today.addDays(-1)) {
-        return gettext("Yesterday");
-    }
-    if (createdDate >= today.addDays(-7)) {
-        return gettext("Last week");
-    }
-    if (createdDate >= today.addDays(-14)) {
-        return gettext("Two weeks ago");
-    }
-
-    // TRANSLATORS: the first argument refers to a month name and the second to a year
-    return QString(gettext("%1 %2")).arg(QLocale::system().standaloneMonthName(createdDate.month())).arg(createdDate.year());
+    return m_data->createdString();
 }
 
 QDateTime Note::updated() const
 {
-    return m_updated;
+    return m_data->updated;
 }
 
 void Note::setUpdated(const QDateTime &updated)
 {
-    if (m_updated!= updated) {
-        m_updated = updated;
+    if (m_data->updated != updated) {
+        m_data->updated = updated;
         emit updatedChanged();
     }
 }
 
 QString Note::updatedString() const
 {
-    QDate updatedDate = m_updated.date();
-    QDate today = QDate::currentDate();
-    if (updatedDate == today) {
-        return gettext("Today");
-    }
-    if (updatedDate == today.addDays(-1)) {
-        return gettext("Yesterday");
-    }
-    if (updatedDate >= today.addDays(-7)) {
-        return gettext("Last week");
-    }
-    if (updatedDate >= today.addDays(-14)) {
-        return gettext("Two weeks ago");
-    }
-
-    // TRANSLATORS: the first argument refers to a month name and the second to a year
-    return QString(gettext("%1 %2")).arg(QLocale::system().standaloneMonthName(updatedDate.month())).arg(updatedDate.year());
+    return m_data->updatedString();
 }
 
 QString Note::title() const
 {
-    return m_title;
+    return m_data->title;
 }
 
 void Note::setTitle(const QString &title)
 {
-    if (m_title != title) {
-        m_title = title;
+    if (m_data->title != title) {
+        m_data->title = title;
         emit titleChanged();
     }
 }
 
 QStringList Note::tagGuids() const
 {
-    return m_tagGuids;
+    return m_data->tagGuids;
 }
 
 void Note::setTagGuids(const QStringList &tagGuids)
 {
-    if (m_tagGuids != tagGuids) {
-        m_tagGuids = tagGuids;
+    if (m_data->tagGuids != tagGuids) {
+        m_data->tagGuids = tagGuids;
         emit tagGuidsChanged();
     }
 }
 
 QString Note::enmlContent() const
 {
-    return m_content.enml();
+    return m_data->content.enml();
 }
 
 void Note::setEnmlContent(const QString &enmlContent)
 {
-    if (m_content.enml() != enmlContent) {
-        m_content.setEnml(enmlContent);
-        m_tagline = m_content.toPlaintext().left(100);
-        emit contentChanged();
+    if (m_data->content.enml() != enmlContent) {
+        m_data->content.setEnml(enmlContent);
+        contentEdited();
 
-        if (m_loaded) {
-            m_needsContentSync = true;
+        if (m_data->loaded) {
+            m_data->needsContentSync = true;
         }
     }
-    m_loaded = true;
+    m_data->loaded = true;
 }
 
 QString Note::htmlContent() const
 {
-    return m_content.toHtml(m_guid);
+    return m_data->content.toHtml(m_data->guid);
 }
 
 QString Note::richTextContent() const
 {
-    return m_content.toRichText(m_guid);
+    return m_data->content.toRichText(m_data->guid);
 }
 
 void Note::setRichTextContent(const QString &richTextContent)
 {
-    if (m_content.toRichText(m_guid) != richTextContent) {
-        m_content.setRichText(richTextContent);
-        m_tagline = m_content.toPlaintext().left(100);
-        emit contentChanged();
+    if (m_data->content.toRichText(m_data->guid) != richTextContent) {
+        m_data->content.setRichText(richTextContent);
+        contentEdited();
 
-        m_needsContentSync = true;
+        m_data->needsContentSync = true;
     }
 }
 
 QString Note::plaintextContent() const
 {
-    return m_content.toPlaintext();
+    return m_data->content.toPlaintext();
 }
 
 QString Note::tagline() const
 {
-    return m_tagline;
+    return m_data->tagline;
 }
 
 bool Note::reminder() const
 {
-    return m_reminderOrder > 0;
+    return m_data->reminder();
 }
 
 void Note::setReminder(bool reminder)
 {
-    if (reminder && m_reminderOrder == 0) {
-        m_reminderOrder = QDateTime::currentMSecsSinceEpoch();
+    if (reminder && m_data->reminderOrder == 0) {
+        m_data->reminderOrder = QDateTime::currentMSecsSinceEpoch();
         emit reminderChanged();
-    } else if (!reminder && m_reminderOrder > 0) {
-        m_reminderOrder = 0;
+    } else if (!reminder && m_data->reminderOrder > 0) {
+        m_data->reminderOrder = 0;
         emit reminderChanged();
     }
 }
 
 qint64 Note::reminderOrder() const
 {
-    return m_reminderOrder;
+    return m_data->reminderOrder;
 }
 
 void Note::setReminderOrder(qint64 reminderOrder)
 {
-    if (m_reminderOrder != reminderOrder) {
-        m_reminderOrder = reminderOrder;
+    if (m_data->reminderOrder != reminderOrder) {
+        m_data->reminderOrder = reminderOrder;
         emit reminderChanged();
     }
 }
 
 bool Note::hasReminderTime() const
 {
-    return !m_reminderTime.isNull();
+    return !m_data->reminderTime.isNull();
 }
 
 void Note::setHasReminderTime(bool hasReminderTime)
 {
-    if (hasReminderTime && m_reminderTime.isNull()) {
-        m_reminderTime = QDateTime::currentDateTime();
+    if (hasReminderTime && m_data->reminderTime.isNull()) {
+        m_data->reminderTime = QDateTime::currentDateTime();
         emit reminderTimeChanged();
-    } else if (!hasReminderTime && !m_reminderTime.isNull()) {
-        m_reminderTime = QDateTime();
+    } else if (!hasReminderTime && !m_data->reminderTime.isNull()) {
+        m_data->reminderTime = QDateTime();
         emit reminderTimeChanged();
     }
 }
 
 QDateTime Note::reminderTime() const
 {
-    return m_reminderTime;
+    return m_data->reminderTime;
 }
 
 void Note::setReminderTime(const QDateTime &reminderTime)
 {
-    if (m_reminderTime != reminderTime) {
-        m_reminderTime = reminderTime;
+    if (m_data->reminderTime != reminderTime) {
+        m_data->reminderTime = reminderTime;
         emit reminderTimeChanged();
     }
 }
 
 bool Note::reminderDone() const
 {
-    return !m_reminderDoneTime.isNull();
+    return m_data->reminderDone();
 }
 
 void Note::setReminderDone(bool reminderDone)
 {
-    if (reminderDone && m_reminderDoneTime.isNull()) {
-        m_reminderDoneTime = QDateTime::currentDateTime();
+    if (reminderDone && m_data->reminderDoneTime.isNull()) {
+        m_data->reminderDoneTime = QDateTime::currentDateTime();
         emit reminderDoneChanged();
-    } else if (!reminderDone && !m_reminderDoneTime.isNull()) {
-        m_reminderDoneTime = QDateTime();
+    } else if (!reminderDone && !m_data->reminderDoneTime.isNull()) {
+        m_data->reminderDoneTime = QDateTime();
         emit reminderDoneChanged();
     }
 }
 
 QString Note::reminderTimeString() const
 {
-    if (m_reminderOrder == 0) {
-        return QString();
-    }
-
-    if (reminderDone()) {
-        return gettext("Done");
-    }
-
-    QDate reminderDate = m_reminderTime.date();
-    QDate today = QDate::currentDate();
-    if (m_reminderTime.isNull()) {
-        return gettext("No date");
-    }
-    if (reminderDate < today) {
-        return gettext("Overdue");
-    }
-    if (reminderDate == today) {
-        return gettext("Today");
-    }
-    if (reminderDate == today.addDays(1)) {
-        return gettext("Tomorrow");
-    }
-    if (reminderDate <= today.addDays(7)) {
-        return gettext("Next week");
-    }
-    if (reminderDate <= today.addDays(14)) {
-        return gettext("In two weeks");
-    }
-    return gettext("Later");
+    return m_data->reminderTimeString();
 }
 
 QDateTime Note::reminderDoneTime() const
 {
-    return m_reminderDoneTime;
+    return m_data->reminderDoneTime;
 }
 
 void Note::setReminderDoneTime(const QDateTime &reminderDoneTime)
 {
-    if (m_reminderDoneTime != reminderDoneTime) {
-        m_reminderDoneTime = reminderDoneTime;
+    if (m_data->reminderDoneTime != reminderDoneTime) {
+        m_data->reminderDoneTime = reminderDoneTime;
         emit reminderDoneChanged();
     }
 }
 
 bool Note::deleted() const
 {
-    return m_deleted;
+    return m_data->deleted;
 }
 
 void Note::setDeleted(bool deleted)
 {
-    if (m_deleted != deleted) {
-        m_deleted = deleted;
+    if (m_data->deleted != deleted) {
+        m_data->deleted = deleted;
         emit deletedChanged();
     }
 }
 
 bool Note::isSearchResult() const
 {
-    return m_isSearchResult;
+    return m_data->isSearchResult;
 }
 
 void Note::setIsSearchResult(bool isSearchResult)
 {
-    if (m_isSearchResult != isSearchResult) {
-        m_isSearchResult = isSearchResult;
+    if (m_data->isSearchResult != isSearchResult) {
+        m_data->isSearchResult = isSearchResult;
         emit isSearchResultChanged();
     }
 }
 
 qint32 Note::updateSequenceNumber() const
 {
-    return m_updateSequenceNumber;
+    return m_data->updateSequenceNumber;
 }
 
 void Note::setUpdateSequenceNumber(qint32 updateSequenceNumber)
 {
-    if (m_updateSequenceNumber != updateSequenceNumber) {
-        m_updateSequenceNumber = updateSequenceNumber;
-
-        m_synced = m_updateSequenceNumber == m_lastSyncedSequenceNumber;
-        if (m_synced) {
-            m_needsContentSync = false;
-        }
+    if (m_data->updateSequenceNumber != updateSequenceNumber) {
+        m_data->updateSequenceNumber = updateSequenceNumber;
+        m_data->updateSynced();
         emit syncedChanged();
     }
 }
 
 qint32 Note::lastSyncedSequenceNumber() const
 {
-    return m_lastSyncedSequenceNumber;
+    return m_data->lastSyncedSequenceNumber;
 }
 
 void Note::setLastSyncedSequenceNumber(qint32 lastSyncedSequenceNumber)
 {
-    if (m_lastSyncedSequenceNumber != lastSyncedSequenceNumber) {
-        m_lastSyncedSequenceNumber = lastSyncedSequenceNumber;
-
-        m_synced = m_updateSequenceNumber == m_lastSyncedSequenceNumber;
-        if (m_synced) {
-            m_needsContentSync = false;
-        }
+    if (m_data->lastSyncedSequenceNumber != lastSyncedSequenceNumber) {
+        m_data->lastSyncedSequenceNumber = lastSyncedSequenceNumber;
+        m_data->updateSynced();
         emit syncedChanged();
     }
 }
 
 QList<Resource*> Note::resources() const
 {
+    createResources();
     return m_resources.values();
 }
 
@@ -479,43 +374,51 @@ Note *Note::conflictingNote() const
 
 QStringList Note::resourceUrls() const
 {
-    QList<QString> ret;
-    foreach (Resource *resource, m_resources) {
-        QUrl url("image://resource/" + resource->type());
-        QUrlQuery arguments;
-        arguments.addQueryItem("noteGuid", m_guid);
-        arguments.addQueryItem("hash", resource->hash());
-        arguments.addQueryItem("loaded", resource->isCached() ? "true" : "false");
-        url.setQuery(arguments);
-        ret << url.toString();
-    }
-    return ret;
+    return m_data->resourceUrls();
 }
 
 Resource* Note::resource(const QString &hash)
 {
+    createResources();
     return m_resources.value(hash);
 }
 
+void Note::createResources() const
+{
+    if (m_resources.count() == m_data->resources.count()) {
+        return;
+    }
+    foreach (const ResourceRecord &record, m_data->resources) {
+        if (!m_resources.contains(record.hash)) {
+            Note *self = const_cast<Note*>(this);
+            m_resources.insert(record.hash, new Resource(record.hash, record.fileName, record.type, self));
+        }
+    }
+}
 
-Resource* Note::addResource(const QString &hash, const QString &fileName, const QString &type, const QByteArray &data)
+Resource* Note::addResource(const ResourceRecord &record)
 {
+    createResources();
+
     Resource *resource;
-    if (m_resources.contains(hash)) {
-        resource = m_resources.value(hash);
-        if (!data.isEmpty()) {
-            resource->setData(data);
+    if (m_resources.contains(record.hash)) {
+        resource = m_resources.value(record.hash);
+        for (int i = 0; i < m_data->resources.count() && !record.guid.isEmpty(); i++) {
+            ResourceRecord &existing = m_data->resources[i];
+            if (existing.hash == record.hash) {
+                existing.guid = record.guid;
+                existing.size = record.size;
+                break;
+            }
         }
     } else {
-        resource = new Resource(data, hash, fileName, type, this);
-        m_resources.insert(hash, resource);
-        QSettings infoFile(m_infoFile, QSettings::IniFormat);
-        infoFile.beginGroup("resources");
-        infoFile.beginGroup(hash);
-        infoFile.setValue("fileName", fileName);
-        infoFile.setValue("type", type);
-        infoFile.endGroup();
-        infoFile.endGroup();
+        resource = new Resource(record.hash, record.fileName, record.type, this);
+        m_resources.insert(record.hash, resource);
+
+        ResourceRecord newRecord = record;
+        // Gets a default file name if there was none
+        newRecord.fileName = resource->fileName();
+        m_data->resources.append(newRecord);
     }
 
     emit resourcesChanged();
@@ -524,9 +427,23 @@ Resource* Note::addResource(const QString &hash, const QString &fileName, const
     return resource;
 }
 
+QList<ResourceRecord> Note::missingResources() const
+{
+    createResources();
+
+    QList<ResourceRecord> missing;
+    foreach (const ResourceRecord &record, m_data->resources) {
+        if (!m_resources.value(record.hash)->isCached()) {
+            missing.append(record);
+        }
+    }
+    return missing;
+}
+
 void Note::markTodo(const QString &todoId, bool checked)
 {
-    m_content.markTodo(todoId, checked);
+    m_data->content.markTodo(todoId, checked);
+    m_data->contentModified = true;
 }
 
 void Note::attachFile(int position, const QUrl &fileName)
@@ -537,17 +454,16 @@ void Note::attachFile(int position, const QUrl &fileName)
         return;
     }
 
+    createResources();
+
     Resource *resource = new Resource(fileName.path(), this);
     m_resources.insert(resource->hash(), resource);
-    m_content.attachFile(position, resource->hash(), resource->type());
-
-    QSettings infoFile(m_infoFile, QSettings::IniFormat);
-    infoFile.beginGroup("resources");
-    infoFile.beginGroup(resource->hash());
-    infoFile.setValue("fileName", resource->fileName());
-    infoFile.setValue("type", resource->type());
-    infoFile.endGroup();
-    infoFile.endGroup();
+    ResourceRecord record;
+    record.hash = resource->hash();
+    record.fileName = resource->fileName();
+    record.type = resource->type();
+    m_data->resources.append(record);
+    m_data->content.attachFile(position, resource->hash(), resource->type());
 
     emit resourcesChanged();
     emit contentChanged();
@@ -557,208 +473,206 @@ void Note::attachFile(int position, const QUrl &fileName)
     // can browse to unconfined files, this needs to be made conditional to not delete those files!
     importedFile.remove();
 
-    m_needsContentSync = true;
+    m_data->contentModified = true;
+    m_data->needsContentSync = true;
 }
 
 void Note::addTag(const QString &tagGuid)
 {
-    NotesStore::instance()->tagNote(m_guid, tagGuid);
+    NotesStore::instance()->tagNote(m_data->guid, tagGuid);
 }
 
 void Note::removeTag(const QString &tagGuid)
 {
-    NotesStore::instance()->untagNote(m_guid, tagGuid);
+    NotesStore::instance()->untagNote(m_data->guid, tagGuid);
 }
 
 void Note::insertText(int position, const QString &text)
 {
-    m_content.insertText(position, text);
-    m_tagline = m_content.toPlaintext().left(100);
-    emit contentChanged();
+    m_data->content.insertText(position, text);
+    contentEdited();
 }
 
 void Note::insertLink(int position, const QString &url)
 {
-    m_content.insertLink(position, url);
-    m_tagline = m_content.toPlaintext().left(100);
+    m_data->content.insertLink(position, url);
+    contentEdited();
+}
+
+QByteArray Note::contentHash() const
+{
+    return m_data->contentHash;
+}
+
+void Note::setContentHash(const QByteArray &contentHash, qint32 contentLength)
+{
+    m_data->contentHash = contentHash;
+    m_data->contentLength = contentLength;
+}
+
+void Note::contentEdited()
+{
+    m_data->tagline = m_data->content.toPlaintext().left(100);
+    m_data->contentModified = true;
+    // Doesn't match the server's any more. Set again once the server sent us its hash.
+    m_data->contentHash.clear();
+    m_data->contentLength = 0;
     emit contentChanged();
 }
 
 int Note::renderWidth() const
 {
-    return m_content.renderWidth();
+    return m_data->content.renderWidth();
 }
 
 void Note::setRenderWidth(int renderWidth)
 {
-    if (m_content.renderWidth() != renderWidth) {
-        m_content.setRenderWidth(renderWidth);
+    if (m_data->content.renderWidth() != renderWidth) {
+        m_data->content.setRenderWidth(renderWidth);
         emit contentChanged();
     }
 }
 
-Note *Note::clone()
+NoteSnapshot Note::snapshot() const
 {
-    Note *note = new Note(m_guid, m_updateSequenceNumber);
-    note->setCreated(m_created);
-    note->setNotebookGuid(m_notebookGuid);
-    note->setTitle(m_title);
-    note->setUpdated(m_updated);
-    note->setEnmlContent(m_content.enml());
-    note->setReminderOrder(m_reminderOrder);
-    note->setReminderTime(m_reminderTime);
-    note->setReminderDoneTime(m_reminderDoneTime);
-    note->setIsSearchResult(m_isSearchResult);
-    note->setTagGuids(m_tagGuids);
-    note->setUpdateSequenceNumber(m_updateSequenceNumber);
-    note->setDeleted(m_deleted);
-    foreach (Resource *resource, m_resources) {
-        note->addResource(resource->hash(), resource->fileName(), resource->type(), resource->data());
-    }
-    note->m_needsContentSync = m_needsContentSync;
-
-    return note;
+    return NoteSnapshot(*m_data);
 }
 
 bool Note::isCached() const
 {
-    return m_cacheFile.exists();
+    return m_data->isCached();
 }
 
 bool Note::loaded() const
 {
-    return m_loaded;
+    return m_data->loaded;
 }
 
 void Note::save()
 {
-    NotesStore::instance()->saveNote(m_guid);
+    NotesStore::instance()->saveNote(m_data->guid);
 }
 
 void Note::remove()
 {
-    NotesStore::instance()->deleteNote(m_guid);
+    NotesStore::instance()->deleteNote(m_data->guid);
 }
 
 void Note::setLoading(bool loading)
 {
-    if (m_loading != loading) {
-        m_loading = loading;
+    if (m_data->loading != loading) {
+        m_data->loading = loading;
         emit loadingChanged();
     }
 }
 
 void Note::setSyncError(bool syncError)
 {
-    if (m_syncError != syncError) {
-        m_syncError = syncError;
+    if (m_data->syncError != syncError) {
+        m_data->syncError = syncError;
         emit syncErrorChanged();
     }
 }
 
-void Note::syncToInfoFile()
+NoteRecord Note::record() const
 {
-    QSettings infoFile(m_infoFile, QSettings::IniFormat);
-    infoFile.setValue("created", m_created);
-    infoFile.setValue("title", m_title);
-    infoFile.setValue("updated", m_updated);
-    infoFile.setValue("needsContentSync", m_needsContentSync);
-
-    infoFile.setValue("notebookGuid", m_notebookGuid);
-    infoFile.setValue("tagGuids", m_tagGuids);
-    infoFile.setValue("reminderOrder", m_reminderOrder);
-    infoFile.setValue("reminderTime", m_reminderTime);
-    infoFile.setValue("reminderDoneTime", m_reminderDoneTime);
-    infoFile.setValue("deleted", m_deleted);
-    infoFile.setValue("lastSyncedSequenceNumber", m_lastSyncedSequenceNumber);
+    return m_data->record();
 }
 
 void Note::syncToCacheFile()
 {
-    QSettings infoFile(m_infoFile, QSettings::IniFormat);
-    infoFile.setValue("tagline", m_tagline);
-
-    if (m_cacheFile.open(QFile::WriteOnly | QFile::Truncate)) {
-        m_cacheFile.write(m_content.enml().toUtf8());
-        m_cacheFile.close();
+    if (m_data->writeCacheFile(m_data->content.enml())) {
+        m_data->contentModified = false;
     }
 }
 
 void Note::load(bool priorityHigh)
 {
-    if (!m_loaded && isCached()) {
+    if (!m_data->loaded && isCached()) {
         loadFromCacheFile();
     }
 
-    if (!m_loaded) {
-        NotesStore::instance()->refreshNoteContent(m_guid, FetchNoteJob::LoadContent, priorityHigh ? EvernoteJob::JobPriorityHigh : EvernoteJob::JobPriorityMedium);
+    if (!m_data->loaded) {
+        NotesStore::instance()->refreshNoteContent(m_data->guid, FetchNoteJob::LoadContent, priorityHigh ? EvernoteJob::JobPriorityHigh : EvernoteJob::JobPriorityMedium);
         return;
     }
 
-    // Check if resources are loaded
-    foreach (Resource *resource, m_resources) {
-        if (!resource->isCached()) {
-            NotesStore::instance()->refreshNoteContent(m_guid, FetchNoteJob::LoadResources, priorityHigh ? EvernoteJob::JobPriorityHigh : EvernoteJob::JobPriorityLow);
-            break;
-        }
+    // Fetch the data of those resources which aren't in the cache
+    if (!missingResources().isEmpty()) {
+        NotesStore::instance()->refreshNoteContent(m_data->guid, FetchNoteJob::LoadResources, priorityHigh ? EvernoteJob::JobPriorityHigh : EvernoteJob::JobPriorityLow);
     }
 }
 
 void Note::loadFromCacheFile() const
 {
-    if (m_cacheFile.exists() && m_cacheFile.open(QFile::ReadOnly)) {
-        m_content.setEnml(QString::fromUtf8(m_cacheFile.readAll()).trimmed());
-        m_tagline = m_content.toPlaintext().left(100);
-        m_cacheFile.close();
-        qCDebug(dcNotesStore) << "Loaded note content from disk:" << m_guid;
+    QString enml;
+    if (m_data->readCacheFile(&enml)) {
+        m_data->content.setEnml(enml.trimmed());
+        m_data->tagline = m_data->content.toPlaintext().left(100);
+        m_data->contentModified = false;
+        qCDebug(dcNotesStore) << "Loaded note content from disk:" << m_data->guid;
     } else {
-        qCDebug(dcNotesStore) << "Failed attempt to load note content from disk:" << m_guid;
+        qCDebug(dcNotesStore) << "Failed attempt to load note content from disk:" << m_data->guid;
     }
-    m_loaded = true;
+    m_data->loaded = true;
 }
 
 void Note::deleteFromCache()
 {
-    if (m_cacheFile.exists()) {
-        m_cacheFile.remove();
-    }
-    QFile f(m_infoFile);
-    if (f.exists()) {
-        f.remove();
-    }
+    m_data->removeCacheFile();
 }
 
-void Note::slotNotebookGuidChanged(const QString &oldGuid, const QString &newGuid)
+void Note::setData(const NoteDataPointer &data)
 {
-    if (m_notebookGuid == oldGuid) {
-        m_notebookGuid = newGuid;
-        emit notebookGuidChanged();
+    if (m_data->view == this) {
+        m_data->view = nullptr;
     }
+    m_data = data;
+    m_data->view = this;
+
+    qDeleteAll(m_resources);
+    m_resources.clear();
+
+    emit guidChanged();
+    emit createdChanged();
+    emit titleChanged();
+    emit updatedChanged();
+    emit notebookGuidChanged();
+    emit tagGuidsChanged();
+    emit contentChanged();
+    emit resourcesChanged();
+    emit reminderChanged();
+    emit reminderTimeChanged();
+    emit reminderDoneChanged();
+    emit isSearchResultChanged();
+    emit updateSequenceNumberChanged();
+    emit loadedChanged();
+    emit deletedChanged();
+    emit loadingChanged();
+    emit syncedChanged();
+    emit syncErrorChanged();
+    emit conflictingChanged();
 }
 
-void Note::slotTagGuidChanged(const QString &oldGuid, const QString &newGuid)
+bool Note::isBusy() const
 {
-    int idx = m_tagGuids.indexOf(oldGuid);
-    if (idx != -1) {
-        m_tagGuids.replace(idx, newGuid);
-        emit tagGuidsChanged();
-    }
+    return m_data->loading || m_data->contentModified || m_conflictingNote;
 }
 
 bool Note::conflicting() const
 {
-    return m_conflicting;
+    return m_data->conflicting;
 }
 
 bool Note::needsContentSync() const
 {
-    return m_needsContentSync;
+    return m_data->needsContentSync;
 }
 
 void Note::setConflicting(bool conflicting)
 {
-    if (m_conflicting != conflicting) {
-        m_conflicting = conflicting;
+    if (m_data->conflicting != conflicting) {
+        m_data->conflicting = conflicting;
         emit conflictingChanged();
     }
 }
@@ -21,21 +21,19 @@
 #ifndef NOTE_H
 #define NOTE_H
 
-#include "utils/enmldocument.h"
+#include "notedata.h"
+#include "notesnapshot.h"
 #include "resource.h"
 
 #include <QObject>
 #include <QDateTime>
 #include <QStringList>
 #include <QImage>
-#include <QFile>
-#include <QSettings>
 
 class Note : public QObject
 {
     Q_OBJECT
 
-    // Don't forget to update clone() if you add properties!
     Q_PROPERTY(QString guid READ guid NOTIFY guidChanged)
     Q_PROPERTY(QString notebookGuid READ notebookGuid WRITE setNotebookGuid NOTIFY notebookGuidChanged)
     Q_PROPERTY(QDateTime created READ created NOTIFY createdChanged)
@@ -61,9 +59,7 @@ class Note : public QObject
     Q_PROPERTY(bool deleted READ deleted NOTIFY deletedChanged)
     Q_PROPERTY(bool conflicting READ conflicting NOTIFY conflictingChanged)
     Q_PROPERTY(bool loaded READ loaded NOTIFY loadedChanged)
-    // Don't forget to update clone() if you add properties!
 
-    // Don't clone() "loading" property as results of any current loading operation won't affect the clone.
     Q_PROPERTY(bool loading READ loading NOTIFY loadingChanged)
     Q_PROPERTY(bool synced READ synced NOTIFY syncedChanged)
     Q_PROPERTY(bool syncError READ syncError NOTIFY syncErrorChanged)
@@ -78,7 +74,12 @@ class Note : public QObject
 public:
     explicit Note(const QString &guid, quint32 updateSequenceNumber, QObject *parent = 0);
     ~Note();
-    Note* clone();
+
+    // An immutable copy of the current state, for use in other threads
+    NoteSnapshot snapshot() const;
+
+    // Returns the persistent part of this note, as written to the snapshot file
+    NoteRecord record() const;
 
     QString guid() const;
     void setGuid(const QString &guid);
@@ -202,54 +203,46 @@ signals:
 
     void renderWidthChanged();
 
-private slots:
-    void slotNotebookGuidChanged(const QString &oldGuid, const QString &newGuid);
-    void slotTagGuidChanged(const QString &oldGuid, const QString &newGuid);
-
 private:
+    // Notes in the NotesStore are created by it on demand, working on its NoteData
+    explicit Note(const NoteDataPointer &data, QObject *parent = 0);
+
     // Those should only be called from NotesStore, which is a friend
     void setLoading(bool loading);
     void setSyncError(bool syncError);
     void setDeleted(bool deleted);
     void syncToCacheFile();
-    void syncToInfoFile();
     void deleteFromCache();
     void setUpdateSequenceNumber(qint32 updateSequenceNumber);
     void setLastSyncedSequenceNumber(qint32 lastSyncedSequenceNumber);
     void setConflicting(bool conflicting);
     void setConflictingNote(Note *serverNote);
-    Resource *addResource(const QString &hash, const QString &fileName, const QString &type, const QByteArray &data = QByteArray());
+    // What the server reported for the content we have, see NoteRecord::contentHash
+    QByteArray contentHash() const;
+    void setContentHash(const QByteArray &contentHash, qint32 contentLength);
+    // Adds the resource unless it's there already. The server's guid and size are taken over
+    // in any case, if known. The data is expected in the cache (see Resource::cachePath()).
+    Resource *addResource(const ResourceRecord &record);
+    // Resources whose data isn't in the cache
+    QList<ResourceRecord> missingResources() const;
     void addMissingResource();
     void setMissingResources(int missingResources);
 
     void loadFromCacheFile() const;
 
+    // Switches this note over to other data, e.g. when replacing a note with its server version.
+    void setData(const NoteDataPointer &data);
+
+    // Whether the note is being worked on. The NotesStore doesn't release busy notes.
+    bool isBusy() const;
+
+    // Resource objects are only created when asked for
+    void createResources() const;
+    void contentEdited();
+
 private:
-    QString m_guid;
-    QString m_notebookGuid;
-    QDateTime m_created;
-    QDateTime m_updated;
-    QString m_title;
-    QStringList m_tagGuids;
-    mutable EnmlDocument m_content; // loaded from cache on demand in const methods
-    mutable QString m_tagline; // loaded from cache on demand in const methods
-    qint64 m_reminderOrder;
-    QDateTime m_reminderTime;
-    QDateTime m_reminderDoneTime;
-    bool m_deleted;
-    bool m_isSearchResult;
-    QHash<QString, Resource*> m_resources;
-    qint32 m_updateSequenceNumber;
-    qint32 m_lastSyncedSequenceNumber;
-    mutable QFile m_cacheFile;
-    QString m_infoFile;
-
-    bool m_loading;
-    mutable bool m_loaded;
-    bool m_synced;
-    bool m_needsContentSync;
-    bool m_syncError;
-    bool m_conflicting;
+    NoteDataPointer m_data;
+    mutable QHash<QString, Resource*> m_resources;
 
     Note *m_conflictingNote;
 
@@ -30,6 +30,7 @@
 Notebook::Notebook(QString guid, quint32 updateSequenceNumber, QObject *parent) :
     QObject(parent),
     m_updateSequenceNumber(updateSequenceNumber),
+    m_lastSyncedSequenceNumber(0),
     m_guid(guid),
     m_published(false),
     m_isDefaultNotebook(false),
@@ -37,25 +38,33 @@ Notebook::Notebook(QString guid, quint32 updateSequenceNumber, QObject *parent)
     m_loading(false),
     m_syncError(false)
 {
-    setGuid(guid);
-    QSettings infoFile(m_infoFile, QSettings::IniFormat);
-    m_name = infoFile.value("name").toString();
-    m_published = infoFile.value("published").toBool();
-    m_lastUpdated = infoFile.value("lastUpdated").toDateTime();
-    m_lastSyncedSequenceNumber = infoFile.value("lastSyncedSequenceNumber", 0).toUInt();
-    m_isDefaultNotebook = infoFile.value("isDefaultNotebook", false).toBool();
     m_synced = m_lastSyncedSequenceNumber == m_updateSequenceNumber;
-    m_deleted = infoFile.value("deleted", false).toBool();
+}
 
-    foreach (Note *note, NotesStore::instance()->notes()) {
-        if (note->notebookGuid() == m_guid) {
-            m_notesList.append(note->guid());
-        }
-    }
-    connect(NotesStore::instance(), &NotesStore::noteAdded, this, &Notebook::noteAdded);
-    connect(NotesStore::instance(), &NotesStore::noteRemoved, this, &Notebook::noteRemoved);
-    connect(NotesStore::instance(), &NotesStore::noteChanged, this, &Notebook::noteChanged);
-    connect(NotesStore::instance(), &NotesStore::noteGuidChanged, this, &Notebook::noteGuidChanged);
+Notebook::Notebook(const NotebookRecord &record, QObject *parent) :
+    Notebook(record.guid, record.updateSequenceNumber, parent)
+{
+    m_name = record.name;
+    m_published = record.published;
+    m_lastUpdated = record.lastUpdated;
+    m_lastSyncedSequenceNumber = record.lastSyncedSequenceNumber;
+    m_isDefaultNotebook = record.isDefaultNotebook;
+    m_deleted = record.deleted;
+    m_synced = m_lastSyncedSequenceNumber == m_updateSequenceNumber;
+}
+
+NotebookRecord Notebook::record() const
+{
+    NotebookRecord record;
+    record.guid = m_guid;
+    record.updateSequenceNumber = m_updateSequenceNumber;
+    record.lastSyncedSequenceNumber = m_lastSyncedSequenceNumber;
+    record.name = m_name;
+    record.published = m_published;
+    record.lastUpdated = m_lastUpdated;
+    record.isDefaultNotebook = m_isDefaultNotebook;
+    record.deleted = m_deleted;
+    return record;
 }
 
 QString Notebook::guid() const
@@ -78,12 +87,12 @@ void Notebook::setName(const QString &name)
 
 int Notebook::noteCount() const
 {
-    return m_notesList.count();
+    return NotesStore::instance()->notesInNotebook(m_guid).count();
 }
 
 QString Notebook::noteAt(int index) const
 {
-    return m_notesList.at(index);
+    return NotesStore::instance()->notesInNotebook(m_guid).at(index);
 }
 
 bool Notebook::published() const
@@ -167,85 +176,12 @@ void Notebook::save()
     NotesStore::instance()->saveNotebook(m_guid);
 }
 
-void Notebook::noteAdded(const QString &noteGuid, const QString &notebookGuid)
-{
-    Q_UNUSED(noteGuid)
-    if (notebookGuid == m_guid) {
-        m_notesList.append(noteGuid);
-        emit noteCountChanged();
-    }
-}
-
-void Notebook::noteRemoved(const QString &noteGuid, const QString &notebookGuid)
-{
-    Q_UNUSED(noteGuid)
-    if (notebookGuid == m_guid) {
-        m_notesList.removeAll(noteGuid);
-        emit noteCountChanged();
-    }
-}
-
-void Notebook::noteChanged(const QString &noteGuid, const QString &notebookGuid)
-{
-    if (notebookGuid != m_guid) {
-        if (m_notesList.contains(noteGuid)) {
-            m_notesList.removeAll(noteGuid);
-            emit noteCountChanged();
-        }
-    } else {
-        if (!m_notesList.contains(noteGuid)) {
-            m_notesList.append(noteGuid);
-            emit noteCountChanged();
-        }
-    }
-}
-
-void Notebook::noteGuidChanged(const QString &oldGuid, const QString &newGuid)
-{
-    int oldIndex = m_notesList.indexOf(oldGuid);
-    if (oldIndex != -1) {
-        m_notesList.replace(oldIndex, newGuid);
-    }
-}
-
 void Notebook::setGuid(const QString &guid)
 {
-    bool syncToFile = false;
-    if (!m_infoFile.isEmpty()) {
-        QFile ifile(m_infoFile);
-        ifile.remove();
-
-        syncToFile = true;
-    }
-
     m_guid = guid;
-    m_infoFile = NotesStore::instance()->storageLocation() + "notebook-" + guid + ".info";
-
-    if (syncToFile) {
-        syncToInfoFile();
-    }
     emit guidChanged();
 }
 
-void Notebook::syncToInfoFile()
-{
-    QSettings infoFile(m_infoFile, QSettings::IniFormat);
-    infoFile.setValue("name", m_name);
-    infoFile.setValue("published", m_published);
-    infoFile.value("lastUpdated", m_lastUpdated);
-    infoFile.setValue("lastSyncedSequenceNumber", m_lastSyncedSequenceNumber);
-    infoFile.setValue("isDefaultNotebook", m_isDefaultNotebook);
-    infoFile.setValue("deleted", m_deleted);
-}
-
-void Notebook::deleteInfoFile()
-{
-    QFile f(m_infoFile);
-    if (f.exists()) {
-        f.remove();
-    }
-}
-
 bool Notebook::loading() const
 {
     return m_loading;
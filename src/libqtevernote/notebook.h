@@ -21,9 +21,10 @@
 #ifndef NOTEBOOK_H
 #define NOTEBOOK_H
 
+#include "utils/cachesnapshot.h"
+
 #include <QObject>
 #include <QDateTime>
-#include <QSettings>
 
 class Notebook : public QObject
 {
@@ -46,6 +47,10 @@ class Notebook : public QObject
 
 public:
     explicit Notebook(QString guid, quint32 updateSequenceNumber, QObject *parent = 0);
+    explicit Notebook(const NotebookRecord &record, QObject *parent = 0);
+
+    // Returns the persistent part of this notebook, as written to the snapshot file
+    NotebookRecord record() const;
 
     QString guid() const;
 
@@ -91,12 +96,6 @@ signals:
     void isDefaultNotebookChanged();
     void deletedChanged();
 
-private slots:
-    void noteAdded(const QString &noteGuid, const QString &notebookGuid);
-    void noteRemoved(const QString &noteGuid, const QString &notebookGuid);
-    void noteChanged(const QString &noteGuid, const QString &notebookGuid);
-    void noteGuidChanged(const QString &oldGuid, const QString &newGuid);
-
 private:
     void setGuid(const QString &guid);
 
@@ -106,9 +105,6 @@ private:
     void setLastSyncedSequenceNumber(qint32 lastSyncedSequenceNumber);
     void setDeleted(bool deleted);
 
-    void syncToInfoFile();
-    void deleteInfoFile();
-
 private:
     qint32 m_updateSequenceNumber;
     qint32 m_lastSyncedSequenceNumber;
@@ -117,11 +113,8 @@ private:
     bool m_published;
     QDateTime m_lastUpdated;
     bool m_isDefaultNotebook;
-    QList<QString> m_notesList;
     bool m_deleted;
 
-    QString m_infoFile;
-
     bool m_loading;
     bool m_synced;
     bool m_syncError;
@@ -0,0 +1,249 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "notedata.h"
+#include "notesstore.h"
+#include "resource.h"
+#include "logging.h"
+#include "utils/contentcompressor.h"
+
+#include <libintl.h>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QLocale>
+#include <QUrl>
+#include <QUrlQuery>
+
+static QString relativeDateString(const QDate &date)
+{
+    QDate today = QDate::currentDate();
+    if (date == today) {
+        return gettext("Today");
+    }
+    if (date == today.addDays(-1)) {
+        return gettext("Yesterday");
+    }
+    if (date >= today.addDays(-7)) {
+        return gettext("Last week");
+    }
+    if (date >= today.addDays(-14)) {
+        return gettext("Two weeks ago");
+    }
+
+    // TRANSLATORS: the first argument refers to a month name and the second to a year
+    return QString(gettext("%1 %2")).arg(QLocale::system().standaloneMonthName(date.month())).arg(date.year());
+}
+
+static QString cacheFileName(const QString &guid, bool compressed)
+{
+    return NotesStore::instance()->storageLocation() + "note-" + guid + (compressed ? ".enmlz" : ".enml");
+}
+
+#ifdef COMPRESS_NOTE_CONTENT
+static const bool s_compressContent = true;
+#else
+static const bool s_compressContent = false;
+#endif
+
+NoteData::NoteData():
+    loaded(false),
+    contentModified(false),
+    isSearchResult(false),
+    loading(false),
+    synced(true),
+    syncError(false),
+    conflicting(false),
+    view(nullptr)
+{
+}
+
+NoteData::NoteData(const NoteRecord &record):
+    NoteRecord(record),
+    loaded(false),
+    contentModified(false),
+    isSearchResult(false),
+    loading(false),
+    syncError(false),
+    conflicting(false),
+    view(nullptr)
+{
+    synced = lastSyncedSequenceNumber == updateSequenceNumber;
+}
+
+NoteData::NoteData(const NoteData &other):
+    QSharedData(other),
+    NoteRecord(other),
+    content(other.content),
+    loaded(other.loaded),
+    contentModified(other.contentModified),
+    isSearchResult(other.isSearchResult),
+    loading(false),
+    synced(other.synced),
+    syncError(other.syncError),
+    conflicting(other.conflicting),
+    view(nullptr)
+{
+}
+
+bool NoteData::reminder() const
+{
+    return reminderOrder > 0;
+}
+
+bool NoteData::reminderDone() const
+{
+    return !reminderDoneTime.isNull();
+}
+
+QString NoteData::createdString() const
+{
+    return relativeDateString(created.date());
+}
+
+QString NoteData::updatedString() const
+{
+    return relativeDateString(updated.date());
+}
+
+QString NoteData::reminderTimeString() const
+{
+    if (reminderOrder == 0) {
+        return QString();
+    }
+
+    if (reminderDone()) {
+        return gettext("Done");
+    }
+
+    QDate reminderDate = reminderTime.date();
+    QDate today = QDate::currentDate();
+    if (reminderTime.isNull()) {
+        return gettext("No date");
+    }
+    if (reminderDate < today) {
+        return gettext("Overdue");
+    }
+    if (reminderDate == today) {
+        return gettext("Today");
+    }
+    if (reminderDate == today.addDays(1)) {
+        return gettext("Tomorrow");
+    }
+    if (reminderDate <= today.addDays(7)) {
+        return gettext("Next week");
+    }
+    if (reminderDate <= today.addDays(14)) {
+        return gettext("In two weeks");
+    }
+    return gettext("Later");
+}
+
+QStringList NoteData::resourceUrls() const
+{
+    QStringList ret;
+    foreach (const ResourceRecord &resource, resources) {
+        QUrl url("image://resource/" + resource.type);
+        QUrlQuery arguments;
+        arguments.addQueryItem("noteGuid", guid);
+        arguments.addQueryItem("hash", resource.hash);
+        arguments.addQueryItem("loaded", QFileInfo::exists(Resource::cachePath(resource.hash, resource.fileName)) ? "true" : "false");
+        url.setQuery(arguments);
+        ret << url.toString();
+    }
+    return ret;
+}
+
+QString NoteData::cacheFileName() const
+{
+    return ::cacheFileName(guid, s_compressContent);
+}
+
+bool NoteData::isCached() const
+{
+    return QFile::exists(::cacheFileName(guid, s_compressContent)) || QFile::exists(::cacheFileName(guid, !s_compressContent));
+}
+
+bool NoteData::readCacheFile(QString *enml) const
+{
+    // Prefer the current format, but still pick up what was written in the other one
+    foreach (bool compressed, QList<bool>() << s_compressContent << !s_compressContent) {
+        QFile cacheFile(::cacheFileName(guid, compressed));
+        if (!cacheFile.open(QFile::ReadOnly)) {
+            continue;
+        }
+        QByteArray data = cacheFile.readAll();
+        if (ContentCompressor::isCompressed(data)) {
+            data = ContentCompressor::uncompress(data);
+            if (data.isNull()) {
+                qCWarning(dcStorage) << "Cached note content is damaged:" << cacheFile.fileName();
+                continue;
+            }
+        }
+        *enml = QString::fromUtf8(data);
+        return true;
+    }
+    return false;
+}
+
+bool NoteData::writeCacheFile(const QString &enml) const
+{
+    QByteArray data = enml.toUtf8();
+    if (s_compressContent) {
+        QByteArray compressed = ContentCompressor::compress(data);
+        if (!compressed.isNull()) {
+            data = compressed;
+        }
+    }
+
+    QFile cacheFile(cacheFileName());
+    if (!cacheFile.open(QFile::WriteOnly | QFile::Truncate)) {
+        qCWarning(dcStorage) << "Cannot write note content to" << cacheFile.fileName();
+        return false;
+    }
+    cacheFile.write(data);
+    cacheFile.close();
+
+    // Don't leave an outdated copy in the other format around
+    QFile::remove(::cacheFileName(guid, !s_compressContent));
+    return true;
+}
+
+void NoteData::renameCacheFile(const QString &oldGuid) const
+{
+    foreach (bool compressed, QList<bool>() << true << false) {
+        QString oldFileName = ::cacheFileName(oldGuid, compressed);
+        if (QFile::exists(oldFileName)) {
+            QFile::rename(oldFileName, ::cacheFileName(guid, compressed));
+        }
+    }
+}
+
+void NoteData::removeCacheFile() const
+{
+    QFile::remove(::cacheFileName(guid, true));
+    QFile::remove(::cacheFileName(guid, false));
+}
+
+void NoteData::updateSynced()
+{
+    synced = updateSequenceNumber == lastSyncedSequenceNumber;
+    if (synced) {
+        needsContentSync = false;
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NOTEDATA_H
+#define NOTEDATA_H
+
+#include "utils/cachesnapshot.h"
+#include "utils/enmldocument.h"
+
+#include <QSharedData>
+#include <QExplicitlySharedDataPointer>
+
+class Note;
+
+// The state of a note. The NotesStore keeps one of those per note. A Note QObject is only
+// created when somebody (QML, a job) asks for it and then works on the same NoteData.
+// The persistent part is the NoteRecord this inherits from, the rest is runtime state.
+class NoteData: public QSharedData, public NoteRecord
+{
+public:
+    NoteData();
+    explicit NoteData(const NoteRecord &record);
+    NoteData(const NoteData &other);
+
+    const NoteRecord &record() const { return *this; }
+
+    bool reminder() const;
+    bool reminderDone() const;
+
+    QString createdString() const;
+    QString updatedString() const;
+    QString reminderTimeString() const;
+    QStringList resourceUrls() const;
+
+    // The note's content is cached in note-<guid>.enmlz, zlib compressed, or in
+    // note-<guid>.enml if built without COMPRESS_NOTE_CONTENT. Either one is read.
+    QString cacheFileName() const;
+    bool isCached() const;
+    bool readCacheFile(QString *enml) const;
+    bool writeCacheFile(const QString &enml) const;
+    void renameCacheFile(const QString &oldGuid) const;
+    void removeCacheFile() const;
+
+    void updateSynced();
+
+    // Only loaded on demand. Dropped again when the Note is released and the content
+    // can be reloaded from the cache file.
+    EnmlDocument content;
+    bool loaded;
+    // Content has been changed since it was last written to the cache file
+    bool contentModified;
+
+    bool isSearchResult;
+    bool loading;
+    bool synced;
+    bool syncError;
+    bool conflicting;
+
+    // The Note currently representing this data, if any
+    Note *view;
+
+    // Notebook and tags this note is currently listed under in the NotesStore's
+    // reverse indices. Not copied, a copy isn't indexed.
+    QString indexedNotebookGuid;
+    QStringList indexedTagGuids;
+};
+
+typedef QExplicitlySharedDataPointer<NoteData> NoteDataPointer;
+
+#endif // NOTEDATA_H
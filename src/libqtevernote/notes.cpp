@@ -214,8 +214,7 @@ bool Notes::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) con
         }
     }
     if (m_onlySearchResults) {
-        Note *note = NotesStore::instance()->note(sourceModel()->data(sourceIndex, NotesStore::RoleGuid).toString());
-        if (!note->isSearchResult()) {
+        if (!sourceModel()->data(sourceIndex, NotesStore::RoleIsSearchResult).toBool()) {
             return false;
         }
     }
@@ -0,0 +1,67 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "notesnapshot.h"
+#include "notedata.h"
+#include "resource.h"
+
+NoteSnapshot::NoteSnapshot()
+{
+}
+
+NoteSnapshot::NoteSnapshot(const NoteData &data)
+{
+    Data *snapshot = new Data;
+    snapshot->record = data.record();
+    snapshot->enmlContent = data.content.enml();
+    // Resolved here, the storage location isn't to be looked up from other threads
+    foreach (const ResourceRecord &resource, data.resources) {
+        snapshot->resourceFilePaths.append(Resource::cachePath(resource.hash, resource.fileName));
+    }
+    d = snapshot;
+}
+
+bool NoteSnapshot::isNull() const
+{
+    return !d;
+}
+
+const NoteRecord &NoteSnapshot::record() const
+{
+    return d->record;
+}
+
+QString NoteSnapshot::guid() const
+{
+    return d->record.guid;
+}
+
+QString NoteSnapshot::enmlContent() const
+{
+    return d->enmlContent;
+}
+
+QList<ResourceRecord> NoteSnapshot::resources() const
+{
+    return d->record.resources;
+}
+
+MappedFile NoteSnapshot::resourceData(int index) const
+{
+    return MappedFile(d->resourceFilePaths.at(index));
+}
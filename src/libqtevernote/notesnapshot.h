@@ -0,0 +1,61 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NOTESNAPSHOT_H
+#define NOTESNAPSHOT_H
+
+#include "utils/cachesnapshot.h"
+#include "utils/mappedfile.h"
+
+#include <QSharedData>
+#include <QExplicitlySharedDataPointer>
+
+class NoteData;
+
+// An immutable copy of a note, taken on the main thread and handed to the job threads.
+// Taking it only copies the fields, which are implicitly shared themselves. Copies of the
+// snapshot share the same data and can be passed between threads freely.
+// Resources are referenced by their cached file, the payload is only mapped when needed.
+class NoteSnapshot
+{
+public:
+    NoteSnapshot();
+    explicit NoteSnapshot(const NoteData &data);
+
+    bool isNull() const;
+    // Snapshots are equal if they were taken at the same time, not if their contents match
+    bool operator==(const NoteSnapshot &other) const { return d == other.d; }
+
+    const NoteRecord &record() const;
+    QString guid() const;
+    QString enmlContent() const;
+
+    QList<ResourceRecord> resources() const;
+    MappedFile resourceData(int index) const;
+
+private:
+    struct Data: public QSharedData
+    {
+        NoteRecord record;
+        QString enmlContent;
+        QStringList resourceFilePaths;
+    };
+    QExplicitlySharedDataPointer<const Data> d;
+};
+
+#endif // NOTESNAPSHOT_H
@@ -26,12 +26,19 @@
 #include "tag.h"
 #include "utils/enmldocument.h"
 #include "utils/organizeradapter.h"
+#include "utils/cachesnapshot.h"
+#include "utils/cachewriter.h"
+#include "utils/operationjournal.h"
+#include "utils/resourcecache.h"
 #include "userstore.h"
 #include "logging.h"
 
 #include "jobs/fetchnotesjob.h"
+#include "jobs/fetchsyncstatejob.h"
+#include "jobs/fetchsyncchunkjob.h"
 #include "jobs/fetchnotebooksjob.h"
 #include "jobs/fetchnotejob.h"
+#include "jobs/fetchresourcejob.h"
 #include "jobs/createnotejob.h"
 #include "jobs/savenotejob.h"
 #include "jobs/savenotebookjob.h"
@@ -50,15 +57,70 @@
 #include <QUuid>
 #include <QPointer>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QCoreApplication>
+#include <QSet>
+#include <QQmlEngine>
 
 NotesStore* NotesStore::s_instance = 0;
 
+// Listing pages requested ahead of the one being processed
+static const int s_notesPagesAhead = 2;
+// Beyond that many separate ranges of rows to remove, the model is reset instead
+static const int s_maxRemovedRowRanges = 64;
+
+static ResourceRecord resourceRecord(const evernote::edam::Resource &resource)
+{
+    ResourceRecord record;
+    record.hash = QByteArray::fromRawData(resource.data.bodyHash.c_str(), resource.data.bodyHash.length()).toHex();
+    record.fileName = QString::fromStdString(resource.attributes.fileName);
+    record.type = QString::fromStdString(resource.mime);
+    record.guid = QString::fromStdString(resource.guid);
+    record.size = resource.data.size;
+    return record;
+}
+
+// Sync chunks carry complete notes (without content). Merging only needs the metadata part.
+static evernote::edam::NoteMetadata noteMetadata(const evernote::edam::Note &note)
+{
+    evernote::edam::NoteMetadata metadata;
+    metadata.guid = note.guid;
+    metadata.title = note.title;
+    metadata.__isset.title = note.__isset.title;
+    metadata.contentLength = note.contentLength;
+    metadata.__isset.contentLength = note.__isset.contentLength;
+    metadata.created = note.created;
+    metadata.__isset.created = note.__isset.created;
+    metadata.updated = note.updated;
+    metadata.__isset.updated = note.__isset.updated;
+    metadata.deleted = note.deleted;
+    metadata.__isset.deleted = note.__isset.deleted;
+    metadata.updateSequenceNum = note.updateSequenceNum;
+    metadata.__isset.updateSequenceNum = note.__isset.updateSequenceNum;
+    metadata.notebookGuid = note.notebookGuid;
+    metadata.__isset.notebookGuid = note.__isset.notebookGuid;
+    // A complete note without tags has no tag list at all
+    metadata.tagGuids = note.tagGuids;
+    metadata.__isset.tagGuids = true;
+    metadata.attributes = note.attributes;
+    metadata.__isset.attributes = note.__isset.attributes;
+    return metadata;
+}
+
 NotesStore::NotesStore(QObject *parent) :
     QAbstractListModel(parent),
     m_username("@invalid "),
     m_loading(false),
     m_notebooksLoading(false),
-    m_tagsLoading(false)
+    m_tagsLoading(false),
+    m_notesListingOffset(0),
+    m_notesListingTotal(0),
+    m_notesListingPending(0),
+    m_notesListingFailed(false),
+    m_notesListingFirstTotal(-1),
+    m_notesListingShifted(false),
+    m_notesPageSizer(25, 50, 250, 2000),
+    m_fullSyncListings(0)
 {
     qCDebug(dcNotesStore) << "Creating NotesStore instance.";
     connect(UserStore::instance(), &UserStore::userChanged, this, &NotesStore::userStoreConnected);
@@ -69,9 +131,31 @@ NotesStore::NotesStore(QObject *parent) :
     qRegisterMetaType<evernote::edam::Notebook>("evernote::edam::Notebook");
     qRegisterMetaType<std::vector<evernote::edam::Tag> >("std::vector<evernote::edam::Tag>");
     qRegisterMetaType<evernote::edam::Tag>("evernote::edam::Tag");
+    qRegisterMetaType<evernote::edam::SyncState>("evernote::edam::SyncState");
+    qRegisterMetaType<evernote::edam::SyncChunk>("evernote::edam::SyncChunk");
 
     m_organizerAdapter = new OrganizerAdapter(this);
 
+    m_cacheWriter = new CacheWriter(this);
+    m_cacheWriter->start(QThread::LowPriority);
+
+    m_journal = new OperationJournal();
+
+    m_noteViewSweepTimer.setInterval(30000);
+    connect(&m_noteViewSweepTimer, &QTimer::timeout, this, &NotesStore::sweepNoteViews);
+    m_resourceCache = new ResourceCache(this);
+    connect(m_resourceCache, &ResourceCache::collected, this, &NotesStore::resourcesCollected);
+    m_resourceCollectTimer.setSingleShot(true);
+    m_resourceCollectTimer.setInterval(60000);
+    connect(&m_resourceCollectTimer, &QTimer::timeout, this, &NotesStore::collectResources);
+
+    m_noteCountChangedTimer.setSingleShot(true);
+    m_noteCountChangedTimer.setInterval(0);
+    connect(&m_noteCountChangedTimer, &QTimer::timeout, this, &NotesStore::emitNoteCountChanges);
+    if (QCoreApplication::instance()) {
+        connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, &NotesStore::flushCache);
+    }
+
     QDir storageDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
     qCDebug(dcNotesStore) << "Notes storare dir" << storageDir;
     if (!storageDir.exists()) {
@@ -115,8 +199,10 @@ void NotesStore::setUsername(const QString &username)
             f.remove();
         }
 
-        m_cacheFile = storageLocation() + "notes.cache";
+        m_cacheFile = storageLocation() + "notes.snapshot";
         qCDebug(dcNotesStore) << "Initialized cacheFile:" << m_cacheFile;
+        m_pushedSequences.clear();
+        m_journal->open(storageLocation() + "journal.log");
         loadFromCacheFile();
     }
 }
@@ -132,9 +218,9 @@ void NotesStore::userStoreConnected()
     qCDebug(dcNotesStore) << "User store connected! Using username:" << username;
     setUsername(username);
 
-    refreshNotebooks();
-    refreshTags();
-    refreshNotes();
+    replayJournal();
+
+    synchronize();
 }
 
 bool NotesStore::loading() const
@@ -162,6 +248,22 @@ int NotesStore::count() const
     return rowCount();
 }
 
+int NotesStore::resourceCacheBudget() const
+{
+    return m_resourceCache->budget() / 1024 / 1024;
+}
+
+void NotesStore::setResourceCacheBudget(int budget)
+{
+    if (resourceCacheBudget() != budget) {
+        m_resourceCache->setBudget((qint64)budget * 1024 * 1024);
+        emit resourceCacheBudgetChanged();
+        if (!m_resourceCollectTimer.isActive()) {
+            m_resourceCollectTimer.start();
+        }
+    }
+}
+
 int NotesStore::rowCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent)
@@ -170,59 +272,63 @@ int NotesStore::rowCount(const QModelIndex &parent) const
 
 QVariant NotesStore::data(const QModelIndex &index, int role) const
 {
+    // Served from the records directly. No need to create a Note for this.
+    const NoteData *note = m_notes.at(index.row()).constData();
     switch (role) {
     case RoleGuid:
-        return m_notes.at(index.row())->guid();
+        return note->guid;
     case RoleNotebookGuid:
-        return m_notes.at(index.row())->notebookGuid();
+        return note->notebookGuid;
     case RoleCreated:
-        return m_notes.at(index.row())->created();
+        return note->created;
     case RoleCreatedString:
-        return m_notes.at(index.row())->createdString();
+        return note->createdString();
     case RoleUpdated:
-        return m_notes.at(index.row())->updated();
+        return note->updated;
     case RoleUpdatedString:
-        return m_notes.at(index.row())->updatedString();
+        return note->updatedString();
     case RoleTitle:
-        return m_notes.at(index.row())->title();
+        return note->title;
     case RoleReminder:
-        return m_notes.at(index.row())->reminder();
+        return note->reminder();
     case RoleReminderTime:
-        return m_notes.at(index.row())->reminderTime();
+        return note->reminderTime;
     case RoleReminderTimeString:
-        return m_notes.at(index.row())->reminderTimeString();
+        return note->reminderTimeString();
     case RoleReminderDone:
-        return m_notes.at(index.row())->reminderDone();
+        return note->reminderDone();
     case RoleReminderDoneTime:
-        return m_notes.at(index.row())->reminderDoneTime();
+        return note->reminderDoneTime;
+    case RoleIsSearchResult:
+        return note->isSearchResult;
     case RoleEnmlContent:
-        return m_notes.at(index.row())->enmlContent();
+        return note->content.enml();
     case RoleHtmlContent:
-        return m_notes.at(index.row())->htmlContent();
+        return note->content.toHtml(note->guid);
     case RoleRichTextContent:
-        return m_notes.at(index.row())->richTextContent();
+        return note->content.toRichText(note->guid);
     case RolePlaintextContent:
-        return m_notes.at(index.row())->plaintextContent();
+        return note->content.toPlaintext();
     case RoleTagline:
-        return m_notes.at(index.row())->tagline();
+        return note->tagline;
     case RoleResourceUrls:
-        return m_notes.at(index.row())->resourceUrls();
+        return note->resourceUrls();
     case RoleReminderSorting:
         // done reminders get +1000000000000 (this will break sorting in year 2286 :P)
-        return QVariant::fromValue(m_notes.at(index.row())->reminderTime().toMSecsSinceEpoch() +
-                (m_notes.at(index.row())->reminderDone() ? 10000000000000 : 0));
+        return QVariant::fromValue(note->reminderTime.toMSecsSinceEpoch() +
+                (note->reminderDone() ? 10000000000000 : 0));
     case RoleTagGuids:
-        return m_notes.at(index.row())->tagGuids();
+        return note->tagGuids;
     case RoleDeleted:
-        return m_notes.at(index.row())->deleted();
+        return note->deleted;
     case RoleSynced:
-        return m_notes.at(index.row())->synced();
+        return note->synced;
     case RoleLoading:
-        return m_notes.at(index.row())->loading();
+        return note->loading;
     case RoleSyncError:
-        return m_notes.at(index.row())->syncError();
+        return note->syncError;
     case RoleConflicting:
-        return m_notes.at(index.row())->conflicting();
+        return note->conflicting;
     }
     return QVariant();
 }
@@ -259,21 +365,196 @@ QHash<int, QByteArray> NotesStore::roleNames() const
 
 NotesStore::~NotesStore()
 {
+    flushCache();
+    delete m_journal;
 }
 
-QList<Note*> NotesStore::notes() const
+Note *NotesStore::note(int index)
 {
-    return m_notes;
+    return exposeNoteView(noteView(m_notes.at(index).data()));
 }
 
-Note *NotesStore::note(int index) const
+Note *NotesStore::note(const QString &guid)
 {
-    return m_notes.at(index);
+    Note *note = noteView(guid);
+    if (!note) {
+        return nullptr;
+    }
+    return exposeNoteView(note);
 }
 
-Note *NotesStore::note(const QString &guid)
+Note *NotesStore::noteView(const QString &guid)
+{
+    NoteData *data = m_notesHash.value(guid).data();
+    if (!data) {
+        return nullptr;
+    }
+    return noteView(data);
+}
+
+const NoteData *NotesStore::noteData(int index) const
+{
+    return m_notes.at(index).constData();
+}
+
+const NoteData *NotesStore::noteData(const QString &guid) const
+{
+    return m_notesHash.value(guid).constData();
+}
+
+Note *NotesStore::noteView(NoteData *data)
+{
+    if (data->view) {
+        m_idleNoteViews.remove(data->view);
+        return data->view;
+    }
+
+    Note *note = new Note(NoteDataPointer(data), this);
+    connect(note, &Note::reminderChanged, this, &NotesStore::emitDataChanged);
+    connect(note, &Note::reminderDoneChanged, this, &NotesStore::emitDataChanged);
+    // Queued, whoever changed it may still be working with the note
+    connect(note, &Note::loadingChanged, this, &NotesStore::noteLoadingChanged, Qt::QueuedConnection);
+    m_noteViews.insert(note);
+    if (!m_noteViewSweepTimer.isActive()) {
+        m_noteViewSweepTimer.start();
+    }
+    return note;
+}
+
+Note *NotesStore::exposeNoteView(Note *note)
+{
+    if (m_scriptNoteViews.contains(note)) {
+        return note;
+    }
+
+    // From now on the QML engine decides how long the note lives. It deletes the object once no
+    // binding or script refers to it any more, we only clean up after it then.
+    m_idleNoteViews.remove(note);
+    m_scriptNoteViews.insert(note, note->m_data);
+    QQmlEngine::setObjectOwnership(note, QQmlEngine::JavaScriptOwnership);
+    connect(note, &QObject::destroyed, this, &NotesStore::noteViewDestroyed);
+    connect(note, &Note::conflictingNoteChanged, this, &NotesStore::updateNoteViewPin);
+    // The engine doesn't delete objects which have a parent
+    note->setParent(note->conflictingNote() ? this : nullptr);
+    return note;
+}
+
+void NotesStore::noteViewDestroyed(QObject *object)
+{
+    // Only the pointer value is used, the object is gone already
+    Note *note = static_cast<Note*>(object);
+    if (!m_scriptNoteViews.contains(note)) {
+        return;
+    }
+    NoteDataPointer data = m_scriptNoteViews.take(note);
+    forgetNoteView(note, data.data());
+    qCDebug(dcNotesStore) << "Note object for" << data->guid << "collected by the QML engine";
+}
+
+void NotesStore::updateNoteViewPin()
+{
+    // The server version of a conflicting note only lives in the Note object. Don't let the QML
+    // engine delete it before the conflict is resolved.
+    Note *note = qobject_cast<Note*>(sender());
+    if (!note || !m_scriptNoteViews.contains(note)) {
+        return;
+    }
+    note->setParent(note->conflictingNote() ? this : nullptr);
+}
+
+void NotesStore::sweepNoteViews()
+{
+    // Release notes C++ code didn't use since the last sweep. Those in use get a new grace period.
+    // Notes handed to QML are left to the QML engine.
+    QSet<Note*> idleNoteViews;
+    foreach (Note *note, m_noteViews) {
+        if (m_scriptNoteViews.contains(note) || note->isBusy()) {
+            continue;
+        }
+        if (m_idleNoteViews.contains(note)) {
+            releaseNoteView(note);
+        } else {
+            idleNoteViews.insert(note);
+        }
+    }
+    m_idleNoteViews = idleNoteViews;
+
+    if (m_noteViews.isEmpty()) {
+        m_noteViewSweepTimer.stop();
+    }
+    qCDebug(dcNotesStore) << "Note objects alive after sweep:" << m_noteViews.count() << "of" << m_notes.count() << "notes";
+}
+
+void NotesStore::collectResources()
+{
+    if (m_cacheFile.isEmpty()) {
+        return;
+    }
+
+    // Originals which can't be fetched from the server again are pinned. That's the case if the note
+    // hasn't been uploaded yet or is a local one. Also keep those of notes currently in use.
+    bool pinAll = m_username == "@local";
+    QHash<QString, bool> references;
+    foreach (const NoteDataPointer &data, m_notes) {
+        bool pinned = pinAll || !data->synced || data->lastSyncedSequenceNumber == 0 || data->view;
+        foreach (const ResourceRecord &resource, data->resources) {
+            references[resource.hash] |= pinned;
+        }
+    }
+    m_resourceCache->collect(storageLocation(), references);
+}
+
+void NotesStore::resourcesCollected(const QStringList &evictedHashes)
+{
+    if (evictedHashes.isEmpty()) {
+        return;
+    }
+
+    QSet<QString> hashes = evictedHashes.toSet();
+    for (int i = 0; i < m_notes.count(); i++) {
+        const NoteDataPointer &data = m_notes.at(i);
+        foreach (const ResourceRecord &resource, data->resources) {
+            if (hashes.contains(resource.hash)) {
+                emit dataChanged(index(i), index(i), QVector<int>() << RoleResourceUrls);
+                break;
+            }
+        }
+    }
+}
+
+void NotesStore::releaseNoteView(Note *note)
+{
+    forgetNoteView(note, note->m_data.data());
+    if (m_scriptNoteViews.remove(note)) {
+        // QML may still be holding it, the engine deletes it once it's done with it
+        note->setParent(nullptr);
+        return;
+    }
+    note->deleteLater();
+}
+
+void NotesStore::forgetNoteView(Note *note, NoteData *data)
+{
+    m_noteViews.remove(note);
+    m_idleNoteViews.remove(note);
+
+    // A deleted note has detached itself from its data already
+    if (data->view && data->view != note) {
+        return;
+    }
+    data->view = nullptr;
+    // Nothing shows the note any more, drop the resource prefetches for it
+    EvernoteConnection::instance()->cancel(data->guid, EvernoteJob::JobPriorityLow);
+    // The content can be reloaded from the cache file when needed again
+    if (data->loaded && !data->contentModified && data->isCached()) {
+        data->content = EnmlDocument();
+        data->loaded = false;
+    }
+}
+
+int NotesStore::indexOf(Note *note) const
 {
-    return m_notesHash.value(guid);
+    return m_notes.indexOf(note->m_data);
 }
 
 QList<Notebook *> NotesStore::notebooks() const
@@ -291,6 +572,11 @@ Notebook *NotesStore::notebook(const QString &guid)
     return m_notebooksHash.value(guid);
 }
 
+QStringList NotesStore::notesInNotebook(const QString &notebookGuid) const
+{
+    return m_notebookNotes.value(notebookGuid);
+}
+
 void NotesStore::createNotebook(const QString &name)
 {
     QString newGuid = QUuid::createUuid().toString();
@@ -307,13 +593,15 @@ void NotesStore::createNotebook(const QString &name)
     emit notebookAdded(notebook->guid());
 
     syncToCacheFile(notebook);
+    m_journal->append(OperationJournal::OperationCreateNotebook, notebook->guid());
 
     if (EvernoteConnection::instance()->isConnected()) {
         qCDebug(dcSync) << "Creating notebook on server:" << notebook->guid();
         notebook->setLoading(true);
         CreateNotebookJob *job = new CreateNotebookJob(notebook);
         connect(job, &CreateNotebookJob::jobDone, this, &NotesStore::createNotebookJobDone);
-        EvernoteConnection::instance()->enqueue(job);
+        EvernoteConnection::instance()->enqueueWrite(job);
+        pushStarted(notebook->guid());
     }
 }
 
@@ -322,6 +610,7 @@ void NotesStore::createNotebookJobDone(EvernoteConnection::ErrorCode errorCode,
     Notebook *notebook = m_notebooksHash.value(tmpGuid);
     if (!notebook) {
         qCWarning(dcSync) << "Cannot find temporary notebook after create finished";
+        pushFinished(tmpGuid, false);
         return;
     }
 
@@ -330,6 +619,7 @@ void NotesStore::createNotebookJobDone(EvernoteConnection::ErrorCode errorCode,
     handleUserError(errorCode);
     if (errorCode != EvernoteConnection::ErrorCodeNoError) {
         qCWarning(dcSync) << "Error creating notebook:" << errorMessage;
+        pushFinished(tmpGuid, false);
         notebook->setSyncError(true);
         emit notebookChanged(notebook->guid());
         return;
@@ -341,22 +631,21 @@ void NotesStore::createNotebookJobDone(EvernoteConnection::ErrorCode errorCode,
 
     m_notebooksHash.insert(guid, notebook);
     notebook->setGuid(QString::fromStdString(result.guid));
+    updateNoteReferences(tmpGuid, guid);
     emit notebookGuidChanged(tmpGuid, notebook->guid());
     m_notebooksHash.remove(tmpGuid);
+    pushRenamed(tmpGuid, guid);
+    pushFinished(guid, true);
 
     notebook->setUpdateSequenceNumber(result.updateSequenceNum);
     notebook->setLastSyncedSequenceNumber(result.updateSequenceNum);
     notebook->setName(QString::fromStdString(result.name));
     emit notebookChanged(notebook->guid());
 
-    QSettings cacheFile(m_cacheFile, QSettings::IniFormat);
-    cacheFile.beginGroup("notebooks");
-    cacheFile.remove(tmpGuid);
-    cacheFile.endGroup();
-
+    m_cacheWriter->removeNotebook(tmpGuid);
     syncToCacheFile(notebook);
 
-    foreach (const QString &noteGuid, notebook->m_notesList) {
+    foreach (const QString &noteGuid, notesInNotebook(notebook->guid())) {
         saveNote(noteGuid);
     }
 }
@@ -371,11 +660,13 @@ void NotesStore::saveNotebook(const QString &guid)
 
     notebook->setUpdateSequenceNumber(notebook->updateSequenceNumber()+1);
     syncToCacheFile(notebook);
+    m_journal->append(OperationJournal::OperationSaveNotebook, notebook->guid());
 
     if (EvernoteConnection::instance()->isConnected()) {
         SaveNotebookJob *job = new SaveNotebookJob(notebook, this);
         connect(job, &SaveNotebookJob::jobDone, this, &NotesStore::saveNotebookJobDone);
-        EvernoteConnection::instance()->enqueue(job);
+        EvernoteConnection::instance()->enqueueWrite(job);
+        pushStarted(notebook->guid());
         notebook->setLoading(true);
     }
     emit notebookChanged(notebook->guid());
@@ -412,13 +703,15 @@ void NotesStore::saveTag(const QString &guid)
 
     tag->setUpdateSequenceNumber(tag->updateSequenceNumber()+1);
     syncToCacheFile(tag);
+    m_journal->append(OperationJournal::OperationSaveTag, tag->guid());
 
     if (EvernoteConnection::instance()->isConnected()) {
         tag->setLoading(true);
         emit tagChanged(tag->guid());
         SaveTagJob *job = new SaveTagJob(tag);
         connect(job, &SaveTagJob::jobDone, this, &NotesStore::saveTagJobDone);
-        EvernoteConnection::instance()->enqueue(job);
+        EvernoteConnection::instance()->enqueueWrite(job);
+        pushStarted(tag->guid());
     }
 }
 
@@ -464,7 +757,7 @@ void NotesStore::expungeNotebook(const QString &guid)
 
         while (notebook->noteCount() > 0) {
             QString noteGuid = notebook->noteAt(0);
-            Note *note = m_notesHash.value(noteGuid);
+            Note *note = noteView(noteGuid);
             if (!note) {
                 qCWarning(dcNotesStore) << "Notebook holds a noteGuid which cannot be found in notes store";
                 Q_ASSERT(false);
@@ -473,6 +766,7 @@ void NotesStore::expungeNotebook(const QString &guid)
             qCDebug(dcNotesStore) << "Moving note" << noteGuid << "to default Notebook";
             note->setNotebookGuid(defaultNotebook);
             saveNote(note->guid());
+            indexNote(note->m_data.data());
             emit noteChanged(note->guid(), defaultNotebook);
             syncToCacheFile(note);
         }
@@ -484,12 +778,9 @@ void NotesStore::expungeNotebook(const QString &guid)
         m_notebooksHash.remove(notebook->guid());
         emit notebookRemoved(notebook->guid());
 
-        QSettings settings(m_cacheFile, QSettings::IniFormat);
-        settings.beginGroup("notebooks");
-        settings.remove(notebook->guid());
-        settings.endGroup();
-
-        notebook->deleteInfoFile();
+        m_cacheWriter->removeNotebook(notebook->guid());
+        // Never made it to the server. Nothing left to push.
+        m_journal->acknowledge(guid, m_journal->lastSequence());
         notebook->deleteLater();
     } else {
         qCDebug(dcNotesStore) << "Setting notebook to deleted:" << notebook->guid();
@@ -497,11 +788,13 @@ void NotesStore::expungeNotebook(const QString &guid)
         notebook->setUpdateSequenceNumber(notebook->updateSequenceNumber()+1);
         emit notebookChanged(notebook->guid());
         syncToCacheFile(notebook);
+        m_journal->append(OperationJournal::OperationExpungeNotebook, guid);
 
         if (EvernoteConnection::instance()->isConnected()) {
             ExpungeNotebookJob *job = new ExpungeNotebookJob(guid, this);
             connect(job, &ExpungeNotebookJob::jobDone, this, &NotesStore::expungeNotebookJobDone);
-            EvernoteConnection::instance()->enqueue(job);
+            EvernoteConnection::instance()->enqueueWrite(job);
+            pushStarted(guid);
         }
     }
 }
@@ -516,6 +809,11 @@ Tag *NotesStore::tag(const QString &guid)
     return m_tagsHash.value(guid);
 }
 
+QStringList NotesStore::notesWithTag(const QString &tagGuid) const
+{
+    return m_tagNotes.value(tagGuid);
+}
+
 Tag* NotesStore::createTag(const QString &name)
 {
     foreach (Tag *tag, m_tags) {
@@ -533,11 +831,13 @@ Tag* NotesStore::createTag(const QString &name)
     emit tagAdded(tag->guid());
 
     syncToCacheFile(tag);
+    m_journal->append(OperationJournal::OperationCreateTag, tag->guid());
 
     if (EvernoteConnection::instance()->isConnected()) {
         CreateTagJob *job = new CreateTagJob(tag);
         connect(job, &CreateTagJob::jobDone, this, &NotesStore::createTagJobDone);
-        EvernoteConnection::instance()->enqueue(job);
+        EvernoteConnection::instance()->enqueueWrite(job);
+        pushStarted(tag->guid());
     }
     return tag;
 }
@@ -547,6 +847,7 @@ void NotesStore::createTagJobDone(EvernoteConnection::ErrorCode errorCode, const
     Tag *tag = m_tagsHash.value(tmpGuid);
     if (!tag) {
         qCWarning(dcSync) << "Create Tag job done but tag can't be found any more";
+        pushFinished(tmpGuid, false);
         return;
     }
 
@@ -555,6 +856,7 @@ void NotesStore::createTagJobDone(EvernoteConnection::ErrorCode errorCode, const
     handleUserError(errorCode);
     if (errorCode != EvernoteConnection::ErrorCodeNoError) {
         qCWarning(dcSync) << "Error creating tag on server:" << errorMessage;
+        pushFinished(tmpGuid, false);
         tag->setSyncError(true);
         emit tagChanged(tag->guid());
         return;
@@ -563,27 +865,28 @@ void NotesStore::createTagJobDone(EvernoteConnection::ErrorCode errorCode, const
     QString guid = QString::fromStdString(result.guid);
     m_tagsHash.insert(guid, tag);
     tag->setGuid(QString::fromStdString(result.guid));
+    updateNoteReferences(tmpGuid, guid);
     emit tagGuidChanged(tmpGuid, guid);
     m_tagsHash.remove(tmpGuid);
+    pushRenamed(tmpGuid, guid);
+    pushFinished(guid, true);
 
     tag->setUpdateSequenceNumber(result.updateSequenceNum);
     tag->setLastSyncedSequenceNumber(result.updateSequenceNum);
     emit tagChanged(tag->guid());
 
-    QSettings cacheFile(m_cacheFile, QSettings::IniFormat);
-    cacheFile.beginGroup("tags");
-    cacheFile.remove(tmpGuid);
-    cacheFile.endGroup();
-
+    m_cacheWriter->removeTag(tmpGuid);
     syncToCacheFile(tag);
 
-    foreach (const QString &noteGuid, tag->m_notesList) {
+    foreach (const QString &noteGuid, notesWithTag(tag->guid())) {
         saveNote(noteGuid);
     }
 }
 
 void NotesStore::saveTagJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const evernote::edam::Tag &result)
 {
+    pushFinished(QString::fromStdString(result.guid), errorCode == EvernoteConnection::ErrorCodeNoError);
+
     Tag *tag = m_tagsHash.value(QString::fromStdString(result.guid));
     if (!tag) {
         qCWarning(dcSync) << "Save tag job finished, but tag can't be found any more";
@@ -608,6 +911,8 @@ void NotesStore::saveTagJobDone(EvernoteConnection::ErrorCode errorCode, const Q
 
 void NotesStore::expungeTagJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const QString &guid)
 {
+    pushFinished(guid, errorCode == EvernoteConnection::ErrorCodeNoError);
+
     handleUserError(errorCode);
     if (errorCode != EvernoteConnection::ErrorCodeNoError) {
         qCWarning(dcSync) << "Error expunging tag:" << errorMessage;
@@ -623,19 +928,13 @@ void NotesStore::expungeTagJobDone(EvernoteConnection::ErrorCode errorCode, cons
     Tag *tag = m_tagsHash.take(guid);
     m_tags.removeAll(tag);
 
-    QSettings cacheFile(m_cacheFile, QSettings::IniFormat);
-    cacheFile.beginGroup("tags");
-    cacheFile.remove(guid);
-    cacheFile.endGroup();
-    tag->syncToInfoFile();
-
-    tag->deleteInfoFile();
+    m_cacheWriter->removeTag(guid);
     tag->deleteLater();
 }
 
 void NotesStore::tagNote(const QString &noteGuid, const QString &tagGuid)
 {
-    Note *note = m_notesHash.value(noteGuid);
+    Note *note = noteView(noteGuid);
     if (!note) {
         qCWarning(dcNotesStore) << "No such note" << noteGuid;
         return;
@@ -653,12 +952,13 @@ void NotesStore::tagNote(const QString &noteGuid, const QString &tagGuid)
     }
 
     note->setTagGuids(note->tagGuids() << tagGuid);
+    m_journal->append(OperationJournal::OperationTagNote, noteGuid, tagGuid);
     saveNote(noteGuid);
 }
 
 void NotesStore::untagNote(const QString &noteGuid, const QString &tagGuid)
 {
-    Note *note = m_notesHash.value(noteGuid);
+    Note *note = noteView(noteGuid);
     if (!note) {
         qCWarning(dcNotesStore) << "No such note" << noteGuid;
         return;
@@ -678,250 +978,659 @@ void NotesStore::untagNote(const QString &noteGuid, const QString &tagGuid)
     QStringList newTagGuids = note->tagGuids();
     newTagGuids.removeAll(tagGuid);
     note->setTagGuids(newTagGuids);
+    m_journal->append(OperationJournal::OperationUntagNote, noteGuid, tagGuid);
     saveNote(noteGuid);
 }
 
-void NotesStore::refreshNotes(const QString &filterNotebookGuid, int startIndex)
+void NotesStore::synchronize()
 {
-    if (m_loading && startIndex == 0) {
-        qCWarning(dcSync) << "Still busy with refreshing...";
+    if (!EvernoteConnection::instance()->isConnected()) {
+        qCWarning(dcSync) << "Not connected. Cannot sync with server.";
+        return;
+    }
+    if (m_loading || m_notebooksLoading || m_tagsLoading) {
+        qCWarning(dcSync) << "Still busy with syncing...";
         return;
     }
 
-    if (EvernoteConnection::instance()->isConnected()) {
-        m_loading = true;
-        emit loadingChanged();
-
-        if (startIndex == 0) {
-            m_unhandledNotes = m_notesHash.keys();
-        }
+    m_loading = true;
+    emit loadingChanged();
+    m_notebooksLoading = true;
+    emit notebooksLoadingChanged();
+    m_tagsLoading = true;
+    emit tagsLoadingChanged();
 
-        FetchNotesJob *job = new FetchNotesJob(filterNotebookGuid, QString(), startIndex);
-        connect(job, &FetchNotesJob::jobDone, this, &NotesStore::fetchNotesJobDone);
-        EvernoteConnection::instance()->enqueue(job);
-    }
+    FetchSyncStateJob *job = new FetchSyncStateJob();
+    connect(job, &FetchSyncStateJob::jobDone, this, &NotesStore::fetchSyncStateJobDone);
+    EvernoteConnection::instance()->enqueue(job);
 }
 
-void NotesStore::fetchNotesJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const evernote::edam::NotesMetadataList &results, const QString &filterNotebookGuid)
+void NotesStore::fetchSyncStateJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const evernote::edam::SyncState &result)
 {
     handleUserError(errorCode);
     if (errorCode != EvernoteConnection::ErrorCodeNoError) {
-        qCWarning(dcSync) << "FetchNotesJobDone: Failed to fetch notes list:" << errorMessage << errorCode;
-        m_loading = false;
-        emit loadingChanged();
+        qCWarning(dcSync) << "FetchSyncStateJobDone: Failed to fetch sync state:" << errorMessage << errorCode;
+        finishSync();
         return;
     }
 
-    for (unsigned int i = 0; i < results.notes.size(); ++i) {
-        evernote::edam::NoteMetadata result = results.notes.at(i);
-        Note *note = m_notesHash.value(QString::fromStdString(result.guid));
-        m_unhandledNotes.removeAll(QString::fromStdString(result.guid));
-        QVector<int> changedRoles;
-        bool newNote = note == 0;
-        if (newNote) {
-            qCDebug(dcSync) << "Found new note on server. Creating local copy:" << QString::fromStdString(result.guid);
-            note = new Note(QString::fromStdString(result.guid), 0, this);
-            connect(note, &Note::reminderChanged, this, &NotesStore::emitDataChanged);
-            connect(note, &Note::reminderDoneChanged, this, &NotesStore::emitDataChanged);
-
-            updateFromEDAM(result, note);
-            beginInsertRows(QModelIndex(), m_notes.count(), m_notes.count());
-            m_notesHash.insert(note->guid(), note);
-            m_notes.append(note);
-            endInsertRows();
-            emit noteAdded(note->guid(), note->notebookGuid());
-            emit countChanged();
-            syncToCacheFile(note);
+    QDateTime serverTime = QDateTime::fromMSecsSinceEpoch(result.currentTime);
+    QDateTime fullSyncBefore = QDateTime::fromMSecsSinceEpoch(result.fullSyncBefore);
+
+    if (m_syncState.updateCount == 0
+            || result.updateCount < m_syncState.updateCount
+            || !m_syncState.lastSyncTime.isValid()
+            || fullSyncBefore > m_syncState.lastSyncTime) {
+        // Never synced, or the server can't give us all changes since our last sync.
+        // List everything and reconcile with what we have.
+        qCDebug(dcSync) << "Starting full sync. Server update count:" << result.updateCount;
+        m_fullSyncTarget.updateCount = result.updateCount;
+        m_fullSyncTarget.lastSyncTime = serverTime;
+        m_fullSyncListings = 3;
+        fetchNotebooks();
+        fetchTags();
+        fetchNotes();
+        return;
+    }
 
-        } else if (note->synced()) {
-            // Local note did not change. Check if we need to refresh from server.
-            if (note->updateSequenceNumber() < result.updateSequenceNum) {
-                qCDebug(dcSync) << "refreshing note from network. suequence number changed: " << note->updateSequenceNumber() << "->" << result.updateSequenceNum;
-                changedRoles = updateFromEDAM(result, note);
-                refreshNoteContent(note->guid(), FetchNoteJob::LoadContent, EvernoteJob::JobPriorityMedium);
-                syncToCacheFile(note);
-            }
-        } else {
-            // Local note changed. See if we can push our changes.
-            if (note->lastSyncedSequenceNumber() == result.updateSequenceNum) {
-                qCDebug(dcSync) << "Local note" << note->guid() << "has changed while server note did not. Pushing changes.";
+    if (result.updateCount == m_syncState.updateCount) {
+        qCDebug(dcSync) << "Nothing changed on the server since the last sync.";
+        m_syncState.lastSyncTime = serverTime;
+        m_cacheWriter->setSyncState(m_syncState);
+        pushLocalChanges();
+        finishSync();
+        return;
+    }
 
-                // Make sure we have everything loaded from cache before saving to server
-                if (!note->loaded() && note->isCached()) {
-                    note->loadFromCacheFile();
-                }
+    qCDebug(dcSync) << "Fetching changes from update count" << m_syncState.updateCount << "to" << result.updateCount;
+    FetchSyncChunkJob *job = new FetchSyncChunkJob(m_syncState.updateCount);
+    connect(job, &FetchSyncChunkJob::jobDone, this, &NotesStore::fetchSyncChunkJobDone);
+    EvernoteConnection::instance()->enqueue(job);
+}
 
-                note->setLoading(true);
-                changedRoles << RoleLoading;
-                SaveNoteJob *job = new SaveNoteJob(note, this);
-                connect(job, &SaveNoteJob::jobDone, this, &NotesStore::saveNoteJobDone);
-                EvernoteConnection::instance()->enqueue(job);
-            } else {
-                qCWarning(dcSync) << "********************************************************";
-                qCWarning(dcSync) << "* CONFLICT: Note has been changed on server and locally!";
-                qCWarning(dcSync) << "* local note sequence:" << note->updateSequenceNumber();
-                qCWarning(dcSync) << "* last synced sequence:" << note->lastSyncedSequenceNumber();
-                qCWarning(dcSync) << "* remote update sequence:" << result.updateSequenceNum;
-                qCWarning(dcSync) << "********************************************************";
-                note->setConflicting(true);
-                changedRoles << RoleConflicting;
-
-                // Not setting parent as we don't want to squash the reply.
-                FetchNoteJob::LoadWhatFlags flags = 0x0;
-                flags |= FetchNoteJob::LoadContent;
-                flags |= FetchNoteJob::LoadResources;
-                FetchNoteJob *fetchNoteJob = new FetchNoteJob(note->guid(), flags);
-                fetchNoteJob->setJobPriority(EvernoteJob::JobPriorityMedium);
-                connect(fetchNoteJob, &FetchNoteJob::resultReady, this, &NotesStore::fetchConflictingNoteJobDone);
-                EvernoteConnection::instance()->enqueue(fetchNoteJob);
+void NotesStore::fetchSyncChunkJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const evernote::edam::SyncChunk &result)
+{
+    handleUserError(errorCode);
+    if (errorCode != EvernoteConnection::ErrorCodeNoError) {
+        qCWarning(dcSync) << "FetchSyncChunkJobDone: Failed to fetch sync chunk:" << errorMessage << errorCode;
+        finishSync();
+        return;
+    }
+
+    qCDebug(dcSync) << "Received sync chunk with" << result.notes.size() << "notes," << result.notebooks.size() << "notebooks,"
+                    << result.tags.size() << "tags and" << result.expungedNotes.size() << "expunged notes.";
+
+    // Notes refer to notebooks and tags. Merge those first.
+    for (unsigned int i = 0; i < result.notebooks.size(); ++i) {
+        mergeRemoteNotebook(result.notebooks.at(i));
+    }
+    for (unsigned int i = 0; i < result.tags.size(); ++i) {
+        mergeRemoteTag(result.tags.at(i));
+    }
+    for (unsigned int i = 0; i < result.notes.size(); ++i) {
+        const evernote::edam::Note &evNote = result.notes.at(i);
+        if (evNote.__isset.active && !evNote.active) {
+            // Moved to the trash on the server. We don't keep those.
+            Note *note = noteView(QString::fromStdString(evNote.guid));
+            if (note && note->loading()) {
+                m_deferredRemoteNotesGone.insert(note->guid());
+            } else if (note) {
+                remoteNoteGone(note);
             }
+            continue;
         }
+        mergeRemoteNote(noteMetadata(evNote), QByteArray(evNote.contentHash.c_str(), evNote.contentHash.length()), false);
+    }
 
-        if (!results.searchedWords.empty()) {
-            note->setIsSearchResult(true);
-            changedRoles << RoleIsSearchResult;
+    for (unsigned int i = 0; i < result.expungedNotes.size(); ++i) {
+        Note *note = noteView(QString::fromStdString(result.expungedNotes.at(i)));
+        if (note && note->loading()) {
+            m_deferredRemoteNotesGone.insert(note->guid());
+        } else if (note) {
+            remoteNoteGone(note);
         }
-
-        if (changedRoles.count() > 0) {
-            QModelIndex noteIndex = index(m_notes.indexOf(note));
-            emit dataChanged(noteIndex, noteIndex, changedRoles);
-            emit noteChanged(note->guid(), note->notebookGuid());
+    }
+    for (unsigned int i = 0; i < result.expungedNotebooks.size(); ++i) {
+        Notebook *notebook = m_notebooksHash.value(QString::fromStdString(result.expungedNotebooks.at(i)));
+        if (notebook && !notebook->loading()) {
+            remoteNotebookGone(notebook);
+        }
+    }
+    for (unsigned int i = 0; i < result.expungedTags.size(); ++i) {
+        Tag *tag = m_tagsHash.value(QString::fromStdString(result.expungedTags.at(i)));
+        if (tag && !tag->loading()) {
+            remoteTagGone(tag);
         }
     }
 
-    if (results.startIndex + (int32_t)results.notes.size() < results.totalNotes) {
-        qCDebug(dcSync) << "Not all notes fetched yet. Fetching next batch.";
-        refreshNotes(filterNotebookGuid, results.startIndex + results.notes.size());
-    } else {
-        qCDebug(dcSync) << "Fetched all notes from Evernote. Starting sync of local-only notes.";
-        m_organizerAdapter->startSync();
-        m_loading = false;
-        emit loadingChanged();
+    // Everything up to chunkHighUSN is merged now. It's missing if the chunk is empty.
+    m_syncState.updateCount = result.__isset.chunkHighUSN ? result.chunkHighUSN : result.updateCount;
+    // The sync time is compared against the server's fullSyncBefore. Only move it forward once all
+    // chunks are merged, an interrupted sync must not look complete.
+    if (m_syncState.updateCount >= result.updateCount) {
+        m_syncState.lastSyncTime = QDateTime::fromMSecsSinceEpoch(result.currentTime);
+    }
+    m_cacheWriter->setSyncState(m_syncState);
 
+    if (m_syncState.updateCount < result.updateCount) {
+        qCDebug(dcSync) << "Not all changes fetched yet. Fetching next chunk.";
+        FetchSyncChunkJob *job = new FetchSyncChunkJob(m_syncState.updateCount);
+        connect(job, &FetchSyncChunkJob::jobDone, this, &NotesStore::fetchSyncChunkJobDone);
+        EvernoteConnection::instance()->enqueue(job);
+    } else {
+        qCDebug(dcSync) << "Fetched all changes from Evernote up to update count" << m_syncState.updateCount << ". Pushing local changes.";
+        pushLocalChanges();
+        finishSync();
+    }
+}
 
-        foreach (const QString &unhandledGuid, m_unhandledNotes) {
-            Note *note = m_notesHash.value(unhandledGuid);
-            if (!note) {
-                continue; // Note might be deleted locally by now
-            }
-            qCDebug(dcSync) << "Have a local note that's not available on server!" << note->guid();
-            if (note->lastSyncedSequenceNumber() == 0) {
-                // This note hasn't been created on the server yet. Do that now.
-                bool hasUnsyncedTag = false;
-                foreach (const QString &tagGuid, note->tagGuids()) {
-                    Tag *tag = m_tagsHash.value(tagGuid);
-                    Q_ASSERT_X(tag, "FetchNotesJob done", "note->tagGuids() contains a non existing tag.");
-                    if (tag && tag->lastSyncedSequenceNumber() == 0) {
-                        hasUnsyncedTag = true;
-                        break;
-                    }
-                }
-                if (hasUnsyncedTag) {
-                    qCDebug(dcSync) << "Not syncing note to server yet. Have a tag that needs sync first";
-                    continue;
-                }
-                Notebook *notebook = m_notebooksHash.value(note->notebookGuid());
-                if (notebook && notebook->lastSyncedSequenceNumber() == 0) {
-                    qCDebug(dcSync) << "Not syncing note to server yet. The notebook needs to be synced first";
-                    continue;
-                }
-                qCDebug(dcSync) << "Creating note on server:" << note->guid();
+void NotesStore::noteLoadingChanged()
+{
+    Note *note = qobject_cast<Note*>(sender());
+    if (!note || note->loading() || !m_deferredRemoteNotesGone.remove(note->guid())) {
+        return;
+    }
+    qCDebug(dcSync) << "Note" << note->guid() << "is done loading. Applying its removal on the server.";
+    remoteNoteGone(note);
+}
 
-                // Make sure we have everything loaded from cache before saving to server
-                if (!note->loaded() && note->isCached()) {
-                    note->loadFromCacheFile();
-                }
+void NotesStore::pushLocalChanges()
+{
+    foreach (Notebook *notebook, m_notebooks) {
+        if (notebook->synced() || notebook->loading()) {
+            continue;
+        }
+        if (notebook->lastSyncedSequenceNumber() == 0) {
+            createRemoteNotebook(notebook);
+        } else {
+            pushNotebook(notebook);
+        }
+    }
 
-                QModelIndex idx = index(m_notes.indexOf(note));
-                note->setLoading(true);
-                emit dataChanged(idx, idx, QVector<int>() << RoleLoading);
-                CreateNoteJob *job = new CreateNoteJob(note, this);
-                connect(job, &CreateNoteJob::jobDone, this, &NotesStore::createNoteJobDone);
-                EvernoteConnection::instance()->enqueue(job);
-            } else {
-                int idx = m_notes.indexOf(note);
-                if (idx == -1) {
-                    qCWarning(dcSync) << "Should sync unhandled note but it is gone by now...";
-                    continue;
-                }
+    foreach (Tag *tag, m_tags) {
+        if (tag->synced() || tag->loading()) {
+            continue;
+        }
+        if (tag->lastSyncedSequenceNumber() == 0) {
+            createRemoteTag(tag);
+        } else {
+            pushTag(tag);
+        }
+    }
 
-                if (note->synced()) {
-                    qCDebug(dcSync) << "Note has been deleted from the server and not changed locally. Deleting local note:" << note->guid();
-                    removeNote(note->guid());
-                } else {
-                    qCDebug(dcSync) << "CONFLICT: Note has been deleted from the server but we have unsynced local changes for note:" << note->guid();
-                    FetchNoteJob::LoadWhatFlags flags = 0x0;
-                    flags |= FetchNoteJob::LoadContent;
-                    flags |= FetchNoteJob::LoadResources;
-                    FetchNoteJob *job = new FetchNoteJob(note->guid(), flags);
-                    connect(job, &FetchNoteJob::resultReady, this, &NotesStore::fetchConflictingNoteJobDone);
-                    EvernoteConnection::instance()->enqueue(job);
-
-                    note->setConflicting(true);
-                    emit dataChanged(index(idx), index(idx), QVector<int>() << RoleConflicting);
-                }
-            }
+    foreach (const NoteDataPointer &data, m_notes) {
+        if (data->synced || data->loading || data->conflicting) {
+            continue;
+        }
+        Note *note = noteView(data.data());
+        if (note->lastSyncedSequenceNumber() == 0) {
+            createRemoteNote(note);
+        } else {
+            qCDebug(dcSync) << "Local note" << note->guid() << "has changed while server note did not. Pushing changes.";
+            pushNote(note);
+            QModelIndex noteIndex = index(indexOf(note));
+            emit dataChanged(noteIndex, noteIndex, QVector<int>() << RoleLoading);
         }
-        qCDebug(dcSync) << "Local-only notes synced.";
     }
 }
 
-void NotesStore::refreshNoteContent(const QString &guid, FetchNoteJob::LoadWhat what, EvernoteJob::JobPriority priority)
+void NotesStore::finishSync()
 {
-    Note *note = m_notesHash.value(guid);
-    if (!note) {
-        qCWarning(dcSync) << "RefreshNoteContent: Can't refresn note content. Note guid not found:" << guid;
-        return;
+    m_organizerAdapter->startSync();
+    if (m_loading) {
+        m_loading = false;
+        emit loadingChanged();
     }
-    if (EvernoteConnection::instance()->isConnected()) {
-        qCDebug(dcNotesStore) << "Fetching note content from network for note" << guid << (what == FetchNoteJob::LoadContent ? "Content" : "Resource") << "Priority:" << priority;
-        FetchNoteJob *job = new FetchNoteJob(guid, what, this);
-        job->setJobPriority(priority);
-        connect(job, &FetchNoteJob::resultReady, this, &NotesStore::fetchNoteJobDone);
-        EvernoteConnection::instance()->enqueue(job);
-
-        if (!note->loading()) {
-            note->setLoading(true);
-            int idx = m_notes.indexOf(note);
-            emit dataChanged(index(idx), index(idx), QVector<int>() << RoleLoading);
-        }
+    if (m_notebooksLoading) {
+        m_notebooksLoading = false;
+        emit notebooksLoadingChanged();
+    }
+    if (m_tagsLoading) {
+        m_tagsLoading = false;
+        emit tagsLoadingChanged();
     }
 }
 
-void NotesStore::fetchNoteJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const evernote::edam::Note &result, FetchNoteJob::LoadWhatFlags what)
+void NotesStore::fullSyncListingDone(bool success)
 {
-    FetchNoteJob *job = static_cast<FetchNoteJob*>(sender());
-    Note *note = m_notesHash.value(QString::fromStdString(result.guid));
-    if (!note) {
-        qCWarning(dcSync) << "can't find note for this update... ignoring...";
+    if (m_fullSyncListings == 0) {
         return;
     }
-    if (note->updateSequenceNumber() > result.updateSequenceNum) {
-        qCWarning(dcSync) << "Local update sequence number higher than remote. Local:" << note->updateSequenceNumber() << "remote:" << result.updateSequenceNum;
+    if (!success) {
+        // Try again with the next sync
+        m_fullSyncListings = 0;
         return;
     }
+    if (--m_fullSyncListings == 0) {
+        m_syncState = m_fullSyncTarget;
+        m_cacheWriter->setSyncState(m_syncState);
+        qCDebug(dcSync) << "Full sync done. Now in sync with update count" << m_syncState.updateCount;
+    }
+}
 
-    QModelIndex noteIndex = index(m_notes.indexOf(note));
-    QVector<int> roles;
-
-    handleUserError(errorCode);
-    if (errorCode != EvernoteConnection::ErrorCodeNoError) {
-        qCWarning(dcSync) << "Fetch note job failed:" << errorMessage;
-        note->setLoading(false);
-        roles << RoleLoading;
-        note->setSyncError(true);
-        roles << RoleSyncError;
-        emit dataChanged(noteIndex, noteIndex, roles);
+void NotesStore::refreshNotes(const QString &filterNotebookGuid, int startIndex)
+{
+    if (filterNotebookGuid.isEmpty() && startIndex == 0) {
+        synchronize();
         return;
     }
 
-    if (result.deleted > 0) {
-        qCDebug(dcSync) << "Note has been deleted on server. Deleting locally.";
-        removeNote(note->guid());
+    if (m_loading && startIndex == 0) {
+        qCWarning(dcSync) << "Still busy with refreshing...";
         return;
     }
 
-    if (note->notebookGuid() != QString::fromStdString(result.notebookGuid)) {
+    if (EvernoteConnection::instance()->isConnected()) {
+        fetchNotes(filterNotebookGuid, startIndex);
+    }
+}
+
+void NotesStore::fetchNotes(const QString &filterNotebookGuid, int startIndex)
+{
+    m_loading = true;
+    emit loadingChanged();
+
+    if (startIndex == 0) {
+        // Everything we have in the scope of this listing, whatever the server doesn't list is gone there
+        m_unhandledNotes.clear();
+        if (filterNotebookGuid.isEmpty()) {
+            m_unhandledNotes.reserve(m_notesHash.count());
+            for (QHash<QString, NoteDataPointer>::const_iterator it = m_notesHash.constBegin(); it != m_notesHash.constEnd(); ++it) {
+                m_unhandledNotes.insert(it.key());
+            }
+        } else {
+            m_unhandledNotes = m_notebookNotes.value(filterNotebookGuid).toSet();
+        }
+    }
+
+    // Only the first page now, the others once we know how many notes there are
+    m_notesListingOffset = startIndex;
+    m_notesListingTotal = startIndex + 1;
+    m_notesListingFailed = false;
+    m_notesListingFirstTotal = -1;
+    m_notesListingShifted = false;
+    fetchNotesPages(filterNotebookGuid);
+}
+
+void NotesStore::fetchNotesPages(const QString &filterNotebookGuid)
+{
+    while (m_notesListingPending < s_notesPagesAhead && m_notesListingOffset < m_notesListingTotal) {
+        int chunkSize = m_notesPageSizer.pageSize();
+        fetchNotesPage(filterNotebookGuid, m_notesListingOffset, chunkSize);
+        m_notesListingOffset += chunkSize;
+    }
+}
+
+void NotesStore::fetchNotesPage(const QString &filterNotebookGuid, int startIndex, int chunkSize)
+{
+    qCDebug(dcSync) << "Fetching notes" << startIndex << "to" << startIndex + chunkSize;
+    FetchNotesJob *job = new FetchNotesJob(filterNotebookGuid, QString(), startIndex, chunkSize);
+    connect(job, &FetchNotesJob::jobDone, this, &NotesStore::fetchNotesJobDone);
+    EvernoteConnection::instance()->enqueue(job);
+    m_notesListingPending++;
+}
+
+void NotesStore::fetchNotesJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const evernote::edam::NotesMetadataList &results, const QString &filterNotebookGuid)
+{
+    FetchNotesJob *job = static_cast<FetchNotesJob*>(sender());
+    m_notesListingPending--;
+
+    handleUserError(errorCode);
+    if (errorCode != EvernoteConnection::ErrorCodeNoError && !m_notesListingFailed) {
+        qCWarning(dcSync) << "FetchNotesJobDone: Failed to fetch notes list:" << errorMessage << errorCode;
+        m_notesListingFailed = true;
+        fullSyncListingDone(false);
+    }
+    if (m_notesListingFailed) {
+        // Pages still on their way are dropped. Not loading any more once the last one is in.
+        if (m_notesListingPending == 0) {
+            m_loading = false;
+            emit loadingChanged();
+        }
+        return;
+    }
+
+    m_notesPageSizer.addSample(results.notes.size(), job->elapsed());
+    m_notesListingTotal = results.totalNotes;
+    if (m_notesListingFirstTotal < 0) {
+        m_notesListingFirstTotal = results.totalNotes;
+    } else if (results.totalNotes != m_notesListingFirstTotal && !m_notesListingShifted) {
+        qCDebug(dcSync) << "Notes changed on the server while listing:" << m_notesListingFirstTotal << "->" << results.totalNotes;
+        m_notesListingShifted = true;
+    }
+
+    int received = results.startIndex + results.notes.size();
+    int requested = qMin(results.startIndex + job->chunkSize(), results.totalNotes);
+    if (received < requested) {
+        if (results.notes.size() > 0) {
+            // Not guaranteed to get as many as we asked for. Ask again for the rest.
+            fetchNotesPage(filterNotebookGuid, received, requested - received);
+        } else {
+            // Nothing at all, notes must have gone in the meantime. That's the end of the
+            // listing, asking again would just get the same empty page.
+            qCDebug(dcSync) << "Empty page at" << results.startIndex << "of" << results.totalNotes << "notes. Ending the listing.";
+            m_notesListingTotal = qMin(m_notesListingTotal, results.startIndex);
+            m_notesListingShifted = true;
+        }
+    }
+
+    // Get the next pages on their way before processing this one
+    fetchNotesPages(filterNotebookGuid);
+
+    for (unsigned int i = 0; i < results.notes.size(); ++i) {
+        const evernote::edam::NoteMetadata &result = results.notes.at(i);
+        m_unhandledNotes.remove(QString::fromStdString(result.guid));
+        // Note listings don't come with the content hash
+        mergeRemoteNote(result, QByteArray(), false);
+    }
+
+    if (m_notesListingPending > 0) {
+        qCDebug(dcSync) << "Not all notes fetched yet." << m_notesListingPending << "pages pending.";
+    } else {
+        qCDebug(dcSync) << "Fetched all notes from Evernote. Starting sync of local-only notes.";
+        m_organizerAdapter->startSync();
+        m_loading = false;
+        emit loadingChanged();
+
+        reconcileUnhandledNotes();
+        qCDebug(dcSync) << "Local-only notes synced.";
+
+        if (filterNotebookGuid.isEmpty()) {
+            // Notes removed on the server may not have been noticed. Stay with the full sync.
+            fullSyncListingDone(!m_notesListingShifted);
+        }
+    }
+}
+
+void NotesStore::reconcileUnhandledNotes()
+{
+    // Synced notes the server doesn't have any more are removed in one go
+    QSet<NoteData*> gone;
+    foreach (const QString &unhandledGuid, m_unhandledNotes) {
+        NoteData *data = m_notesHash.value(unhandledGuid).data();
+        if (!data) {
+            continue; // Note might be deleted locally by now
+        }
+        qCDebug(dcSync) << "Have a local note that's not available on server!" << data->guid;
+        if (data->loading) {
+            qCDebug(dcSync) << "Note is busy. Not pushing it again.";
+            continue;
+        }
+        if (data->lastSyncedSequenceNumber == 0) {
+            // This note hasn't been created on the server yet. Do that now.
+            createRemoteNote(noteView(data));
+        } else if (m_notesListingShifted) {
+            // It may just have moved to a page which was fetched already
+            qCDebug(dcSync) << "Listing changed while paging. Keeping note:" << data->guid;
+        } else if (data->synced) {
+            qCDebug(dcSync) << "Note has been deleted from the server and not changed locally. Deleting local note:" << data->guid;
+            gone.insert(data);
+        } else {
+            remoteNoteGone(noteView(data));
+        }
+    }
+    m_unhandledNotes.clear();
+
+    removeNotes(gone);
+}
+
+void NotesStore::findNotesJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const evernote::edam::NotesMetadataList &results)
+{
+    handleUserError(errorCode);
+    if (errorCode != EvernoteConnection::ErrorCodeNoError) {
+        qCWarning(dcSync) << "Failed to search notes:" << errorMessage << errorCode;
+        return;
+    }
+
+    for (unsigned int i = 0; i < results.notes.size(); ++i) {
+        mergeRemoteNote(results.notes.at(i), QByteArray(), true);
+    }
+}
+
+void NotesStore::mergeRemoteNote(const evernote::edam::NoteMetadata &result, const QByteArray &contentHash, bool searchResult)
+{
+    NoteData *data = m_notesHash.value(QString::fromStdString(result.guid)).data();
+    QVector<int> changedRoles;
+    bool newNote = data == 0;
+    if (!newNote && data->synced && data->updateSequenceNumber >= result.updateSequenceNum && !searchResult) {
+        // Nothing to do for this one. Don't bother creating a Note for it.
+        return;
+    }
+    Note *note = 0;
+    if (newNote) {
+        qCDebug(dcSync) << "Found new note on server. Creating local copy:" << QString::fromStdString(result.guid);
+        data = new NoteData();
+        data->guid = QString::fromStdString(result.guid);
+        beginInsertRows(QModelIndex(), m_notes.count(), m_notes.count());
+        m_notesHash.insert(data->guid, NoteDataPointer(data));
+        m_notes.append(NoteDataPointer(data));
+        note = noteView(data);
+        updateFromEDAM(result, note);
+        endInsertRows();
+        indexNote(data);
+        emit noteAdded(note->guid(), note->notebookGuid());
+        emit countChanged();
+        syncToCacheFile(note);
+
+    } else if (data->synced) {
+        note = noteView(data);
+        // Local note did not change. Check if we need to refresh from server.
+        if (note->updateSequenceNumber() < result.updateSequenceNum) {
+            qCDebug(dcSync) << "refreshing note from network. suequence number changed: " << note->updateSequenceNumber() << "->" << result.updateSequenceNum;
+            // Tags, reminders, the title or the echo of our own save. The content we have is still good.
+            bool contentUnchanged = !contentHash.isEmpty() && contentHash == note->contentHash() && note->isCached();
+            changedRoles = updateFromEDAM(result, note);
+            if (contentUnchanged) {
+                qCDebug(dcSync) << "Content of note" << note->guid() << "unchanged, only updating metadata.";
+            } else {
+                refreshNoteContent(note->guid(), FetchNoteJob::LoadContent, EvernoteJob::JobPriorityMedium);
+            }
+            syncToCacheFile(note);
+        }
+    } else if (data->loading) {
+        // Local changes are being pushed already (e.g. replayed from the journal)
+        qCDebug(dcSync) << "Local note" << data->guid << "is busy. Not pushing it again.";
+    } else {
+        note = noteView(data);
+        // Local note changed. See if we can push our changes.
+        if (note->lastSyncedSequenceNumber() == result.updateSequenceNum) {
+            qCDebug(dcSync) << "Local note" << note->guid() << "has changed while server note did not. Pushing changes.";
+            pushNote(note);
+            changedRoles << RoleLoading;
+        } else {
+            qCWarning(dcSync) << "********************************************************";
+            qCWarning(dcSync) << "* CONFLICT: Note has been changed on server and locally!";
+            qCWarning(dcSync) << "* local note sequence:" << note->updateSequenceNumber();
+            qCWarning(dcSync) << "* last synced sequence:" << note->lastSyncedSequenceNumber();
+            qCWarning(dcSync) << "* remote update sequence:" << result.updateSequenceNum;
+            qCWarning(dcSync) << "********************************************************";
+            note->setConflicting(true);
+            changedRoles << RoleConflicting;
+
+            // Not setting parent as we don't want to squash the reply.
+            FetchNoteJob::LoadWhatFlags flags = 0x0;
+            flags |= FetchNoteJob::LoadContent;
+            flags |= FetchNoteJob::LoadResources;
+            FetchNoteJob *fetchNoteJob = new FetchNoteJob(note->guid(), flags);
+            fetchNoteJob->setJobPriority(EvernoteJob::JobPriorityMedium);
+            connect(fetchNoteJob, &FetchNoteJob::resultReady, this, &NotesStore::fetchConflictingNoteJobDone);
+            EvernoteConnection::instance()->enqueue(fetchNoteJob);
+        }
+    }
+
+    if (searchResult) {
+        note = noteView(data);
+        note->setIsSearchResult(true);
+        changedRoles << RoleIsSearchResult;
+    }
+
+    if (changedRoles.count() > 0) {
+        QModelIndex noteIndex = index(indexOf(note));
+        emit dataChanged(noteIndex, noteIndex, changedRoles);
+        indexNote(note->m_data.data());
+        emit noteChanged(note->guid(), note->notebookGuid());
+    }
+}
+
+void NotesStore::pushNote(Note *note)
+{
+    // Make sure we have everything loaded from cache before saving to server
+    if (!note->loaded() && note->isCached()) {
+        note->loadFromCacheFile();
+    }
+
+    note->setLoading(true);
+    SaveNoteJob *job = new SaveNoteJob(note, this);
+    connect(job, &SaveNoteJob::jobDone, this, &NotesStore::saveNoteJobDone);
+    EvernoteConnection::instance()->enqueueWrite(job);
+    pushStarted(note->guid());
+}
+
+void NotesStore::createRemoteNote(Note *note)
+{
+    bool hasUnsyncedTag = false;
+    foreach (const QString &tagGuid, note->tagGuids()) {
+        Tag *tag = m_tagsHash.value(tagGuid);
+        Q_ASSERT_X(tag, "createRemoteNote", "note->tagGuids() contains a non existing tag.");
+        if (tag && tag->lastSyncedSequenceNumber() == 0) {
+            hasUnsyncedTag = true;
+            break;
+        }
+    }
+    if (hasUnsyncedTag) {
+        qCDebug(dcSync) << "Not syncing note to server yet. Have a tag that needs sync first";
+        return;
+    }
+    Notebook *notebook = m_notebooksHash.value(note->notebookGuid());
+    if (notebook && notebook->lastSyncedSequenceNumber() == 0) {
+        qCDebug(dcSync) << "Not syncing note to server yet. The notebook needs to be synced first";
+        return;
+    }
+    qCDebug(dcSync) << "Creating note on server:" << note->guid();
+
+    // Make sure we have everything loaded from cache before saving to server
+    if (!note->loaded() && note->isCached()) {
+        note->loadFromCacheFile();
+    }
+
+    QModelIndex idx = index(indexOf(note));
+    note->setLoading(true);
+    emit dataChanged(idx, idx, QVector<int>() << RoleLoading);
+    CreateNoteJob *job = new CreateNoteJob(note, this);
+    connect(job, &CreateNoteJob::jobDone, this, &NotesStore::createNoteJobDone);
+    EvernoteConnection::instance()->enqueueWrite(job);
+    pushStarted(note->guid());
+}
+
+void NotesStore::remoteNoteGone(Note *note)
+{
+    int idx = indexOf(note);
+    if (idx == -1) {
+        qCWarning(dcSync) << "Should sync unhandled note but it is gone by now...";
+        return;
+    }
+
+    if (note->synced()) {
+        qCDebug(dcSync) << "Note has been deleted from the server and not changed locally. Deleting local note:" << note->guid();
+        removeNote(note->guid());
+    } else {
+        qCDebug(dcSync) << "CONFLICT: Note has been deleted from the server but we have unsynced local changes for note:" << note->guid();
+        FetchNoteJob::LoadWhatFlags flags = 0x0;
+        flags |= FetchNoteJob::LoadContent;
+        flags |= FetchNoteJob::LoadResources;
+        FetchNoteJob *job = new FetchNoteJob(note->guid(), flags);
+        connect(job, &FetchNoteJob::resultReady, this, &NotesStore::fetchConflictingNoteJobDone);
+        EvernoteConnection::instance()->enqueue(job);
+
+        note->setConflicting(true);
+        emit dataChanged(index(idx), index(idx), QVector<int>() << RoleConflicting);
+    }
+}
+
+void NotesStore::refreshNoteContent(const QString &guid, FetchNoteJob::LoadWhat what, EvernoteJob::JobPriority priority)
+{
+    Note *note = noteView(guid);
+    if (!note) {
+        qCWarning(dcSync) << "RefreshNoteContent: Can't refresn note content. Note guid not found:" << guid;
+        return;
+    }
+    if (EvernoteConnection::instance()->isConnected()) {
+        qCDebug(dcNotesStore) << "Fetching note content from network for note" << guid << (what == FetchNoteJob::LoadContent ? "Content" : "Resource") << "Priority:" << priority;
+
+        // Only the resources which aren't cached. Without knowing their guids, we have to ask for the note first.
+        bool resourceGuidsKnown = false;
+        QList<ResourceRecord> missingResources;
+        if (what == FetchNoteJob::LoadResources) {
+            missingResources = note->missingResources();
+            if (missingResources.isEmpty()) {
+                return;
+            }
+            resourceGuidsKnown = true;
+            foreach (const ResourceRecord &resource, missingResources) {
+                resourceGuidsKnown &= !resource.guid.isEmpty();
+            }
+        }
+
+        if (resourceGuidsKnown) {
+            fetchResources(note, missingResources, priority);
+        } else {
+            FetchNoteJob *job = new FetchNoteJob(guid, what, this);
+            job->setJobPriority(priority);
+            connect(job, &FetchNoteJob::resultReady, this, &NotesStore::fetchNoteJobDone);
+            EvernoteConnection::instance()->enqueue(job);
+        }
+
+        if (!note->loading()) {
+            note->setLoading(true);
+            int idx = indexOf(note);
+            emit dataChanged(index(idx), index(idx), QVector<int>() << RoleLoading);
+        }
+    }
+}
+
+void NotesStore::fetchNoteJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const evernote::edam::Note &result, FetchNoteJob::LoadWhatFlags what)
+{
+    FetchNoteJob *job = static_cast<FetchNoteJob*>(sender());
+    Note *note = noteView(QString::fromStdString(result.guid));
+    if (!note) {
+        qCWarning(dcSync) << "can't find note for this update... ignoring...";
+        return;
+    }
+    if (errorCode == EvernoteConnection::ErrorCodeCancelled) {
+        // Nobody is waiting for it any more. It's fetched again when needed.
+        if (note->loading()) {
+            note->setLoading(false);
+            int idx = indexOf(note);
+            emit dataChanged(index(idx), index(idx), QVector<int>() << RoleLoading);
+        }
+        return;
+    }
+    if (note->updateSequenceNumber() > result.updateSequenceNum) {
+        qCWarning(dcSync) << "Local update sequence number higher than remote. Local:" << note->updateSequenceNumber() << "remote:" << result.updateSequenceNum;
+        return;
+    }
+
+    QModelIndex noteIndex = index(indexOf(note));
+    QVector<int> roles;
+
+    handleUserError(errorCode);
+    if (errorCode != EvernoteConnection::ErrorCodeNoError) {
+        qCWarning(dcSync) << "Fetch note job failed:" << errorMessage;
+        note->setLoading(false);
+        roles << RoleLoading;
+        note->setSyncError(true);
+        roles << RoleSyncError;
+        emit dataChanged(noteIndex, noteIndex, roles);
+        return;
+    }
+
+    if (result.deleted > 0) {
+        qCDebug(dcSync) << "Note has been deleted on server. Deleting locally.";
+        removeNote(note->guid());
+        return;
+    }
+
+    if (note->notebookGuid() != QString::fromStdString(result.notebookGuid)) {
         note->setNotebookGuid(QString::fromStdString(result.notebookGuid));
         roles << RoleGuid;
     }
@@ -936,8 +1645,9 @@ void NotesStore::fetchNoteJobDone(EvernoteConnection::ErrorCode errorCode, const
     QStringList tagGuids;
     for (quint32 i = 0; i < result.tagGuids.size(); i++) {
         QString tag = QString::fromStdString(result.tagGuids.at(i));
-        if (m_tagsHash.contains(tag)) {
-            refreshTags();
+        if (!m_tagsHash.contains(tag)) {
+            // Tag is newer than our last sync
+            synchronize();
         }
         tagGuids << tag;
     }
@@ -946,38 +1656,29 @@ void NotesStore::fetchNoteJobDone(EvernoteConnection::ErrorCode errorCode, const
         roles << RoleTagGuids;
     }
 
-    // Notes are fetched without resources by default. if we discover one or more resources where we don't have
-    // data in the cache, let's refresh the note again with resource data.
-    bool refreshWithResourceData = false;
+    // Notes are fetched without resource data. If we discover one or more resources where we don't have
+    // data in the cache, those get downloaded one by one.
+    QList<ResourceRecord> missingResources;
 
     qCDebug(dcSync) << "got note content" << note->guid() << (what == FetchNoteJob::LoadContent ? "content" : "image") << result.resources.size();
     // Resources need to be set before the content because otherwise the image provider won't find them when the content is updated in the ui
     for (unsigned int i = 0; i < result.resources.size(); ++i) {
 
-        evernote::edam::Resource resource = result.resources.at(i);
+        ResourceRecord record = resourceRecord(result.resources.at(i));
 
-        QString hash = QByteArray::fromRawData(resource.data.bodyHash.c_str(), resource.data.bodyHash.length()).toHex();
-        QString fileName = QString::fromStdString(resource.attributes.fileName);
-        QString mime = QString::fromStdString(resource.mime);
+        qCDebug(dcSync) << "Adding resource info to note:" << note->guid() << "Filename:" << record.fileName << "Mimetype:" << record.type << "Hash:" << record.hash;
+        Resource *resource = note->addResource(record);
 
-        if (what == FetchNoteJob::LoadResources) {
-            qCDebug(dcSync) << "Resource content fetched for note:" << note->guid() << "Filename:" << fileName << "Mimetype:" << mime << "Hash:" << hash;
-            QByteArray resourceData = QByteArray(resource.data.body.data(), resource.data.size);
-            note->addResource(hash, fileName, mime, resourceData);
-        } else {
-            qCDebug(dcSync) << "Adding resource info to note:" << note->guid() << "Filename:" << fileName << "Mimetype:" << mime << "Hash:" << hash;
-            Resource *resource = note->addResource(hash, fileName, mime);
-
-            if (!resource->isCached()) {
-                qCDebug(dcSync) << "Resource not yet fetched for note:" << note->guid() << "Filename:" << fileName << "Mimetype:" << mime << "Hash:" << hash;
-                refreshWithResourceData = true;
-            }
+        if (!resource->isCached()) {
+            qCDebug(dcSync) << "Resource not yet fetched for note:" << note->guid() << "Filename:" << record.fileName << "Mimetype:" << record.type << "Hash:" << record.hash;
+            missingResources.append(record);
         }
         roles << RoleHtmlContent << RoleEnmlContent << RoleResourceUrls;
     }
 
     if (what == FetchNoteJob::LoadContent) {
         note->setEnmlContent(QString::fromStdString(result.content));
+        note->setContentHash(QByteArray(result.contentHash.c_str(), result.contentHash.length()), result.contentLength);
         note->setUpdateSequenceNumber(result.updateSequenceNum);
         note->setLastSyncedSequenceNumber(result.updateSequenceNum);
         roles << RoleHtmlContent << RoleEnmlContent << RoleTagline << RolePlaintextContent;
@@ -1010,26 +1711,115 @@ void NotesStore::fetchNoteJobDone(EvernoteConnection::ErrorCode errorCode, const
         m_organizerAdapter->startSync();
     }
 
-    note->setLoading(false);
+    if (!missingResources.isEmpty()) {
+        qCDebug(dcSync) << "Fetching Note resources:" << note->guid() << missingResources.count();
+        EvernoteJob::JobPriority newPriority = job->jobPriority() == EvernoteJob::JobPriorityMedium ? EvernoteJob::JobPriorityLow : job->jobPriority();
+        fetchResources(note, missingResources, newPriority);
+    }
+
+    // Still loading while resources are on their way
+    note->setLoading(m_resourceFetches.contains(note->guid()));
     roles << RoleLoading;
 
+    indexNote(note->m_data.data());
     emit noteChanged(note->guid(), note->notebookGuid());
     emit dataChanged(noteIndex, noteIndex, roles);
 
-    if (refreshWithResourceData) {
-        qCDebug(dcSync) << "Fetching Note resources:" << note->guid();
-        EvernoteJob::JobPriority newPriority = job->jobPriority() == EvernoteJob::JobPriorityMedium ? EvernoteJob::JobPriorityLow : job->jobPriority();
-        refreshNoteContent(note->guid(), FetchNoteJob::LoadResources, newPriority);
-    }
     syncToCacheFile(note); // Syncs into the list cache
     note->syncToCacheFile(); // Syncs note's content into notes cache
 }
 
+void NotesStore::fetchResources(Note *note, const QList<ResourceRecord> &resources, EvernoteJob::JobPriority priority)
+{
+    foreach (const ResourceRecord &resource, resources) {
+        // Equal data is stored in the same file, the job queue merges downloads for several notes
+        FetchResourceJob *job = new FetchResourceJob(note->guid(), resource.guid, resource.hash, resource.size,
+                                                     Resource::cachePath(resource.hash, resource.fileName), this);
+        job->setJobPriority(priority);
+        connect(job, &FetchResourceJob::jobDone, this, &NotesStore::fetchResourceJobDone);
+        connect(job, &FetchResourceJob::progress, this, &NotesStore::resourceFetchProgress);
+        EvernoteConnection::instance()->enqueue(job);
+        m_resourceFetches[note->guid()].insert(resource.hash);
+    }
+}
+
+void NotesStore::fetchResourceJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const QString &noteGuid, const QString &hash)
+{
+    handleUserError(errorCode);
+    if (errorCode != EvernoteConnection::ErrorCodeNoError && errorCode != EvernoteConnection::ErrorCodeCancelled) {
+        qCWarning(dcSync) << "Fetch resource job failed:" << errorMessage;
+    } else if (errorCode == EvernoteConnection::ErrorCodeNoError) {
+        qCDebug(dcSync) << "Resource content fetched for note:" << noteGuid << "Hash:" << hash;
+        if (!m_resourceCollectTimer.isActive()) {
+            m_resourceCollectTimer.start();
+        }
+    }
+
+    // Any note waiting for that data has it now, or has to load it again
+    QStringList noteGuids;
+    for (QHash<QString, QSet<QString> >::iterator it = m_resourceFetches.begin(); it != m_resourceFetches.end(); ) {
+        if (it->remove(hash)) {
+            noteGuids.append(it.key());
+        }
+        if (it->isEmpty()) {
+            it = m_resourceFetches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    foreach (const QString &guid, noteGuids) {
+        NoteData *data = m_notesHash.value(guid).data();
+        if (!data) {
+            continue;
+        }
+
+        if (errorCode == EvernoteConnection::ErrorCodeCancelled && data->view) {
+            // The download was shared with a note which has been released. This one is still shown.
+            foreach (const ResourceRecord &resource, data->resources) {
+                if (resource.hash == hash) {
+                    fetchResources(data->view, QList<ResourceRecord>() << resource, EvernoteJob::JobPriorityLow);
+                    break;
+                }
+            }
+            if (m_resourceFetches.value(guid).contains(hash)) {
+                continue;
+            }
+        }
+
+        Note *note = noteView(data);
+        QModelIndex noteIndex = index(indexOf(note));
+        QVector<int> roles;
+        bool loading = m_resourceFetches.contains(guid);
+        if (note->loading() != loading) {
+            note->setLoading(loading);
+            roles << RoleLoading;
+        }
+
+        if (errorCode == EvernoteConnection::ErrorCodeCancelled) {
+            // Fetched again when the note is loaded next time
+        } else if (errorCode != EvernoteConnection::ErrorCodeNoError) {
+            note->setSyncError(true);
+            roles << RoleSyncError;
+        } else if (note->resource(hash)) {
+            // Known already, this only makes the note pick up the data
+            ResourceRecord record;
+            record.hash = hash;
+            note->addResource(record);
+            roles << RoleHtmlContent << RoleEnmlContent << RoleResourceUrls;
+        }
+
+        if (!roles.isEmpty()) {
+            emit dataChanged(noteIndex, noteIndex, roles);
+        }
+    }
+}
+
 void NotesStore::fetchConflictingNoteJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const evernote::edam::Note &result, FetchNoteJob::LoadWhatFlags what)
 {
     Q_UNUSED(what) // We always fetch everything when sensing a conflict
 
-    Note *note = m_notesHash.value(QString::fromStdString(result.guid));
+    Note *note = noteView(QString::fromStdString(result.guid));
     if (!note) {
         qCWarning(dcSync) << "Fetched conflicting note from server but local note can't be found any more:" << QString::fromStdString(result.guid);
         return;
@@ -1066,7 +1856,7 @@ void NotesStore::fetchConflictingNoteJobDone(EvernoteConnection::ErrorCode error
     serverNote->setEnmlContent(QString::fromStdString(result.content));
 
     foreach (const evernote::edam::Resource &resource, result.resources) {
-        serverNote->addResource(QString::fromStdString(resource.data.bodyHash), QString::fromStdString(resource.attributes.fileName), QString::fromStdString(resource.mime));
+        serverNote->addResource(resourceRecord(resource));
     }
 
     note->setConflictingNote(serverNote);
@@ -1076,11 +1866,11 @@ void NotesStore::fetchConflictingNoteJobDone(EvernoteConnection::ErrorCode error
 
 void NotesStore::refreshNotebooks()
 {
-    if (!EvernoteConnection::instance()->isConnected()) {
-        qCWarning(dcSync) << "Not connected. Cannot fetch notebooks from server.";
-        return;
-    }
+    synchronize();
+}
 
+void NotesStore::fetchNotebooks()
+{
     m_notebooksLoading = true;
     emit notebooksLoadingChanged();
     FetchNotebooksJob *job = new FetchNotebooksJob();
@@ -1096,6 +1886,7 @@ void NotesStore::fetchNotebooksJobDone(EvernoteConnection::ErrorCode errorCode,
     handleUserError(errorCode);
     if (errorCode != EvernoteConnection::ErrorCodeNoError) {
         qCWarning(dcSync) << "FetchNotebooksJobDone: Failed to fetch notes list:" << errorMessage << errorCode;
+        fullSyncListingDone(false);
         return;
     }
 
@@ -1103,83 +1894,108 @@ void NotesStore::fetchNotebooksJobDone(EvernoteConnection::ErrorCode errorCode,
 
     qCDebug(dcSync) << "Received" << results.size() << "notebooks from Evernote.";
     for (unsigned int i = 0; i < results.size(); ++i) {
-        evernote::edam::Notebook result = results.at(i);
-        Notebook *notebook = m_notebooksHash.value(QString::fromStdString(result.guid));
-        unhandledNotebooks.removeAll(notebook);
-        bool newNotebook = notebook == 0;
-        if (newNotebook) {
-            qCDebug(dcSync) << "Found new notebook on Evernote:" << QString::fromStdString(result.guid);
-            notebook = new Notebook(QString::fromStdString(result.guid), 0, this);
+        const evernote::edam::Notebook &result = results.at(i);
+        unhandledNotebooks.removeAll(m_notebooksHash.value(QString::fromStdString(result.guid)));
+        mergeRemoteNotebook(result);
+    }
+
+    qCDebug(dcSync) << "Remote notebooks merged into storage. Merging local changes to server.";
+
+    foreach (Notebook *notebook, unhandledNotebooks) {
+        if (notebook->loading()) {
+            qCDebug(dcSync) << "Local notebook" << notebook->guid() << "is busy. Not pushing it again.";
+            continue;
+        }
+        if (notebook->lastSyncedSequenceNumber() == 0) {
+            createRemoteNotebook(notebook);
+        } else {
+            remoteNotebookGone(notebook);
+        }
+    }
+
+    qCDebug(dcSync) << "Notebooks merged.";
+    fullSyncListingDone(true);
+}
+
+void NotesStore::mergeRemoteNotebook(const evernote::edam::Notebook &result)
+{
+    Notebook *notebook = m_notebooksHash.value(QString::fromStdString(result.guid));
+    bool newNotebook = notebook == 0;
+    if (newNotebook) {
+        qCDebug(dcSync) << "Found new notebook on Evernote:" << QString::fromStdString(result.guid);
+        notebook = new Notebook(QString::fromStdString(result.guid), 0, this);
+        updateFromEDAM(result, notebook);
+        m_notebooksHash.insert(notebook->guid(), notebook);
+        m_notebooks.append(notebook);
+        emit notebookAdded(notebook->guid());
+        syncToCacheFile(notebook);
+    } else if (notebook->synced()) {
+        if (notebook->updateSequenceNumber() < result.updateSequenceNum) {
+            qCDebug(dcSync) << "Notebook on Evernote is newer than local copy. Updating:" << notebook->guid();
             updateFromEDAM(result, notebook);
-            m_notebooksHash.insert(notebook->guid(), notebook);
-            m_notebooks.append(notebook);
-            emit notebookAdded(notebook->guid());
+            emit notebookChanged(notebook->guid());
             syncToCacheFile(notebook);
-        } else if (notebook->synced()) {
-            if (notebook->updateSequenceNumber() < result.updateSequenceNum) {
-                qCDebug(dcSync) << "Notebook on Evernote is newer than local copy. Updating:" << notebook->guid();
-                updateFromEDAM(result, notebook);
-                emit notebookChanged(notebook->guid());
-                syncToCacheFile(notebook);
-            }
+        }
+    } else if (notebook->loading()) {
+        qCDebug(dcSync) << "Local notebook" << notebook->guid() << "is busy. Not pushing it again.";
+    } else {
+        if (result.updateSequenceNum == notebook->lastSyncedSequenceNumber()) {
+            // Local notebook changed. See if we can push our changes
+            pushNotebook(notebook);
         } else {
-            if (result.updateSequenceNum == notebook->lastSyncedSequenceNumber()) {
-                // Local notebook changed. See if we can push our changes
-                if (notebook->deleted()) {
-                    qCDebug(dcNotesStore) << "Local notebook has been deleted. Deleting from server";
-                    expungeNotebook(notebook->guid());
-                } else {
-                    qCDebug(dcNotesStore) << "Local Notebook changed. Uploading changes to Evernote:" << notebook->guid();
-                    SaveNotebookJob *job = new SaveNotebookJob(notebook);
-                    connect(job, &SaveNotebookJob::jobDone, this, &NotesStore::saveNotebookJobDone);
-                    EvernoteConnection::instance()->enqueue(job);
-                    notebook->setLoading(true);
-                    emit notebookChanged(notebook->guid());
-                }
-            } else {
-                qCWarning(dcNotesStore) << "Sync conflict in notebook:" << notebook->name();
-                qCWarning(dcNotesStore) << "Resolving of sync conflicts is not implemented yet.";
-                notebook->setSyncError(true);
-                emit notebookChanged(notebook->guid());
-            }
+            qCWarning(dcNotesStore) << "Sync conflict in notebook:" << notebook->name();
+            qCWarning(dcNotesStore) << "Resolving of sync conflicts is not implemented yet.";
+            notebook->setSyncError(true);
+            emit notebookChanged(notebook->guid());
         }
     }
+}
+
+void NotesStore::pushNotebook(Notebook *notebook)
+{
+    if (notebook->deleted()) {
+        qCDebug(dcNotesStore) << "Local notebook has been deleted. Deleting from server";
+        expungeNotebook(notebook->guid());
+    } else {
+        qCDebug(dcNotesStore) << "Local Notebook changed. Uploading changes to Evernote:" << notebook->guid();
+        SaveNotebookJob *job = new SaveNotebookJob(notebook);
+        connect(job, &SaveNotebookJob::jobDone, this, &NotesStore::saveNotebookJobDone);
+        EvernoteConnection::instance()->enqueueWrite(job);
+        pushStarted(notebook->guid());
+        notebook->setLoading(true);
+        emit notebookChanged(notebook->guid());
+    }
+}
 
-    qCDebug(dcSync) << "Remote notebooks merged into storage. Merging local changes to server.";
-
-    foreach (Notebook *notebook, unhandledNotebooks) {
-        if (notebook->lastSyncedSequenceNumber() == 0) {
-            qCDebug(dcSync) << "Have a local notebook that doesn't exist on Evernote. Creating on server:" << notebook->guid();
-            notebook->setLoading(true);
-            CreateNotebookJob *job = new CreateNotebookJob(notebook);
-            connect(job, &CreateNotebookJob::jobDone, this, &NotesStore::createNotebookJobDone);
-            EvernoteConnection::instance()->enqueue(job);
-            emit notebookChanged(notebook->guid());
-        } else {
-            qCDebug(dcSync) << "Notebook has been deleted on the server. Deleting local copy:" << notebook->guid();
-            m_notebooks.removeAll(notebook);
-            m_notebooksHash.remove(notebook->guid());
-            emit notebookRemoved(notebook->guid());
-
-            QSettings settings(m_cacheFile, QSettings::IniFormat);
-            settings.beginGroup("notebooks");
-            settings.remove(notebook->guid());
-            settings.endGroup();
+void NotesStore::createRemoteNotebook(Notebook *notebook)
+{
+    qCDebug(dcSync) << "Have a local notebook that doesn't exist on Evernote. Creating on server:" << notebook->guid();
+    notebook->setLoading(true);
+    CreateNotebookJob *job = new CreateNotebookJob(notebook);
+    connect(job, &CreateNotebookJob::jobDone, this, &NotesStore::createNotebookJobDone);
+    EvernoteConnection::instance()->enqueueWrite(job);
+    pushStarted(notebook->guid());
+    emit notebookChanged(notebook->guid());
+}
 
-            notebook->deleteInfoFile();
-            notebook->deleteLater();
-        }
-    }
+void NotesStore::remoteNotebookGone(Notebook *notebook)
+{
+    qCDebug(dcSync) << "Notebook has been deleted on the server. Deleting local copy:" << notebook->guid();
+    m_notebooks.removeAll(notebook);
+    m_notebooksHash.remove(notebook->guid());
+    emit notebookRemoved(notebook->guid());
 
-    qCDebug(dcSync) << "Notebooks merged.";
+    m_cacheWriter->removeNotebook(notebook->guid());
+    notebook->deleteLater();
 }
 
 void NotesStore::refreshTags()
 {
-    if (!EvernoteConnection::instance()->isConnected()) {
-        qCWarning(dcSync) << "Not connected. Cannot fetch tags from server.";
-        return;
-    }
+    synchronize();
+}
+
+void NotesStore::fetchTags()
+{
     m_tagsLoading = true;
     emit tagsLoadingChanged();
     FetchTagsJob *job = new FetchTagsJob();
@@ -1203,87 +2019,118 @@ void NotesStore::fetchTagsJobDone(EvernoteConnection::ErrorCode errorCode, const
     handleUserError(errorCode);
     if (errorCode != EvernoteConnection::ErrorCodeNoError) {
         qCWarning(dcSync) << "FetchTagsJobDone: Failed to fetch notes list:" << errorMessage << errorCode;
+        fullSyncListingDone(false);
         return;
     }
 
     QHash<QString, Tag*> unhandledTags = m_tagsHash;
     for (unsigned int i = 0; i < results.size(); ++i) {
-        evernote::edam::Tag result = results.at(i);
+        const evernote::edam::Tag &result = results.at(i);
         unhandledTags.remove(QString::fromStdString(result.guid));
-        Tag *tag = m_tagsHash.value(QString::fromStdString(result.guid));
-        bool newTag = tag == 0;
-        if (newTag) {
-            tag = new Tag(QString::fromStdString(result.guid), result.updateSequenceNum, this);
-            tag->setLastSyncedSequenceNumber(result.updateSequenceNum);
-            qCDebug(dcSync) << "got new tag with seq:" << result.updateSequenceNum << tag->synced() << tag->updateSequenceNumber() << tag->lastSyncedSequenceNumber();
-            tag->setName(QString::fromStdString(result.name));
-            m_tagsHash.insert(tag->guid(), tag);
-            m_tags.append(tag);
-            emit tagAdded(tag->guid());
-            syncToCacheFile(tag);
-        } else if (tag->synced()) {
-            if (tag->updateSequenceNumber() < result.updateSequenceNum) {
-                tag->setName(QString::fromStdString(result.name));
-                tag->setUpdateSequenceNumber(result.updateSequenceNum);
-                tag->setLastSyncedSequenceNumber(result.updateSequenceNum);
-                emit tagChanged(tag->guid());
-                syncToCacheFile(tag);
-            }
-        } else {
-            // local tag changed. See if we can sync it to the server
-            if (result.updateSequenceNum == tag->lastSyncedSequenceNumber()) {
-                if (tag->deleted()) {
-                    qCDebug(dcNotesStore) << "Tag has been deleted locally";
-                    expungeTag(tag->guid());
-                } else {
-                    SaveTagJob *job = new SaveTagJob(tag);
-                    connect(job, &SaveTagJob::jobDone, this, &NotesStore::saveTagJobDone);
-                    EvernoteConnection::instance()->enqueue(job);
-                    tag->setLoading(true);
-                    emit tagChanged(tag->guid());
-                }
-            } else {
-                qCWarning(dcSync) << "CONFLICT in tag" << tag->name();
-                tag->setSyncError(true);
-                emit tagChanged(tag->guid());
-            }
-        }
-
-
+        mergeRemoteTag(result);
     }
 
     foreach (Tag *tag, unhandledTags) {
+        if (tag->loading()) {
+            qCDebug(dcSync) << "Local tag" << tag->guid() << "is busy. Not pushing it again.";
+            continue;
+        }
         if (tag->lastSyncedSequenceNumber() == 0) {
-            tag->setLoading(true);
-            CreateTagJob *job = new CreateTagJob(tag);
-            connect(job, &CreateTagJob::jobDone, this, &NotesStore::createTagJobDone);
-            EvernoteConnection::instance()->enqueue(job);
-            emit tagChanged(tag->guid());
+            createRemoteTag(tag);
         } else {
-            m_tags.removeAll(tag);
-            m_tagsHash.remove(tag->guid());
-            emit tagRemoved(tag->guid());
+            remoteTagGone(tag);
+        }
+    }
+
+    fullSyncListingDone(true);
+}
 
-            tag->deleteInfoFile();
-            tag->deleteLater();
+void NotesStore::mergeRemoteTag(const evernote::edam::Tag &result)
+{
+    Tag *tag = m_tagsHash.value(QString::fromStdString(result.guid));
+    bool newTag = tag == 0;
+    if (newTag) {
+        tag = new Tag(QString::fromStdString(result.guid), result.updateSequenceNum, this);
+        tag->setLastSyncedSequenceNumber(result.updateSequenceNum);
+        qCDebug(dcSync) << "got new tag with seq:" << result.updateSequenceNum << tag->synced() << tag->updateSequenceNumber() << tag->lastSyncedSequenceNumber();
+        tag->setName(QString::fromStdString(result.name));
+        m_tagsHash.insert(tag->guid(), tag);
+        m_tags.append(tag);
+        emit tagAdded(tag->guid());
+        syncToCacheFile(tag);
+    } else if (tag->synced()) {
+        if (tag->updateSequenceNumber() < result.updateSequenceNum) {
+            tag->setName(QString::fromStdString(result.name));
+            tag->setUpdateSequenceNumber(result.updateSequenceNum);
+            tag->setLastSyncedSequenceNumber(result.updateSequenceNum);
+            emit tagChanged(tag->guid());
+            syncToCacheFile(tag);
+        }
+    } else if (tag->loading()) {
+        qCDebug(dcSync) << "Local tag" << tag->guid() << "is busy. Not pushing it again.";
+    } else {
+        // local tag changed. See if we can sync it to the server
+        if (result.updateSequenceNum == tag->lastSyncedSequenceNumber()) {
+            pushTag(tag);
+        } else {
+            qCWarning(dcSync) << "CONFLICT in tag" << tag->name();
+            tag->setSyncError(true);
+            emit tagChanged(tag->guid());
         }
     }
 }
 
+void NotesStore::pushTag(Tag *tag)
+{
+    if (tag->deleted()) {
+        qCDebug(dcNotesStore) << "Tag has been deleted locally";
+        expungeTag(tag->guid());
+    } else {
+        SaveTagJob *job = new SaveTagJob(tag);
+        connect(job, &SaveTagJob::jobDone, this, &NotesStore::saveTagJobDone);
+        EvernoteConnection::instance()->enqueueWrite(job);
+        pushStarted(tag->guid());
+        tag->setLoading(true);
+        emit tagChanged(tag->guid());
+    }
+}
+
+void NotesStore::createRemoteTag(Tag *tag)
+{
+    tag->setLoading(true);
+    CreateTagJob *job = new CreateTagJob(tag);
+    connect(job, &CreateTagJob::jobDone, this, &NotesStore::createTagJobDone);
+    EvernoteConnection::instance()->enqueueWrite(job);
+    pushStarted(tag->guid());
+    emit tagChanged(tag->guid());
+}
+
+void NotesStore::remoteTagGone(Tag *tag)
+{
+    m_tags.removeAll(tag);
+    m_tagsHash.remove(tag->guid());
+    emit tagRemoved(tag->guid());
+
+    m_cacheWriter->removeTag(tag->guid());
+    tag->deleteLater();
+}
+
 Note* NotesStore::createNote(const QString &title, const QString &notebookGuid, const QString &richTextContent)
 {
     EnmlDocument enmlDoc;
     enmlDoc.setRichText(richTextContent);
-    return createNote(title, notebookGuid, enmlDoc);
+    return exposeNoteView(createNote(title, notebookGuid, enmlDoc));
 }
 
 Note* NotesStore::createNote(const QString &title, const QString &notebookGuid, const EnmlDocument &content)
 {
     QString newGuid = QUuid::createUuid().toString();
     newGuid.remove("{").remove("}");
-    Note *note = new Note(newGuid, 1, this);
-    connect(note, &Note::reminderChanged, this, &NotesStore::emitDataChanged);
-    connect(note, &Note::reminderDoneChanged, this, &NotesStore::emitDataChanged);
+    NoteData *data = new NoteData();
+    data->guid = newGuid;
+    data->updateSequenceNumber = 1;
+    data->updateSynced();
+    Note *note = noteView(data);
 
     note->setTitle(title);
 
@@ -1304,32 +2151,36 @@ Note* NotesStore::createNote(const QString &title, const QString &notebookGuid,
     note->setUpdated(note->created());
 
     beginInsertRows(QModelIndex(), m_notes.count(), m_notes.count());
-    m_notesHash.insert(note->guid(), note);
-    m_notes.append(note);
+    m_notesHash.insert(note->guid(), NoteDataPointer(data));
+    m_notes.append(NoteDataPointer(data));
     endInsertRows();
 
     emit countChanged();
+    indexNote(data);
     emit noteAdded(note->guid(), note->notebookGuid());
     emit noteCreated(note->guid(), note->notebookGuid());
 
     syncToCacheFile(note);
+    m_journal->append(OperationJournal::OperationCreateNote, note->guid());
 
     if (EvernoteConnection::instance()->isConnected()) {
         CreateNoteJob *job = new CreateNoteJob(note);
         connect(job, &CreateNoteJob::jobDone, this, &NotesStore::createNoteJobDone);
-        EvernoteConnection::instance()->enqueue(job);
+        EvernoteConnection::instance()->enqueueWrite(job);
+        pushStarted(note->guid());
     }
     return note;
 }
 
 void NotesStore::createNoteJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const QString &tmpGuid, const evernote::edam::Note &result)
 {
-    Note *note = m_notesHash.value(tmpGuid);
+    Note *note = noteView(tmpGuid);
     if (!note) {
         qCWarning(dcSync) << "Cannot find temporary note after create operation!";
+        pushFinished(tmpGuid, false);
         return;
     }
-    int idx = m_notes.indexOf(note);
+    int idx = indexOf(note);
     QVector<int> roles;
 
     note->setLoading(false);
@@ -1338,6 +2189,7 @@ void NotesStore::createNoteJobDone(EvernoteConnection::ErrorCode errorCode, cons
     handleUserError(errorCode);
     if (errorCode != EvernoteConnection::ErrorCodeNoError) {
         qCWarning(dcSync) << "Error creating note on server:" << tmpGuid << errorMessage;
+        pushFinished(tmpGuid, false);
         note->setSyncError(true);
         roles << RoleSyncError;
         emit dataChanged(index(idx), index(idx), roles);
@@ -1351,10 +2203,12 @@ void NotesStore::createNoteJobDone(EvernoteConnection::ErrorCode errorCode, cons
 
     QString guid = QString::fromStdString(result.guid);
     qCDebug(dcSync) << "Note created on server. Old guid:" << tmpGuid << "New guid:" << guid;
-    m_notesHash.insert(guid, note);
+    m_notesHash.insert(guid, m_notesHash.take(tmpGuid));
     note->setGuid(guid);
-    m_notesHash.remove(tmpGuid);
+    renameIndexedNote(note->m_data.data(), tmpGuid);
     emit noteGuidChanged(tmpGuid, guid);
+    pushRenamed(tmpGuid, guid);
+    pushFinished(guid, true);
     roles << RoleGuid;
 
     if (note->updateSequenceNumber() != result.updateSequenceNum) {
@@ -1382,19 +2236,19 @@ void NotesStore::createNoteJobDone(EvernoteConnection::ErrorCode errorCode, cons
         note->setEnmlContent(QString::fromStdString(result.content));
         roles << RoleEnmlContent << RoleRichTextContent << RoleTagline << RolePlaintextContent;
     }
+    if (result.__isset.contentHash) {
+        note->setContentHash(QByteArray(result.contentHash.c_str(), result.contentHash.length()), result.contentLength);
+    }
     emit dataChanged(index(idx), index(idx), roles);
+    indexNote(note->m_data.data());
 
-    QSettings cacheFile(m_cacheFile, QSettings::IniFormat);
-    cacheFile.beginGroup("notes");
-    cacheFile.remove(tmpGuid);
-    cacheFile.endGroup();
-
+    m_cacheWriter->removeNote(tmpGuid);
     syncToCacheFile(note);
 }
 
 void NotesStore::saveNote(const QString &guid)
 {
-    Note *note = m_notesHash.value(guid);
+    Note *note = noteView(guid);
     if (!note) {
         qCWarning(dcNotesStore) << "Can't save note. Guid not found:" << guid;
         return;
@@ -1404,6 +2258,7 @@ void NotesStore::saveNote(const QString &guid)
     note->setUpdated(QDateTime::currentDateTime());
     syncToCacheFile(note);
     note->syncToCacheFile();
+    m_journal->append(OperationJournal::OperationSaveNote, guid);
 
     if (EvernoteConnection::instance()->isConnected()) {
         note->setLoading(true);
@@ -1417,10 +2272,12 @@ void NotesStore::saveNote(const QString &guid)
             connect(job, &SaveNoteJob::jobDone, this, &NotesStore::saveNoteJobDone);
             EvernoteConnection::instance()->enqueueWrite(job);
         }
+        pushStarted(guid);
     }
 
-    int idx = m_notes.indexOf(note);
+    int idx = indexOf(note);
     emit dataChanged(index(idx), index(idx));
+    indexNote(note->m_data.data());
     emit noteChanged(guid, note->notebookGuid());
 
     m_organizerAdapter->startSync();
@@ -1429,13 +2286,15 @@ void NotesStore::saveNote(const QString &guid)
 void NotesStore::saveNoteJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const evernote::edam::Note &result)
 {
     qCDebug(dcSync) << "Note saved to server:" << QString::fromStdString(result.guid);
-    Note *note = m_notesHash.value(QString::fromStdString(result.guid));
+    pushFinished(QString::fromStdString(result.guid), errorCode == EvernoteConnection::ErrorCodeNoError);
+
+    Note *note = noteView(QString::fromStdString(result.guid));
     if (!note) {
         qCWarning(dcSync) << "Got a save note job result, but note has disappeared locally.";
         return;
     }
 
-    int idx = m_notes.indexOf(note);
+    int idx = indexOf(note);
     note->setLoading(false);
     QModelIndex noteIndex = index(idx);
 
@@ -1448,14 +2307,28 @@ void NotesStore::saveNoteJobDone(EvernoteConnection::ErrorCode errorCode, const
     }
 
     note->setLastSyncedSequenceNumber(result.updateSequenceNum);
+    if (result.__isset.contentHash) {
+        note->setContentHash(QByteArray(result.contentHash.c_str(), result.contentHash.length()), result.contentLength);
+    }
+
+    // Remember the guids of newly uploaded resources, the next save doesn't need to send their data again
+    for (unsigned int i = 0; i < result.resources.size(); ++i) {
+        ResourceRecord record = resourceRecord(result.resources.at(i));
+        if (note->resource(record.hash)) {
+            note->addResource(record);
+        }
+    }
     syncToCacheFile(note);
 
     emit dataChanged(noteIndex, noteIndex);
+    indexNote(note->m_data.data());
     emit noteChanged(note->guid(), note->notebookGuid());
 }
 
 void NotesStore::saveNotebookJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const evernote::edam::Notebook &result)
 {
+    pushFinished(QString::fromStdString(result.guid), errorCode == EvernoteConnection::ErrorCodeNoError);
+
     Notebook *notebook = m_notebooksHash.value(QString::fromStdString(result.guid));
     if (!notebook) {
         qCWarning(dcSync) << "Save notebook job done but notebook can't be found any more!";
@@ -1481,16 +2354,18 @@ void NotesStore::saveNotebookJobDone(EvernoteConnection::ErrorCode errorCode, co
 
 void NotesStore::deleteNote(const QString &guid)
 {
-    Note *note = m_notesHash.value(guid);
+    Note *note = noteView(guid);
     if (!note) {
         qCWarning(dcNotesStore) << "Note not found. Can't delete";
         return;
     }
 
-    int idx = m_notes.indexOf(note);
+    int idx = indexOf(note);
 
     if (note->lastSyncedSequenceNumber() == 0) {
         removeNote(guid);
+        // Never made it to the server. Nothing left to push.
+        m_journal->acknowledge(guid, m_journal->lastSequence());
     } else {
 
         qCDebug(dcNotesStore) << "Setting note to deleted:" << note->guid();
@@ -1499,10 +2374,12 @@ void NotesStore::deleteNote(const QString &guid)
         emit dataChanged(index(idx), index(idx), QVector<int>() << RoleDeleted);
 
         syncToCacheFile(note);
+        m_journal->append(OperationJournal::OperationDeleteNote, guid);
         if (EvernoteConnection::instance()->isConnected()) {
             DeleteNoteJob *job = new DeleteNoteJob(guid, this);
             connect(job, &DeleteNoteJob::jobDone, this, &NotesStore::deleteNoteJobDone);
-            EvernoteConnection::instance()->enqueue(job);
+            EvernoteConnection::instance()->enqueueWrite(job);
+            pushStarted(guid);
         }
     }
 
@@ -1516,13 +2393,17 @@ void NotesStore::findNotes(const QString &searchWords)
     if (EvernoteConnection::instance()->isConnected()) {
         clearSearchResults();
         FetchNotesJob *job = new FetchNotesJob(QString(), searchWords + "*");
-        connect(job, &FetchNotesJob::jobDone, this, &NotesStore::fetchNotesJobDone);
+        connect(job, &FetchNotesJob::jobDone, this, &NotesStore::findNotesJobDone);
         EvernoteConnection::instance()->enqueue(job);
     } else {
-        foreach (Note *note, m_notes) {
-            bool matches = note->title().contains(searchWords, Qt::CaseInsensitive);
-            matches |= note->plaintextContent().contains(searchWords, Qt::CaseInsensitive);
-            note->setIsSearchResult(matches);
+        foreach (const NoteDataPointer &data, m_notes) {
+            bool matches = data->title.contains(searchWords, Qt::CaseInsensitive);
+            matches |= data->content.toPlaintext().contains(searchWords, Qt::CaseInsensitive);
+            if (data->view) {
+                data->view->setIsSearchResult(matches);
+            } else {
+                data->isSearchResult = matches;
+            }
         }
         emit dataChanged(index(0), index(m_notes.count()-1), QVector<int>() << RoleIsSearchResult);
     }
@@ -1530,14 +2411,20 @@ void NotesStore::findNotes(const QString &searchWords)
 
 void NotesStore::clearSearchResults()
 {
-    foreach (Note *note, m_notes) {
-        note->setIsSearchResult(false);
+    foreach (const NoteDataPointer &data, m_notes) {
+        if (data->view) {
+            data->view->setIsSearchResult(false);
+        } else {
+            data->isSearchResult = false;
+        }
     }
     emit dataChanged(index(0), index(m_notes.count()-1), QVector<int>() << RoleIsSearchResult);
 }
 
 void NotesStore::deleteNoteJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const QString &guid)
 {
+    pushFinished(guid, errorCode == EvernoteConnection::ErrorCodeNoError);
+
     handleUserError(errorCode);
     if (errorCode != EvernoteConnection::ErrorCodeNoError) {
         qCWarning(dcSync) << "Cannot delete note from server:" << errorMessage;
@@ -1548,6 +2435,8 @@ void NotesStore::deleteNoteJobDone(EvernoteConnection::ErrorCode errorCode, cons
 
 void NotesStore::expungeNotebookJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const QString &guid)
 {
+    pushFinished(guid, errorCode == EvernoteConnection::ErrorCodeNoError);
+
     handleUserError(errorCode);
     if (errorCode != EvernoteConnection::ErrorCodeNoError) {
         qCWarning(dcSync) << "Error expunging notebook:" << errorMessage;
@@ -1563,34 +2452,35 @@ void NotesStore::expungeNotebookJobDone(EvernoteConnection::ErrorCode errorCode,
     Notebook *notebook = m_notebooksHash.take(guid);
     m_notebooks.removeAll(notebook);
 
-    QSettings settings(m_cacheFile, QSettings::IniFormat);
-    settings.beginGroup("notebooks");
-    settings.remove(notebook->guid());
-    settings.endGroup();
-
-    notebook->deleteInfoFile();
+    m_cacheWriter->removeNotebook(guid);
     notebook->deleteLater();
 }
 
 void NotesStore::emitDataChanged()
 {
     Note *note = qobject_cast<Note*>(sender());
-    if (!note) {
+    if (!note || !m_noteViews.contains(note)) {
         return;
     }
-    int idx = m_notes.indexOf(note);
+    int idx = indexOf(note);
     emit dataChanged(index(idx), index(idx));
 }
 
 void NotesStore::clear()
 {
     beginResetModel();
-    foreach (Note *note, m_notes) {
-        emit noteRemoved(note->guid(), note->notebookGuid());
-        note->deleteLater();
+    foreach (const NoteDataPointer &data, m_notes) {
+        emit noteRemoved(data->guid, data->notebookGuid);
+    }
+    foreach (Note *note, m_noteViews) {
+        releaseNoteView(note);
     }
     m_notes.clear();
     m_notesHash.clear();
+    m_resourceFetches.clear();
+    m_deferredRemoteNotesGone.clear();
+    m_notebookNotes.clear();
+    m_tagNotes.clear();
     endResetModel();
 
     while (!m_notebooks.isEmpty()) {
@@ -1609,86 +2499,245 @@ void NotesStore::clear()
 void NotesStore::syncToCacheFile(Note *note)
 {
     qCDebug(dcNotesStore) << "Syncing note to disk:" << note->guid();
-    QSettings cacheFile(m_cacheFile, QSettings::IniFormat);
-    cacheFile.beginGroup("notes");
-    cacheFile.setValue(note->guid(), note->updateSequenceNumber());
-    cacheFile.endGroup();
-    note->syncToInfoFile();
+    m_cacheWriter->upsert(note->record());
 }
 
 void NotesStore::deleteFromCacheFile(Note *note)
 {
-    QSettings cacheFile(m_cacheFile, QSettings::IniFormat);
-    cacheFile.beginGroup("notes");
-    cacheFile.remove(note->guid());
-    cacheFile.endGroup();
     note->deleteFromCache();
+    m_cacheWriter->removeNote(note->guid());
 }
 
 void NotesStore::syncToCacheFile(Notebook *notebook)
 {
-    QSettings cacheFile(m_cacheFile, QSettings::IniFormat);
-    cacheFile.beginGroup("notebooks");
-    cacheFile.setValue(notebook->guid(), notebook->updateSequenceNumber());
-    cacheFile.endGroup();
-    notebook->syncToInfoFile();
+    m_cacheWriter->upsert(notebook->record());
 }
 
 void NotesStore::syncToCacheFile(Tag *tag)
 {
-    QSettings cacheFile(m_cacheFile, QSettings::IniFormat);
-    cacheFile.beginGroup("tags");
-    cacheFile.setValue(tag->guid(), tag->updateSequenceNumber());
-    cacheFile.endGroup();
-    tag->syncToInfoFile();
+    m_cacheWriter->upsert(tag->record());
+}
+
+void NotesStore::pushStarted(const QString &guid)
+{
+    // The job carries the object's state as of now, so it covers everything journaled so far
+    m_pushedSequences[guid].append(m_journal->lastSequence());
+}
+
+void NotesStore::pushFinished(const QString &guid, bool success)
+{
+    QHash<QString, QList<quint64> >::iterator it = m_pushedSequences.find(guid);
+    if (it == m_pushedSequences.end()) {
+        return;
+    }
+    quint64 sequence = it->takeFirst();
+    if (it->isEmpty()) {
+        m_pushedSequences.erase(it);
+    }
+    if (success) {
+        m_journal->acknowledge(guid, sequence);
+    }
+}
+
+void NotesStore::pushRenamed(const QString &oldGuid, const QString &newGuid)
+{
+    m_journal->renameGuid(oldGuid, newGuid);
+    if (m_pushedSequences.contains(oldGuid)) {
+        m_pushedSequences[newGuid] = m_pushedSequences.take(oldGuid);
+    }
+}
+
+void NotesStore::replayJournal()
+{
+    QList<OperationJournal::Entry> pending = m_journal->pending();
+    if (pending.isEmpty()) {
+        return;
+    }
+    qCDebug(dcSync) << "Replaying" << pending.count() << "journaled operations.";
+
+    // Each push sends the object's current state, so one push per object is enough.
+    // Objects are pushed in the order they were first touched, which makes sure a notebook
+    // or tag is created before notes referring to it.
+    QSet<QString> replayed;
+    foreach (const OperationJournal::Entry &entry, pending) {
+        if (replayed.contains(entry.guid)) {
+            continue;
+        }
+        replayed.insert(entry.guid);
+
+        switch (entry.operation) {
+        case OperationJournal::OperationCreateNotebook:
+        case OperationJournal::OperationSaveNotebook:
+        case OperationJournal::OperationExpungeNotebook: {
+            Notebook *notebook = m_notebooksHash.value(entry.guid);
+            if (!notebook) {
+                m_journal->acknowledge(entry.guid, m_journal->lastSequence());
+                break;
+            }
+            if (notebook->loading()) {
+                break;
+            }
+            if (notebook->deleted()) {
+                ExpungeNotebookJob *job = new ExpungeNotebookJob(notebook->guid(), this);
+                connect(job, &ExpungeNotebookJob::jobDone, this, &NotesStore::expungeNotebookJobDone);
+                EvernoteConnection::instance()->enqueueWrite(job);
+            } else if (notebook->lastSyncedSequenceNumber() == 0) {
+                CreateNotebookJob *job = new CreateNotebookJob(notebook);
+                connect(job, &CreateNotebookJob::jobDone, this, &NotesStore::createNotebookJobDone);
+                EvernoteConnection::instance()->enqueueWrite(job);
+                notebook->setLoading(true);
+            } else {
+                SaveNotebookJob *job = new SaveNotebookJob(notebook, this);
+                connect(job, &SaveNotebookJob::jobDone, this, &NotesStore::saveNotebookJobDone);
+                EvernoteConnection::instance()->enqueueWrite(job);
+                notebook->setLoading(true);
+            }
+            pushStarted(notebook->guid());
+            break;
+        }
+        case OperationJournal::OperationCreateTag:
+        case OperationJournal::OperationSaveTag:
+        case OperationJournal::OperationExpungeTag: {
+            Tag *tag = m_tagsHash.value(entry.guid);
+            if (!tag) {
+                m_journal->acknowledge(entry.guid, m_journal->lastSequence());
+                break;
+            }
+            if (tag->loading()) {
+                break;
+            }
+            if (tag->deleted()) {
+                ExpungeTagJob *job = new ExpungeTagJob(tag->guid(), this);
+                connect(job, &ExpungeTagJob::jobDone, this, &NotesStore::expungeTagJobDone);
+                EvernoteConnection::instance()->enqueueWrite(job);
+            } else if (tag->lastSyncedSequenceNumber() == 0) {
+                CreateTagJob *job = new CreateTagJob(tag);
+                connect(job, &CreateTagJob::jobDone, this, &NotesStore::createTagJobDone);
+                EvernoteConnection::instance()->enqueueWrite(job);
+                tag->setLoading(true);
+            } else {
+                SaveTagJob *job = new SaveTagJob(tag);
+                connect(job, &SaveTagJob::jobDone, this, &NotesStore::saveTagJobDone);
+                EvernoteConnection::instance()->enqueueWrite(job);
+                tag->setLoading(true);
+            }
+            pushStarted(tag->guid());
+            break;
+        }
+        case OperationJournal::OperationCreateNote:
+        case OperationJournal::OperationSaveNote:
+        case OperationJournal::OperationDeleteNote:
+        case OperationJournal::OperationTagNote:
+        case OperationJournal::OperationUntagNote: {
+            Note *note = noteView(entry.guid);
+            if (!note) {
+                m_journal->acknowledge(entry.guid, m_journal->lastSequence());
+                break;
+            }
+            if (note->loading()) {
+                break;
+            }
+            if (note->deleted()) {
+                DeleteNoteJob *job = new DeleteNoteJob(note->guid(), this);
+                connect(job, &DeleteNoteJob::jobDone, this, &NotesStore::deleteNoteJobDone);
+                EvernoteConnection::instance()->enqueueWrite(job);
+                pushStarted(note->guid());
+                break;
+            }
+
+            // The server would refuse references to objects it doesn't know yet. Leave
+            // those to the regular sync which runs after the notebooks and tags are created.
+            Notebook *notebook = m_notebooksHash.value(note->notebookGuid());
+            bool dependenciesSynced = !notebook || notebook->lastSyncedSequenceNumber() > 0;
+            foreach (const QString &tagGuid, note->tagGuids()) {
+                Tag *tag = m_tagsHash.value(tagGuid);
+                dependenciesSynced &= !tag || tag->lastSyncedSequenceNumber() > 0;
+            }
+            if (!dependenciesSynced) {
+                qCDebug(dcSync) << "Postponing replay of note" << note->guid() << "until its notebook and tags are on the server.";
+                break;
+            }
+
+            if (!note->loaded()) {
+                note->loadFromCacheFile();
+            }
+            note->setLoading(true);
+            if (note->lastSyncedSequenceNumber() == 0) {
+                CreateNoteJob *job = new CreateNoteJob(note, this);
+                connect(job, &CreateNoteJob::jobDone, this, &NotesStore::createNoteJobDone);
+                EvernoteConnection::instance()->enqueueWrite(job);
+            } else {
+                SaveNoteJob *job = new SaveNoteJob(note, this);
+                connect(job, &SaveNoteJob::jobDone, this, &NotesStore::saveNoteJobDone);
+                EvernoteConnection::instance()->enqueueWrite(job);
+            }
+            pushStarted(note->guid());
+            break;
+        }
+        }
+    }
+}
+
+void NotesStore::flushCache()
+{
+    m_cacheWriter->flush();
 }
 
 void NotesStore::loadFromCacheFile()
 {
     clear();
-    QSettings cacheFile(m_cacheFile, QSettings::IniFormat);
 
-    cacheFile.beginGroup("notebooks");
-    if (cacheFile.allKeys().count() > 0) {
-        foreach (const QString &key, cacheFile.allKeys()) {
-            Notebook *notebook = new Notebook(key, cacheFile.value(key).toUInt(), this);
-            m_notebooksHash.insert(key, notebook);
-            m_notebooks.append(notebook);
-            emit notebookAdded(key);
+    QElapsedTimer timer;
+    timer.start();
+
+    CacheSnapshot snapshot;
+    if (!snapshot.load(m_cacheFile)) {
+        if (snapshot.importLegacy(storageLocation())) {
+            qCDebug(dcStorage) << "Migrating legacy cache to" << m_cacheFile;
+            if (snapshot.save(m_cacheFile)) {
+                snapshot.removeLegacyFiles(storageLocation());
+            }
         }
     }
-    cacheFile.endGroup();
+    m_cacheWriter->reset(m_cacheFile, snapshot);
+    m_syncState = snapshot.syncState;
+    m_fullSyncListings = 0;
+
+    foreach (const NotebookRecord &record, snapshot.notebooks) {
+        Notebook *notebook = new Notebook(record, this);
+        m_notebooksHash.insert(notebook->guid(), notebook);
+        m_notebooks.append(notebook);
+        emit notebookAdded(notebook->guid());
+    }
     qCDebug(dcNotesStore) << "Loaded" << m_notebooks.count() << "notebooks from disk.";
 
-    cacheFile.beginGroup("tags");
-    if (cacheFile.allKeys().count() > 0) {
-        foreach (const QString &key, cacheFile.allKeys()) {
-            Tag *tag = new Tag(key, cacheFile.value(key).toUInt(), this);
-            m_tagsHash.insert(key, tag);
-            m_tags.append(tag);
-            emit tagAdded(key);
-        }
+    foreach (const TagRecord &record, snapshot.tags) {
+        Tag *tag = new Tag(record, this);
+        m_tagsHash.insert(tag->guid(), tag);
+        m_tags.append(tag);
+        emit tagAdded(tag->guid());
     }
-    cacheFile.endGroup();
     qCDebug(dcNotesStore) << "Loaded" << m_tags.count() << "tags from disk.";
 
-    cacheFile.beginGroup("notes");
-    if (cacheFile.allKeys().count() > 0) {
-        beginInsertRows(QModelIndex(), 0, cacheFile.allKeys().count()-1);
-        foreach (const QString &key, cacheFile.allKeys()) {
-            if (m_notesHash.contains(key)) {
+    if (snapshot.notes.count() > 0) {
+        beginInsertRows(QModelIndex(), 0, snapshot.notes.count()-1);
+        foreach (const NoteRecord &record, snapshot.notes) {
+            if (m_notesHash.contains(record.guid)) {
                 qCWarning(dcNotesStore) << "already have note. Not reloading from cache.";
                 continue;
             }
-            Note *note = new Note(key, cacheFile.value(key).toUInt(), this);
-            m_notesHash.insert(key, note);
-            m_notes.append(note);
-            emit noteAdded(note->guid(), note->notebookGuid());
+            NoteDataPointer data(new NoteData(record));
+            m_notesHash.insert(data->guid, data);
+            m_notes.append(data);
+            indexNote(data.data());
+            emit noteAdded(data->guid, data->notebookGuid);
         }
         endInsertRows();
     }
-    cacheFile.endGroup();
     qCDebug(dcNotesStore) << "Loaded" << m_notes.count() << "notes from disk.";
+    qCDebug(dcStorage) << "Loading the snapshot took" << timer.elapsed() << "ms";
+
+    m_resourceCollectTimer.start();
 }
 
 QVector<int> NotesStore::updateFromEDAM(const evernote::edam::NoteMetadata &evNote, Note *note)
@@ -1802,25 +2851,231 @@ bool NotesStore::handleUserError(EvernoteConnection::ErrorCode errorCode)
     return true;
 }
 
+void NotesStore::updateNoteReferences(const QString &oldGuid, const QString &newGuid)
+{
+    // Only one of those is non-empty, guids are unique across notebooks and tags
+    QStringList notebookNotes = m_notebookNotes.take(oldGuid);
+    if (!notebookNotes.isEmpty()) {
+        m_notebookNotes.insert(newGuid, notebookNotes);
+        m_noteCountChangedNotebooks.insert(newGuid);
+    }
+    QStringList tagNotes = m_tagNotes.take(oldGuid);
+    if (!tagNotes.isEmpty()) {
+        m_tagNotes.insert(newGuid, tagNotes);
+        m_noteCountChangedTags.insert(newGuid);
+    }
+
+    foreach (const QString &noteGuid, notebookNotes) {
+        NoteData *data = m_notesHash.value(noteGuid).data();
+        data->indexedNotebookGuid = newGuid;
+        if (data->notebookGuid != oldGuid) {
+            continue;
+        }
+        if (data->view) {
+            data->view->setNotebookGuid(newGuid);
+        } else {
+            data->notebookGuid = newGuid;
+        }
+        m_cacheWriter->upsert(data->record());
+    }
+    foreach (const QString &noteGuid, tagNotes) {
+        NoteData *data = m_notesHash.value(noteGuid).data();
+        data->indexedTagGuids.replace(data->indexedTagGuids.indexOf(oldGuid), newGuid);
+        int tagIndex = data->tagGuids.indexOf(oldGuid);
+        if (tagIndex == -1) {
+            continue;
+        }
+        QStringList tagGuids = data->tagGuids;
+        tagGuids.replace(tagIndex, newGuid);
+        if (data->view) {
+            data->view->setTagGuids(tagGuids);
+        } else {
+            data->tagGuids = tagGuids;
+        }
+        m_cacheWriter->upsert(data->record());
+    }
+
+    if (!notebookNotes.isEmpty() || !tagNotes.isEmpty()) {
+        m_noteCountChangedTimer.start();
+    }
+}
+
+static void removeFromIndex(QHash<QString, QStringList> &index, const QString &key, const QString &noteGuid)
+{
+    QHash<QString, QStringList>::iterator it = index.find(key);
+    if (it == index.end()) {
+        return;
+    }
+    it->removeOne(noteGuid);
+    if (it->isEmpty()) {
+        index.erase(it);
+    }
+}
+
+void NotesStore::indexNote(NoteData *data)
+{
+    if (data->indexedNotebookGuid != data->notebookGuid) {
+        if (!data->indexedNotebookGuid.isEmpty()) {
+            removeFromIndex(m_notebookNotes, data->indexedNotebookGuid, data->guid);
+            m_noteCountChangedNotebooks.insert(data->indexedNotebookGuid);
+        }
+        if (!data->notebookGuid.isEmpty()) {
+            m_notebookNotes[data->notebookGuid].append(data->guid);
+            m_noteCountChangedNotebooks.insert(data->notebookGuid);
+        }
+        data->indexedNotebookGuid = data->notebookGuid;
+    }
+
+    if (data->indexedTagGuids != data->tagGuids) {
+        foreach (const QString &tagGuid, data->indexedTagGuids) {
+            if (!data->tagGuids.contains(tagGuid)) {
+                removeFromIndex(m_tagNotes, tagGuid, data->guid);
+                m_noteCountChangedTags.insert(tagGuid);
+            }
+        }
+        foreach (const QString &tagGuid, data->tagGuids) {
+            if (!data->indexedTagGuids.contains(tagGuid)) {
+                m_tagNotes[tagGuid].append(data->guid);
+                m_noteCountChangedTags.insert(tagGuid);
+            }
+        }
+        data->indexedTagGuids = data->tagGuids;
+    }
+
+    if (!m_noteCountChangedTimer.isActive() && (!m_noteCountChangedNotebooks.isEmpty() || !m_noteCountChangedTags.isEmpty())) {
+        m_noteCountChangedTimer.start();
+    }
+}
+
+void NotesStore::unindexNote(NoteData *data)
+{
+    if (!data->indexedNotebookGuid.isEmpty()) {
+        removeFromIndex(m_notebookNotes, data->indexedNotebookGuid, data->guid);
+        m_noteCountChangedNotebooks.insert(data->indexedNotebookGuid);
+    }
+    foreach (const QString &tagGuid, data->indexedTagGuids) {
+        removeFromIndex(m_tagNotes, tagGuid, data->guid);
+        m_noteCountChangedTags.insert(tagGuid);
+    }
+    data->indexedNotebookGuid.clear();
+    data->indexedTagGuids.clear();
+
+    if (!m_noteCountChangedTimer.isActive() && (!m_noteCountChangedNotebooks.isEmpty() || !m_noteCountChangedTags.isEmpty())) {
+        m_noteCountChangedTimer.start();
+    }
+}
+
+void NotesStore::renameIndexedNote(NoteData *data, const QString &oldGuid)
+{
+    if (!data->indexedNotebookGuid.isEmpty()) {
+        QStringList &notes = m_notebookNotes[data->indexedNotebookGuid];
+        notes.replace(notes.indexOf(oldGuid), data->guid);
+    }
+    foreach (const QString &tagGuid, data->indexedTagGuids) {
+        QStringList &notes = m_tagNotes[tagGuid];
+        notes.replace(notes.indexOf(oldGuid), data->guid);
+    }
+}
+
+void NotesStore::emitNoteCountChanges()
+{
+    QSet<QString> notebookGuids;
+    QSet<QString> tagGuids;
+    notebookGuids.swap(m_noteCountChangedNotebooks);
+    tagGuids.swap(m_noteCountChangedTags);
+
+    foreach (const QString &guid, notebookGuids) {
+        Notebook *notebook = m_notebooksHash.value(guid);
+        if (notebook) {
+            emit notebook->noteCountChanged();
+        }
+    }
+    foreach (const QString &guid, tagGuids) {
+        Tag *tag = m_tagsHash.value(guid);
+        if (tag) {
+            emit tag->noteCountChanged();
+        }
+    }
+}
+
 void NotesStore::removeNote(const QString &guid)
 {
-    Note *note = m_notesHash.value(guid);
-    int idx = m_notes.indexOf(note);
+    NoteData *data = m_notesHash.value(guid).data();
+    if (data) {
+        removeNotes(QSet<NoteData*>() << data);
+    }
+}
 
-    emit noteRemoved(note->guid(), note->notebookGuid());
+void NotesStore::removeNotes(const QSet<NoteData*> &notes)
+{
+    if (notes.isEmpty()) {
+        return;
+    }
 
-    beginRemoveRows(QModelIndex(), idx, idx);
-    m_notes.removeAt(idx);
-    m_notesHash.remove(note->guid());
-    endRemoveRows();
-    emit countChanged();
+    foreach (NoteData *data, notes) {
+        unindexNote(data);
+        emit noteRemoved(data->guid, data->notebookGuid);
+        m_cacheWriter->removeNote(data->guid);
+        if (data->view) {
+            releaseNoteView(data->view);
+        }
+    }
+
+    // Removing row by row moves the rest of the list every time. That adds up when the server
+    // dropped many notes scattered all over the list, rebuilding the list is cheaper then.
+    int runs = 0;
+    for (int i = 0; i < m_notes.count(); ++i) {
+        if (notes.contains(m_notes.at(i).data()) && (i == 0 || !notes.contains(m_notes.at(i - 1).data()))) {
+            runs++;
+        }
+    }
 
-    QSettings settings(m_cacheFile, QSettings::IniFormat);
-    settings.beginGroup("notes");
-    settings.remove(note->guid());
-    settings.endGroup();
+    // Keeps the data alive until we're done with the guids
+    QList<NoteDataPointer> removed;
+    removed.reserve(notes.count());
 
-    note->deleteLater();
+    if (runs > s_maxRemovedRowRanges) {
+        beginResetModel();
+        QList<NoteDataPointer> remaining;
+        remaining.reserve(m_notes.count() - notes.count());
+        foreach (const NoteDataPointer &data, m_notes) {
+            if (notes.contains(data.data())) {
+                removed.append(data);
+            } else {
+                remaining.append(data);
+            }
+        }
+        m_notes = remaining;
+        foreach (const NoteDataPointer &data, removed) {
+            m_notesHash.remove(data->guid);
+        }
+        endResetModel();
+    } else {
+        // Back to front, so the rows before a removed range keep their index
+        for (int last = m_notes.count() - 1; last >= 0; --last) {
+            if (!notes.contains(m_notes.at(last).data())) {
+                continue;
+            }
+            int first = last;
+            while (first > 0 && notes.contains(m_notes.at(first - 1).data())) {
+                first--;
+            }
+            beginRemoveRows(QModelIndex(), first, last);
+            for (int i = first; i <= last; ++i) {
+                removed.append(m_notes.at(i));
+                m_notesHash.remove(m_notes.at(i)->guid);
+            }
+            m_notes.erase(m_notes.begin() + first, m_notes.begin() + last + 1);
+            endRemoveRows();
+            last = first;
+        }
+    }
+    emit countChanged();
+
+    // Attachments may be orphaned now
+    if (!m_resourceCollectTimer.isActive()) {
+        m_resourceCollectTimer.start();
+    }
 }
 
 void NotesStore::expungeTag(const QString &guid)
@@ -1846,7 +3101,7 @@ void NotesStore::expungeTag(const QString &guid)
 
     while (tag->noteCount() > 0) {
         QString noteGuid = tag->noteAt(0);
-        Note *note = m_notesHash.value(noteGuid);
+        Note *note = noteView(noteGuid);
         if (!note) {
             qCWarning(dcNotesStore) << "Tag holds note" << noteGuid << "which hasn't been found in Notes Store";
             Q_ASSERT(false);
@@ -1860,13 +3115,9 @@ void NotesStore::expungeTag(const QString &guid)
         m_tagsHash.remove(guid);
         m_tags.removeAll(tag);
 
-        QSettings cacheFile(m_cacheFile, QSettings::IniFormat);
-        cacheFile.beginGroup("tags");
-        cacheFile.remove(guid);
-        cacheFile.endGroup();
-        tag->syncToInfoFile();
-
-        tag->deleteInfoFile();
+        m_cacheWriter->removeTag(guid);
+        // Never made it to the server. Nothing left to push.
+        m_journal->acknowledge(guid, m_journal->lastSequence());
         tag->deleteLater();
     } else {
         qCDebug(dcNotesStore) << "Setting tag to deleted:" << tag->guid();
@@ -1874,18 +3125,20 @@ void NotesStore::expungeTag(const QString &guid)
         tag->setUpdateSequenceNumber(tag->updateSequenceNumber()+1);
         emit tagChanged(tag->guid());
         syncToCacheFile(tag);
+        m_journal->append(OperationJournal::OperationExpungeTag, guid);
 
         if (EvernoteConnection::instance()->isConnected()) {
             ExpungeTagJob *job = new ExpungeTagJob(guid, this);
             connect(job, &ExpungeTagJob::jobDone, this, &NotesStore::expungeTagJobDone);
-            EvernoteConnection::instance()->enqueue(job);
+            EvernoteConnection::instance()->enqueueWrite(job);
+            pushStarted(guid);
         }
     }
 }
 
 void NotesStore::resolveConflict(const QString &noteGuid, NotesStore::ConflictResolveMode mode)
 {
-    Note *note = m_notesHash.value(noteGuid);
+    Note *note = noteView(noteGuid);
     if (!note) {
         qCWarning(dcNotesStore) << "Should resolve a conflict but can't find note for guid:" << noteGuid;
         return;
@@ -1902,14 +3155,24 @@ void NotesStore::resolveConflict(const QString &noteGuid, NotesStore::ConflictRe
     } else {
         qCDebug(dcNotesStore) << "Resolving conflict using remote note for note guid:" << noteGuid;
         Note *newNote = note->conflictingNote();
-        newNote->setParent(this);
         // Conflicting notes have their guid prefixed, lets correct that
         newNote->setGuid(note->guid());
         newNote->setConflicting(false);
-        int idx = m_notes.indexOf(note);
-        m_notesHash[note->guid()] = newNote;
-        m_notes.replace(idx, newNote);
-        emit noteChanged(newNote->guid(), newNote->notebookGuid());
+        int idx = indexOf(note);
+        NoteDataPointer newData = newNote->m_data;
+        // Take over the old data's place in the reverse indices
+        newData->indexedNotebookGuid = note->m_data->indexedNotebookGuid;
+        newData->indexedTagGuids = note->m_data->indexedTagGuids;
+        m_notesHash[note->guid()] = newData;
+        m_notes.replace(idx, newData);
+        // Keep the Note object everyone is holding, but let it show the server version
+        note->setData(newData);
+        if (m_scriptNoteViews.contains(note)) {
+            m_scriptNoteViews.insert(note, newData);
+        }
+        note->setConflictingNote(nullptr);
+        indexNote(newData.data());
+        emit noteChanged(note->guid(), note->notebookGuid());
         emit dataChanged(index(idx), index(idx));
         saveNote(note->guid());
     }
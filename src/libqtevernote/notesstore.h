@@ -22,7 +22,9 @@
 #define NOTESSTORE_H
 
 #include "evernoteconnection.h"
+#include "notedata.h"
 #include "utils/enmldocument.h"
+#include "utils/pagesizer.h"
 #include "jobs/fetchnotejob.h"
 
 // Thrift
@@ -39,12 +41,16 @@
 
 #include <QAbstractListModel>
 #include <QHash>
-#include <QSettings>
+#include <QSet>
+#include <QTimer>
 
 class Notebook;
 class Note;
 class Tag;
 class OrganizerAdapter;
+class CacheWriter;
+class OperationJournal;
+class ResourceCache;
 
 using namespace apache::thrift::transport;
 
@@ -61,6 +67,9 @@ class NotesStore : public QAbstractListModel
     Q_PROPERTY(bool notebooksLoading READ notebooksLoading NOTIFY notebooksLoadingChanged)
     Q_PROPERTY(QString error READ error NOTIFY errorChanged)
     Q_PROPERTY(int count READ count NOTIFY countChanged)
+    // Disk space in MB attachments and their scaled copies may use. Attachments of notes which
+    // haven't been uploaded yet are always kept, even if that means going over budget.
+    Q_PROPERTY(int resourceCacheBudget READ resourceCacheBudget WRITE setResourceCacheBudget NOTIFY resourceCacheBudgetChanged)
 
 public:
     enum Role {
@@ -113,15 +122,26 @@ public:
 
     int count() const;
 
+    int resourceCacheBudget() const;
+    void setResourceCacheBudget(int budget);
+
     // reimplemented from QAbstractListModel
     int rowCount(const QModelIndex &parent = QModelIndex()) const;
     QVariant data(const QModelIndex &index, int role) const;
     QHash<int, QByteArray> roleNames() const;
 
-    QList<Note*> notes() const;
-    Q_INVOKABLE Note* note(int index) const;
-
+    // Notes are kept as NoteData records. A Note object is created when asked for one. Objects
+    // returned from here are owned by the QML engine, which deletes them once nothing refers to them.
+    Q_INVOKABLE Note* note(int index);
     Q_INVOKABLE Note* note(const QString &guid);
+    // For C++ callers. The object stays with the NotesStore and gets released once it has been idle
+    // for a while, so don't hold on to it.
+    Note *noteView(const QString &guid);
+
+    // Read-only access to the records. Use those when looking at lots of notes.
+    const NoteData *noteData(int index) const;
+    const NoteData *noteData(const QString &guid) const;
+
     Q_INVOKABLE Note* createNote(const QString &title, const QString &notebookGuid = QString(), const QString &richTextContent = QString());
     Note *createNote(const QString &title, const QString &notebookGuid, const EnmlDocument &content);
     Q_INVOKABLE void saveNote(const QString &guid);
@@ -136,6 +156,8 @@ public:
     Q_INVOKABLE void saveNotebook(const QString &guid);
     Q_INVOKABLE void setDefaultNotebook(const QString &guid);
     Q_INVOKABLE void expungeNotebook(const QString &guid);
+    // Guids of the notes in the given notebook, from the store's reverse index
+    QStringList notesInNotebook(const QString &notebookGuid) const;
 
     QList<Tag*> tags() const;
     Q_INVOKABLE Tag* tag(const QString &guid);
@@ -144,10 +166,17 @@ public:
     Q_INVOKABLE void tagNote(const QString &noteGuid, const QString &tagGuid);
     Q_INVOKABLE void untagNote(const QString &noteGuid, const QString &tagGuid);
     Q_INVOKABLE void expungeTag(const QString &guid);
+    // Guids of the notes tagged with the given tag, from the store's reverse index
+    QStringList notesWithTag(const QString &tagGuid) const;
 
     Q_INVOKABLE void resolveConflict(const QString &noteGuid, ConflictResolveMode mode);
 
 public slots:
+    // Fetches what changed on the server since the last sync and pushes local changes.
+    // The first sync, and any sync the server asks to start over, lists everything instead.
+    void synchronize();
+
+    // Without a notebook filter those are the same as synchronize()
     void refreshNotes(const QString &filterNotebookGuid = QString(), int startIndex = 0);
 
     // Defaulting to High priority to provide fast feedback to the ui. Use low priority if you call this to prefetch things in the background
@@ -157,6 +186,9 @@ public slots:
 
     void clearError();
 
+    // Blocks until all pending changes are written to disk
+    void flushCache();
+
 signals:
     void usernameChanged();
     void loadingChanged();
@@ -164,6 +196,7 @@ signals:
     void tagsLoadingChanged();
     void errorChanged();
     void countChanged();
+    void resourceCacheBudgetChanged();
 
     void noteCreated(const QString &guid, const QString &notebookGuid);
     void noteUpdated(const QString &guid, const QString &notebookGuid);
@@ -185,11 +218,18 @@ signals:
 
     void noteConflicting(const QString &guid);
 
+    // While downloading the data of a resource. bytesTotal is 0 if unknown.
+    void resourceFetchProgress(const QString &noteGuid, const QString &hash, qint64 bytesReceived, qint64 bytesTotal);
+
 private slots:
+    void fetchSyncStateJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const evernote::edam::SyncState &result);
+    void fetchSyncChunkJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const evernote::edam::SyncChunk &result);
     void fetchNotesJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const evernote::edam::NotesMetadataList &results, const QString &filterNotebookGuid);
+    void findNotesJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const evernote::edam::NotesMetadataList &results);
     void fetchNotebooksJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const std::vector<evernote::edam::Notebook> &results);
     void fetchNoteJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const evernote::edam::Note &result, FetchNoteJob::LoadWhatFlags what);
     void fetchConflictingNoteJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const evernote::edam::Note &result, FetchNoteJob::LoadWhatFlags what);
+    void fetchResourceJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const QString &noteGuid, const QString &hash);
     void createNoteJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const QString &tmpGuid, const evernote::edam::Note &result);
     void saveNoteJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const evernote::edam::Note &result);
     void saveNotebookJobDone(EvernoteConnection::ErrorCode errorCode, const QString &errorMessage, const evernote::edam::Notebook &result);
@@ -211,13 +251,79 @@ private slots:
     void emitDataChanged();
     void clear();
 
+    void sweepNoteViews();
+    void noteViewDestroyed(QObject *object);
+    void updateNoteViewPin();
+    void collectResources();
+    void resourcesCollected(const QStringList &evictedHashes);
+    void emitNoteCountChanges();
+    void noteLoadingChanged();
+
 private:
+    // Listing everything, for the full sync
+    void fetchNotes(const QString &filterNotebookGuid = QString(), int startIndex = 0);
+    // Keeps up to s_notesPagesAhead pages of the notes listing in flight
+    void fetchNotesPages(const QString &filterNotebookGuid);
+    void fetchNotesPage(const QString &filterNotebookGuid, int startIndex, int chunkSize);
+    void fetchNotebooks();
+    void fetchTags();
+    void fullSyncListingDone(bool success);
+    // Creates, removes or marks conflicting the notes the finished listing didn't come across.
+    // Only creates if the listing may have skipped notes.
+    void reconcileUnhandledNotes();
+
+    // Pushes local changes to anything the incremental sync didn't come across
+    void pushLocalChanges();
+    void finishSync();
+
+    // Reconciling a server object with the local copy, shared by the full and the incremental sync
+    // contentHash is the server's hash of the content, if known. A matching cached content isn't fetched again.
+    void mergeRemoteNote(const evernote::edam::NoteMetadata &result, const QByteArray &contentHash, bool searchResult);
+    void mergeRemoteNotebook(const evernote::edam::Notebook &result);
+    void mergeRemoteTag(const evernote::edam::Tag &result);
+    void pushNote(Note *note);
+    void pushNotebook(Notebook *notebook);
+    void pushTag(Tag *tag);
+    void createRemoteNote(Note *note);
+    void createRemoteNotebook(Notebook *notebook);
+    void createRemoteTag(Tag *tag);
+    void remoteNoteGone(Note *note);
+    void remoteNotebookGone(Notebook *notebook);
+    void remoteTagGone(Tag *tag);
+
+    // Queues a FetchResourceJob for each of the given resources of note
+    void fetchResources(Note *note, const QList<ResourceRecord> &resources, EvernoteJob::JobPriority priority);
+
     QVector<int>    updateFromEDAM(const evernote::edam::NoteMetadata &evNote, Note *note);
     void updateFromEDAM(const evernote::edam::Notebook &evNotebook, Notebook *notebook);
 
     bool handleUserError(EvernoteConnection::ErrorCode errorCode);
 
     void removeNote(const QString &guid);
+    void removeNotes(const QSet<NoteData*> &notes);
+
+    Note *noteView(NoteData *data);
+    // Hands the object over to the QML engine
+    Note *exposeNoteView(Note *note);
+    void releaseNoteView(Note *note);
+    void forgetNoteView(Note *note, NoteData *data);
+    int indexOf(Note *note) const;
+
+    // Objects created locally get a new guid once created on the server. Update the notes referring to them.
+    void updateNoteReferences(const QString &oldGuid, const QString &newGuid);
+
+    // Keep the notebook and tag reverse indices in line with a note's notebookGuid and tagGuids.
+    // Must be called whenever a note is added, removed, renamed or moved.
+    void indexNote(NoteData *data);
+    void unindexNote(NoteData *data);
+    void renameIndexedNote(NoteData *data, const QString &oldGuid);
+
+    // Book-keeping for the operation journal. pushStarted() records which journal entries
+    // the job just enqueued for guid covers, pushFinished() acknowledges them once it succeeded.
+    void pushStarted(const QString &guid);
+    void pushFinished(const QString &guid, bool success);
+    void pushRenamed(const QString &oldGuid, const QString &newGuid);
+    void replayJournal();
 
 private:
     explicit NotesStore(QObject *parent = 0);
@@ -231,20 +337,70 @@ private:
 
     QStringList m_errorQueue;
 
-    QList<Note*> m_notes;
+    QList<NoteDataPointer> m_notes;
     QList<Notebook*> m_notebooks;
     QList<Tag*> m_tags;
 
     // Keep hashes for faster lookups as we always identify things via guid
-    QHash<QString, Note*> m_notesHash;
+    QHash<QString, NoteDataPointer> m_notesHash;
     QHash<QString, Notebook*> m_notebooksHash;
     QHash<QString, Tag*> m_tagsHash;
 
-    QStringList m_unhandledNotes;
+    // Reverse indices: notebook guid -> note guids, tag guid -> note guids
+    QHash<QString, QStringList> m_notebookNotes;
+    QHash<QString, QStringList> m_tagNotes;
+    // Notebooks and tags whose noteCount changed. Notified once control returns to the event loop,
+    // so a batch of changes results in one notification per notebook and tag.
+    QSet<QString> m_noteCountChangedNotebooks;
+    QSet<QString> m_noteCountChangedTags;
+    QTimer m_noteCountChangedTimer;
+
+    // Guids of the notes in the scope of the running listing which the server didn't list so far
+    QSet<QString> m_unhandledNotes;
+
+    // Paging through the notes listing. The offset of the next page to request, the number of
+    // notes on the server (as of the last page) and the pages requested but not processed.
+    int m_notesListingOffset;
+    int m_notesListingTotal;
+    int m_notesListingPending;
+    bool m_notesListingFailed;
+    // The number of notes reported by the first page, -1 before it arrived. Notes were added
+    // or removed on the server while paging if a later page reports another number. Pages are
+    // requested by offset, so some notes may have moved to a page already fetched.
+    int m_notesListingFirstTotal;
+    bool m_notesListingShifted;
+    PageSizer m_notesPageSizer;
+
+    // All changes up to m_syncState.updateCount are merged. Persisted in the snapshot.
+    SyncStateRecord m_syncState;
+    // A full sync started at m_fullSyncTarget and is waiting for this many listings
+    SyncStateRecord m_fullSyncTarget;
+    int m_fullSyncListings;
 
     OrganizerAdapter *m_organizerAdapter;
 
+    // Note objects currently alive, and those which weren't used since the last sweep
+    QSet<Note*> m_noteViews;
+    QSet<Note*> m_idleNoteViews;
+    // Note objects owned by the QML engine, with the data they show
+    QHash<Note*, NoteDataPointer> m_scriptNoteViews;
+    QTimer m_noteViewSweepTimer;
+
     QString m_cacheFile;
+    CacheWriter *m_cacheWriter;
+
+    ResourceCache *m_resourceCache;
+    QTimer m_resourceCollectTimer;
+    // Hashes of the resources being downloaded, per note guid
+    QHash<QString, QSet<QString> > m_resourceFetches;
+
+    // Notes the server trashed or expunged while a job was busy with them. The sync state moves
+    // past those changes, so they are applied once the note isn't loading any more.
+    QSet<QString> m_deferredRemoteNotesGone;
+
+    OperationJournal *m_journal;
+    // Journal sequence covered by each push in flight, per guid, in the order they were enqueued
+    QHash<QString, QList<quint64> > m_pushedSequences;
 };
 
 #endif // NOTESSTORE_H
@@ -0,0 +1,132 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "notesstoreconnection.h"
+#include "jobs/evernotejob.h"
+#include "logging.h"
+
+#include <boost/bind.hpp>
+
+// Thrift
+#include <arpa/inet.h> // seems thrift forgot this one
+#include <protocol/TBinaryProtocol.h>
+#include <Thrift.h>
+
+// Evernote SDK
+#include <NoteStore.h>
+
+using namespace apache::thrift;
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::transport;
+
+NotesStoreConnection::NotesStoreConnection(const QString &hostname, const QString &notesStorePath,
+                                           const boost::shared_ptr<TSSLSocketFactory> &sslSocketFactory):
+    m_hostname(hostname),
+    m_notesStorePath(notesStorePath),
+    m_sslSocketFactory(sslSocketFactory),
+    m_client(0),
+    m_job(0)
+{
+    setup();
+}
+
+NotesStoreConnection::~NotesStoreConnection()
+{
+    try {
+        close();
+    } catch (...) {}
+    delete m_client;
+}
+
+evernote::edam::NoteStoreClient *NotesStoreConnection::client()
+{
+    if (!m_httpClient->isOpen()) {
+        open();
+    }
+    return m_client;
+}
+
+void NotesStoreConnection::open()
+{
+    if (m_httpClient->isOpen()) {
+        m_httpClient->close();
+    }
+    m_httpClient->open();
+    qCDebug(dcConnection) << "NotesStoreClient socket opened." << m_httpClient->isOpen();
+}
+
+void NotesStoreConnection::close()
+{
+    m_httpClient->close();
+}
+
+bool NotesStoreConnection::isOpen() const
+{
+    return m_httpClient->isOpen();
+}
+
+void NotesStoreConnection::reset()
+{
+    try {
+        close();
+    } catch (...) {}
+    delete m_client;
+    m_httpClient.reset();
+    setup();
+    open();
+}
+
+EvernoteJob *NotesStoreConnection::job() const
+{
+    return m_job;
+}
+
+void NotesStoreConnection::setJob(EvernoteJob *job)
+{
+    m_job = job;
+}
+
+bool NotesStoreConnection::isInterrupted() const
+{
+    return m_job && m_job->isCancelled();
+}
+
+void NotesStoreConnection::setup()
+{
+    boost::shared_ptr<TSocket> socket;
+
+    if (m_sslSocketFactory) {
+        // A shared factory, so a new socket can resume the TLS session of an earlier one
+        socket = m_sslSocketFactory->createSocket(m_hostname.toStdString(), 443);
+        qCDebug(dcConnection) << "created NotesStore SSL socket to host " << m_hostname;
+    } else {
+        // Create a non-secure socket
+        socket = boost::shared_ptr<TSocket> (new TSocket(m_hostname.toStdString(), 80));
+        qCDebug(dcConnection) << "created insecure NotesStore socket to host " << m_hostname;
+    }
+
+    // setup NotesStore client
+    boost::shared_ptr<TBufferedTransport> bufferedTransport(new TBufferedTransport(socket));
+    m_httpClient = boost::shared_ptr<THttpClient>(new THttpClient(bufferedTransport,
+                                                                  m_hostname.toStdString(),
+                                                                  m_notesStorePath.toStdString()));
+    m_httpClient->setInterruptCheck(boost::bind(&NotesStoreConnection::isInterrupted, this));
+
+    boost::shared_ptr<TProtocol> notesstoreiprot(new TBinaryProtocol(m_httpClient));
+    m_client = new evernote::edam::NoteStoreClient(notesstoreiprot);
+}
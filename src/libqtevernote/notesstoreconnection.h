@@ -0,0 +1,77 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NOTESSTORECONNECTION_H
+#define NOTESSTORECONNECTION_H
+
+#include <boost/shared_ptr.hpp>
+
+// Thrift
+#include <transport/THttpClient.h>
+#include <transport/TSSLSocket.h>
+
+#include <QString>
+
+namespace evernote {
+namespace edam {
+class NoteStoreClient;
+}
+}
+
+class EvernoteJob;
+
+// One connection to the NoteStore. The EvernoteConnection keeps a few of those so independent
+// requests can run in parallel. A connection is only ever used by one job at a time, from the
+// job's thread. Which job that is, is tracked from the main thread.
+class NotesStoreConnection
+{
+public:
+    // Without an SSL socket factory, the connection is unencrypted
+    NotesStoreConnection(const QString &hostname, const QString &notesStorePath,
+                         const boost::shared_ptr<apache::thrift::transport::TSSLSocketFactory> &sslSocketFactory);
+    ~NotesStoreConnection();
+
+    // Opens the connection if it isn't yet. Throws thrift's exceptions if that fails.
+    evernote::edam::NoteStoreClient *client();
+
+    void open();
+    void close();
+    bool isOpen() const;
+
+    // Drops the socket and starts over with a new one, e.g. after a transport error
+    void reset();
+
+    EvernoteJob *job() const;
+    void setJob(EvernoteJob *job);
+
+private:
+    void setup();
+    // Polled by the transport while reading a response. Aborts it once the job is cancelled.
+    bool isInterrupted() const;
+
+    QString m_hostname;
+    QString m_notesStorePath;
+    boost::shared_ptr<apache::thrift::transport::TSSLSocketFactory> m_sslSocketFactory;
+
+    evernote::edam::NoteStoreClient *m_client;
+    boost::shared_ptr<apache::thrift::transport::THttpClient> m_httpClient;
+
+    EvernoteJob *m_job;
+};
+
+#endif // NOTESSTORECONNECTION_H
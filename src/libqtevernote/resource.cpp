@@ -21,8 +21,10 @@
 #include "resource.h"
 #include "notesstore.h"
 #include "logging.h"
+#include "utils/resourcecache.h"
 
 #include <QFile>
+#include <QSaveFile>
 #include <QStandardPaths>
 #include <QCryptographicHash>
 #include <QFileInfo>
@@ -38,7 +40,7 @@ Resource::Resource(const QByteArray &data, const QString &hash, const QString &f
         // TRANSLATORS: A default file name if we don't get one from the server. Avoid weird characters.
         m_fileName = tr("Unnamed") + "." + m_type.split("/").last();
     }
-    m_filePath = NotesStore::instance()->storageLocation() + hash + "." + m_fileName.split('.').last();
+    m_filePath = cachePath(hash, m_fileName);
 
     QFile file(m_filePath);
     if (!data.isEmpty() && !file.exists()) {
@@ -49,6 +51,9 @@ Resource::Resource(const QByteArray &data, const QString &hash, const QString &f
         }
         file.write(data);
         file.close();
+    } else if (file.exists()) {
+        // Might be an orphan from a deleted note. Make sure the cache cleanup doesn't take it away.
+        ResourceCache::touch(m_filePath);
     }
 }
 
@@ -88,7 +93,7 @@ Resource::Resource(const QString &path, QObject *parent):
         qCWarning(dcNotesStore) << "cannot determine mime type of file" << m_fileName;
     }
 
-    m_filePath = NotesStore::instance()->storageLocation() + m_hash + "." + m_fileName.split('.').last();
+    m_filePath = cachePath(m_hash, m_fileName);
 
     QFile copy(m_filePath);
     if (!copy.exists()) {
@@ -99,9 +104,16 @@ Resource::Resource(const QString &path, QObject *parent):
         }
         copy.write(fileContent);
         copy.close();
+    } else {
+        ResourceCache::touch(m_filePath);
     }
 }
 
+QString Resource::cachePath(const QString &hash, const QString &fileName)
+{
+    return NotesStore::instance()->storageLocation() + hash + "." + fileName.split('.').last();
+}
+
 QString Resource::hash() const
 {
     return m_hash;
@@ -119,10 +131,38 @@ QString Resource::hashedFilePath() const
 
 QByteArray Resource::imageData(const QSize &size)
 {
-    if (!m_type.startsWith("image/")) {
+    QString filePath = imageFilePath(size);
+    if (filePath.isEmpty()) {
         return QByteArray();
     }
 
+    QFile file(filePath);
+    if (file.open(QFile::ReadOnly)) {
+        ResourceCache::touch(filePath);
+        return file.readAll();
+    }
+    return QByteArray();
+}
+
+MappedFile Resource::mappedImageData(const QSize &size)
+{
+    QString filePath = imageFilePath(size);
+    if (filePath.isEmpty()) {
+        return MappedFile();
+    }
+    if (filePath == m_filePath) {
+        return mappedData();
+    }
+    ResourceCache::touch(filePath);
+    return MappedFile(filePath);
+}
+
+QString Resource::imageFilePath(const QSize &size)
+{
+    if (!m_type.startsWith("image/")) {
+        return QString();
+    }
+
     QString finalFilePath = m_filePath;
     if (size.isValid() && !size.isNull()) {
         finalFilePath = m_filePath + "_" + QString::number(size.width()) + "x" + QString::number(size.height()) + ".jpg";
@@ -139,12 +179,7 @@ QByteArray Resource::imageData(const QSize &size)
             image.save(finalFilePath);
         }
     }
-
-    QFile file(finalFilePath);
-    if (file.open(QFile::ReadOnly)) {
-        return file.readAll();
-    }
-    return QByteArray();
+    return finalFilePath;
 }
 
 QString Resource::fileName() const
@@ -156,16 +191,28 @@ QByteArray Resource::data() const
 {
     QFile file(m_filePath);
     if (file.open(QFile::ReadOnly)) {
+        ResourceCache::touch(m_filePath);
         return file.readAll();
     }
     return QByteArray();
 }
 
+MappedFile Resource::mappedData() const
+{
+    // Keep the mapping around, so all users share it
+    if (!m_mappedData.isValid()) {
+        m_mappedData = MappedFile(m_filePath);
+    }
+    ResourceCache::touch(m_filePath);
+    return m_mappedData;
+}
+
 void Resource::setData(const QByteArray &data)
 {
-    QFile file(m_filePath);
-    if (file.open(QFile::WriteOnly | QFile::Truncate)) {
-        file.write(data);
+    // Replace the file instead of writing into it. Existing mappings keep seeing the old content.
+    QSaveFile file(m_filePath);
+    if (file.open(QFile::WriteOnly) && file.write(data) == data.length() && file.commit()) {
+        m_mappedData = MappedFile();
     } else {
         qCDebug(dcNotesStore) << "Error saving data for resource:" << m_hash;
     }
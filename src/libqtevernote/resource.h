@@ -21,6 +21,8 @@
 #ifndef RESOURCE_H
 #define RESOURCE_H
 
+#include "utils/mappedfile.h"
+
 #include <QObject>
 #include <QString>
 #include <QImage>
@@ -43,18 +45,28 @@ public:
 
     QByteArray data() const;
     void setData(const QByteArray &data);
+    // Like data(), but without copying the file to the heap
+    MappedFile mappedData() const;
     QString hash() const;
     QString fileName() const;
     QString type() const;
     QString hashedFilePath() const;
 
     QByteArray imageData(const QSize &size = QSize());
+    MappedFile mappedImageData(const QSize &size = QSize());
+
+    // The file the data of the resource with the given hash and file name is cached in
+    static QString cachePath(const QString &hash, const QString &fileName);
 
 private:
+    // Returns the file holding the image in the given size, creating it if needed
+    QString imageFilePath(const QSize &size);
+
     QString m_hash;
     QString m_fileName;
     QString m_filePath;
     QString m_type;
+    mutable MappedFile m_mappedData;
 };
 
 #endif
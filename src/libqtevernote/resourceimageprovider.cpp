@@ -21,7 +21,7 @@ QImage ResourceImageProvider::requestImage(const QString &id, QSize *size, const
     QString noteGuid = arguments.queryItemValue("noteGuid");
     QString resourceHash = arguments.queryItemValue("hash");
     bool isLoaded = arguments.queryItemValue("loaded") == "true";
-    Note *note = NotesStore::instance()->note(noteGuid);
+    Note *note = NotesStore::instance()->noteView(noteGuid);
     if (!note) {
         qCWarning(dcNotesStore) << "Unable to find note for resource:" << id;
         return QImage();
@@ -34,7 +34,8 @@ QImage ResourceImageProvider::requestImage(const QString &id, QSize *size, const
             if (!requestedSize.isValid() || requestedSize.width() > 1024 || requestedSize.height() > 1024) {
                 tmpSize = QSize(1024, 1024);
             }
-            image = QImage::fromData(NotesStore::instance()->note(noteGuid)->resource(resourceHash)->imageData(tmpSize));
+            MappedFile imageData = NotesStore::instance()->noteView(noteGuid)->resource(resourceHash)->mappedImageData(tmpSize);
+            image = QImage::fromData(reinterpret_cast<const uchar*>(imageData.data()), imageData.size());
         } else {
             image = loadIcon("image-x-generic-symbolic", requestedSize);
         }
@@ -28,27 +28,22 @@
 Tag::Tag(const QString &guid, quint32 updateSequenceNumber, QObject *parent) :
     QObject(parent),
     m_updateSequenceNumber(updateSequenceNumber),
+    m_lastSyncedSequenceNumber(0),
     m_guid(guid),
     m_deleted(false),
     m_loading(false),
     m_syncError(false)
 {
-    setGuid(guid);
-    QSettings infoFile(m_infoFile, QSettings::IniFormat);
-    m_name = infoFile.value("name").toString();
-    m_deleted = infoFile.value("deleted").toBool();
-    m_lastSyncedSequenceNumber = infoFile.value("lastSyncedSequenceNumber", 0).toUInt();
     m_synced = m_lastSyncedSequenceNumber == m_updateSequenceNumber;
+}
 
-    foreach (Note *note, NotesStore::instance()->notes()) {
-        if (note->tagGuids().contains(m_guid)) {
-            m_notesList.append(note->guid());
-        }
-    }
-    connect(NotesStore::instance(), &NotesStore::noteAdded, this, &Tag::noteAdded);
-    connect(NotesStore::instance(), &NotesStore::noteRemoved, this, &Tag::noteRemoved);
-    connect(NotesStore::instance(), &NotesStore::noteChanged, this, &Tag::noteChanged);
-    connect(NotesStore::instance(), &NotesStore::noteGuidChanged, this, &Tag::noteGuidChanged);
+Tag::Tag(const TagRecord &record, QObject *parent) :
+    Tag(record.guid, record.updateSequenceNumber, parent)
+{
+    m_name = record.name;
+    m_deleted = record.deleted;
+    m_lastSyncedSequenceNumber = record.lastSyncedSequenceNumber;
+    m_synced = m_lastSyncedSequenceNumber == m_updateSequenceNumber;
 }
 
 Tag::~Tag()
@@ -62,23 +57,21 @@ QString Tag::guid() const
 
 void Tag::setGuid(const QString &guid)
 {
-    bool syncToFile = false;
-    if (!m_infoFile.isEmpty()) {
-        QFile ifile(m_infoFile);
-        ifile.remove();
-
-        syncToFile = true;
-    }
-
     m_guid = guid;
-    m_infoFile = NotesStore::instance()->storageLocation() + "tag-" + guid + ".info";
-
-    if (syncToFile) {
-        syncToInfoFile();
-    }
     emit guidChanged();
 }
 
+TagRecord Tag::record() const
+{
+    TagRecord record;
+    record.guid = m_guid;
+    record.updateSequenceNumber = m_updateSequenceNumber;
+    record.lastSyncedSequenceNumber = m_lastSyncedSequenceNumber;
+    record.name = m_name;
+    record.deleted = m_deleted;
+    return record;
+}
+
 qint32 Tag::updateSequenceNumber() const
 {
     return m_updateSequenceNumber;
@@ -124,7 +117,7 @@ void Tag::setName(const QString &name)
 
 int Tag::noteCount() const
 {
-    return m_notesList.count();
+    return NotesStore::instance()->notesWithTag(m_guid).count();
 }
 
 Tag *Tag::clone()
@@ -135,64 +128,6 @@ Tag *Tag::clone()
     return tag;
 }
 
-void Tag::noteAdded(const QString &noteGuid, const QString &notebookGuid)
-{
-    Q_UNUSED(notebookGuid)
-    if (NotesStore::instance()->note(noteGuid)->tagGuids().contains(m_guid)) {
-        m_notesList.append(noteGuid);
-        emit noteCountChanged();
-    }
-}
-
-void Tag::noteRemoved(const QString &noteGuid, const QString &notebookGuid)
-{
-    Q_UNUSED(notebookGuid)
-    if (m_notesList.contains(noteGuid)) {
-        m_notesList.removeAll(noteGuid);
-        emit noteCountChanged();
-    }
-}
-
-void Tag::noteChanged(const QString &noteGuid, const QString &notebookGuid)
-{
-    Q_UNUSED(notebookGuid)
-    if (NotesStore::instance()->note(noteGuid)->tagGuids().contains(m_guid)) {
-        if (!m_notesList.contains(noteGuid)) {
-            m_notesList.append(noteGuid);
-            emit noteCountChanged();
-        }
-    } else {
-        if (m_notesList.contains(noteGuid)) {
-            m_notesList.removeAll(noteGuid);
-            emit noteCountChanged();
-        }
-    }
-}
-
-void Tag::noteGuidChanged(const QString &oldGuid, const QString &newGuid)
-{
-    int oldIndex = m_notesList.indexOf(oldGuid);
-    if (oldIndex != -1) {
-        m_notesList.replace(oldIndex, newGuid);
-    }
-}
-
-void Tag::syncToInfoFile()
-{
-    QSettings infoFile(m_infoFile, QSettings::IniFormat);
-    infoFile.setValue("name", m_name);
-    infoFile.setValue("deleted", m_deleted);
-    infoFile.setValue("lastSyncedSequenceNumber", m_lastSyncedSequenceNumber);
-}
-
-void Tag::deleteInfoFile()
-{
-    QFile f(m_infoFile);
-    if (f.exists()) {
-        f.remove();
-    }
-}
-
 bool Tag::loading() const
 {
     return m_loading;
@@ -240,5 +175,5 @@ void Tag::setDeleted(bool deleted)
 
 QString Tag::noteAt(int index) const
 {
-    return m_notesList.at(index);
+    return NotesStore::instance()->notesWithTag(m_guid).at(index);
 }
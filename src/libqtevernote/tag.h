@@ -22,13 +22,13 @@
 #define TAG_H
 
 #include "utils/enmldocument.h"
+#include "utils/cachesnapshot.h"
 #include "resource.h"
 
 #include <QObject>
 #include <QDateTime>
 #include <QStringList>
 #include <QImage>
-#include <QSettings>
 
 class Tag: public QObject
 {
@@ -47,8 +47,12 @@ class Tag: public QObject
 
 public:
     explicit Tag(const QString &guid, quint32 updateSequenceNumber, QObject *parent = 0);
+    explicit Tag(const TagRecord &record, QObject *parent = 0);
     ~Tag();
 
+    // Returns the persistent part of this tag, as written to the snapshot file
+    TagRecord record() const;
+
     QString guid() const;
     void setGuid(const QString &guid);
 
@@ -79,15 +83,7 @@ signals:
     void syncErrorChanged();
     void deletedChanged();
 
-private slots:
-    void noteAdded(const QString &noteGuid, const QString &notebookGuid);
-    void noteRemoved(const QString &noteGuid, const QString &notebookGuid);
-    void noteChanged(const QString &noteGuid, const QString &notebookGuid);
-    void noteGuidChanged(const QString &oldGuid, const QString &newGuid);
-
 private:
-    void syncToInfoFile();
-    void deleteInfoFile();
     void setLastSyncedSequenceNumber(qint32 lastSyncedSequenceNumber);
     void setLoading(bool loading);
     void setSyncError(bool syncError);
@@ -100,10 +96,6 @@ private:
     QString m_name;
     bool m_deleted;
 
-    QList<QString> m_notesList;
-
-    QString m_infoFile;
-
     bool m_loading;
     bool m_synced;
     bool m_syncError;
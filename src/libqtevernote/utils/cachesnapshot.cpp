@@ -0,0 +1,365 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cachesnapshot.h"
+#include "logging.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QSettings>
+#include <QByteArray>
+
+#include <limits>
+
+// "NSNP"
+const quint32 CacheSnapshot::s_magic = 0x4E534E50;
+const quint32 CacheSnapshot::s_version = 4;
+
+// The version of the snapshot file being loaded, for the records which changed between
+// versions. Outside of load(), everything is in the current format.
+static thread_local quint32 s_loadingVersion = std::numeric_limits<quint32>::max();
+
+ResourceRecord::ResourceRecord():
+    size(0)
+{
+}
+
+NoteRecord::NoteRecord():
+    updateSequenceNumber(0),
+    lastSyncedSequenceNumber(0),
+    reminderOrder(0),
+    deleted(false),
+    needsContentSync(false),
+    contentLength(0)
+{
+}
+
+NotebookRecord::NotebookRecord():
+    updateSequenceNumber(0),
+    lastSyncedSequenceNumber(0),
+    published(false),
+    isDefaultNotebook(false),
+    deleted(false)
+{
+}
+
+TagRecord::TagRecord():
+    updateSequenceNumber(0),
+    lastSyncedSequenceNumber(0),
+    deleted(false)
+{
+}
+
+SyncStateRecord::SyncStateRecord():
+    updateCount(0)
+{
+}
+
+QDataStream &operator<<(QDataStream &stream, const ResourceRecord &record)
+{
+    stream << record.hash << record.fileName << record.type << record.guid << record.size;
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, ResourceRecord &record)
+{
+    stream >> record.hash >> record.fileName >> record.type;
+    if (s_loadingVersion >= 3) {
+        stream >> record.guid >> record.size;
+    }
+    return stream;
+}
+
+QDataStream &operator<<(QDataStream &stream, const NoteRecord &record)
+{
+    stream << record.guid
+           << record.updateSequenceNumber
+           << record.lastSyncedSequenceNumber
+           << record.notebookGuid
+           << record.created
+           << record.updated
+           << record.title
+           << record.tagGuids
+           << record.reminderOrder
+           << record.reminderTime
+           << record.reminderDoneTime
+           << record.deleted
+           << record.needsContentSync
+           << record.tagline
+           << record.resources
+           << record.contentHash
+           << record.contentLength;
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, NoteRecord &record)
+{
+    stream >> record.guid
+           >> record.updateSequenceNumber
+           >> record.lastSyncedSequenceNumber
+           >> record.notebookGuid
+           >> record.created
+           >> record.updated
+           >> record.title
+           >> record.tagGuids
+           >> record.reminderOrder
+           >> record.reminderTime
+           >> record.reminderDoneTime
+           >> record.deleted
+           >> record.needsContentSync
+           >> record.tagline
+           >> record.resources;
+    if (s_loadingVersion >= 4) {
+        stream >> record.contentHash >> record.contentLength;
+    }
+    return stream;
+}
+
+QDataStream &operator<<(QDataStream &stream, const NotebookRecord &record)
+{
+    stream << record.guid
+           << record.updateSequenceNumber
+           << record.lastSyncedSequenceNumber
+           << record.name
+           << record.published
+           << record.lastUpdated
+           << record.isDefaultNotebook
+           << record.deleted;
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, NotebookRecord &record)
+{
+    stream >> record.guid
+           >> record.updateSequenceNumber
+           >> record.lastSyncedSequenceNumber
+           >> record.name
+           >> record.published
+           >> record.lastUpdated
+           >> record.isDefaultNotebook
+           >> record.deleted;
+    return stream;
+}
+
+QDataStream &operator<<(QDataStream &stream, const TagRecord &record)
+{
+    stream << record.guid
+           << record.updateSequenceNumber
+           << record.lastSyncedSequenceNumber
+           << record.name
+           << record.deleted;
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, TagRecord &record)
+{
+    stream >> record.guid
+           >> record.updateSequenceNumber
+           >> record.lastSyncedSequenceNumber
+           >> record.name
+           >> record.deleted;
+    return stream;
+}
+
+QDataStream &operator<<(QDataStream &stream, const SyncStateRecord &record)
+{
+    stream << record.updateCount
+           << record.lastSyncTime;
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, SyncStateRecord &record)
+{
+    stream >> record.updateCount
+           >> record.lastSyncTime;
+    return stream;
+}
+
+CacheSnapshot::CacheSnapshot()
+{
+}
+
+bool CacheSnapshot::load(const QString &fileName)
+{
+    clear();
+
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) {
+        return false;
+    }
+
+    // Map the whole file and deserialize it in one sequential pass
+    qint64 size = file.size();
+    uchar *mapped = file.map(0, size);
+    QByteArray buffer;
+    if (mapped) {
+        buffer = QByteArray::fromRawData(reinterpret_cast<const char*>(mapped), size);
+    } else {
+        buffer = file.readAll();
+    }
+
+    QDataStream stream(buffer);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic;
+    quint32 version;
+    stream >> magic >> version;
+    if (magic != s_magic) {
+        qCWarning(dcStorage) << "Snapshot file has invalid magic:" << fileName;
+        return false;
+    }
+    if (version < 1 || version > s_version) {
+        qCWarning(dcStorage) << "Unsupported snapshot version" << version << "in" << fileName;
+        return false;
+    }
+
+    s_loadingVersion = version;
+    stream >> notebooks >> tags >> notes;
+    if (version >= 2) {
+        stream >> syncState;
+    }
+    s_loadingVersion = std::numeric_limits<quint32>::max();
+
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(dcStorage) << "Snapshot file is truncated or corrupt:" << fileName;
+        clear();
+        return false;
+    }
+    return true;
+}
+
+bool CacheSnapshot::save(const QString &fileName) const
+{
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly)) {
+        qCWarning(dcStorage) << "Cannot open snapshot file for writing:" << fileName;
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << s_magic << s_version;
+    stream << notebooks << tags << notes << syncState;
+
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(dcStorage) << "Error writing snapshot file:" << fileName;
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+bool CacheSnapshot::importLegacy(const QString &storageLocation)
+{
+    clear();
+
+    if (!QFile::exists(storageLocation + "notes.cache")) {
+        return false;
+    }
+
+    QSettings cacheFile(storageLocation + "notes.cache", QSettings::IniFormat);
+
+    cacheFile.beginGroup("notebooks");
+    foreach (const QString &key, cacheFile.allKeys()) {
+        QSettings infoFile(storageLocation + "notebook-" + key + ".info", QSettings::IniFormat);
+        NotebookRecord record;
+        record.guid = key;
+        record.updateSequenceNumber = cacheFile.value(key).toUInt();
+        record.name = infoFile.value("name").toString();
+        record.published = infoFile.value("published").toBool();
+        record.lastUpdated = infoFile.value("lastUpdated").toDateTime();
+        record.lastSyncedSequenceNumber = infoFile.value("lastSyncedSequenceNumber", 0).toUInt();
+        record.isDefaultNotebook = infoFile.value("isDefaultNotebook", false).toBool();
+        record.deleted = infoFile.value("deleted", false).toBool();
+        notebooks.append(record);
+    }
+    cacheFile.endGroup();
+
+    cacheFile.beginGroup("tags");
+    foreach (const QString &key, cacheFile.allKeys()) {
+        QSettings infoFile(storageLocation + "tag-" + key + ".info", QSettings::IniFormat);
+        TagRecord record;
+        record.guid = key;
+        record.updateSequenceNumber = cacheFile.value(key).toUInt();
+        record.name = infoFile.value("name").toString();
+        record.deleted = infoFile.value("deleted").toBool();
+        record.lastSyncedSequenceNumber = infoFile.value("lastSyncedSequenceNumber", 0).toUInt();
+        tags.append(record);
+    }
+    cacheFile.endGroup();
+
+    cacheFile.beginGroup("notes");
+    foreach (const QString &key, cacheFile.allKeys()) {
+        QSettings infoFile(storageLocation + "note-" + key + ".info", QSettings::IniFormat);
+        NoteRecord record;
+        record.guid = key;
+        record.updateSequenceNumber = cacheFile.value(key).toUInt();
+        record.created = infoFile.value("created").toDateTime();
+        record.title = infoFile.value("title").toString();
+        record.updated = infoFile.value("updated").toDateTime();
+        record.notebookGuid = infoFile.value("notebookGuid").toString();
+        record.tagGuids = infoFile.value("tagGuids").toStringList();
+        record.reminderOrder = infoFile.value("reminderOrder").toULongLong();
+        record.reminderTime = infoFile.value("reminderTime").toDateTime();
+        record.reminderDoneTime = infoFile.value("reminderDoneTime").toDateTime();
+        record.deleted = infoFile.value("deleted").toBool();
+        record.tagline = infoFile.value("tagline").toString();
+        record.lastSyncedSequenceNumber = infoFile.value("lastSyncedSequenceNumber", 0).toUInt();
+        record.needsContentSync = infoFile.value("needsContentSync", false).toBool();
+
+        infoFile.beginGroup("resources");
+        foreach (const QString &hash, infoFile.childGroups()) {
+            infoFile.beginGroup(hash);
+            ResourceRecord resource;
+            resource.hash = hash;
+            resource.fileName = infoFile.value("fileName").toString();
+            resource.type = infoFile.value("type").toString();
+            record.resources.append(resource);
+            infoFile.endGroup();
+        }
+        infoFile.endGroup();
+
+        notes.append(record);
+    }
+    cacheFile.endGroup();
+
+    qCDebug(dcStorage) << "Imported" << notes.count() << "notes," << notebooks.count() << "notebooks and" << tags.count() << "tags from legacy cache.";
+    return true;
+}
+
+void CacheSnapshot::removeLegacyFiles(const QString &storageLocation) const
+{
+    foreach (const NotebookRecord &record, notebooks) {
+        QFile::remove(storageLocation + "notebook-" + record.guid + ".info");
+    }
+    foreach (const TagRecord &record, tags) {
+        QFile::remove(storageLocation + "tag-" + record.guid + ".info");
+    }
+    foreach (const NoteRecord &record, notes) {
+        QFile::remove(storageLocation + "note-" + record.guid + ".info");
+    }
+    QFile::remove(storageLocation + "notes.cache");
+}
+
+void CacheSnapshot::clear()
+{
+    notes.clear();
+    notebooks.clear();
+    tags.clear();
+    syncState = SyncStateRecord();
+}
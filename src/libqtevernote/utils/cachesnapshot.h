@@ -0,0 +1,154 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CACHESNAPSHOT_H
+#define CACHESNAPSHOT_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+#include <QList>
+#include <QDataStream>
+
+// Plain value records holding everything we persist about the objects in the NotesStore.
+// Those are what gets written to the snapshot file. The QObjects (Note, Notebook, Tag) can
+// be constructed from a record and produce one with record().
+
+struct ResourceRecord
+{
+    ResourceRecord();
+
+    QString hash;
+    QString fileName;
+    QString type;
+    // The server's guid and the size of the data. Unknown for resources not uploaded yet and
+    // those loaded from version 1 and 2 snapshots, until the note is fetched again.
+    QString guid;
+    qint64 size;
+};
+
+struct NoteRecord
+{
+    NoteRecord();
+
+    QString guid;
+    qint32 updateSequenceNumber;
+    qint32 lastSyncedSequenceNumber;
+    QString notebookGuid;
+    QDateTime created;
+    QDateTime updated;
+    QString title;
+    QStringList tagGuids;
+    qint64 reminderOrder;
+    QDateTime reminderTime;
+    QDateTime reminderDoneTime;
+    bool deleted;
+    bool needsContentSync;
+    QString tagline;
+    QList<ResourceRecord> resources;
+    // The server's MD5 hash and length of the content in the cache file. Empty if the
+    // cached content isn't known to be the same as any version on the server.
+    QByteArray contentHash;
+    qint32 contentLength;
+};
+
+struct NotebookRecord
+{
+    NotebookRecord();
+
+    QString guid;
+    qint32 updateSequenceNumber;
+    qint32 lastSyncedSequenceNumber;
+    QString name;
+    bool published;
+    QDateTime lastUpdated;
+    bool isDefaultNotebook;
+    bool deleted;
+};
+
+struct TagRecord
+{
+    TagRecord();
+
+    QString guid;
+    qint32 updateSequenceNumber;
+    qint32 lastSyncedSequenceNumber;
+    QString name;
+    bool deleted;
+};
+
+// How far we got with the incremental sync. updateCount is the account's update count
+// at the time of the last completed sync, all changes up to that USN are in the snapshot.
+struct SyncStateRecord
+{
+    SyncStateRecord();
+
+    qint32 updateCount;
+    QDateTime lastSyncTime;
+};
+
+QDataStream &operator<<(QDataStream &stream, const ResourceRecord &record);
+QDataStream &operator>>(QDataStream &stream, ResourceRecord &record);
+QDataStream &operator<<(QDataStream &stream, const NoteRecord &record);
+QDataStream &operator>>(QDataStream &stream, NoteRecord &record);
+QDataStream &operator<<(QDataStream &stream, const NotebookRecord &record);
+QDataStream &operator>>(QDataStream &stream, NotebookRecord &record);
+QDataStream &operator<<(QDataStream &stream, const TagRecord &record);
+QDataStream &operator>>(QDataStream &stream, TagRecord &record);
+QDataStream &operator<<(QDataStream &stream, const SyncStateRecord &record);
+QDataStream &operator>>(QDataStream &stream, SyncStateRecord &record);
+
+// The snapshot is a single versioned binary file containing the metadata of all notes,
+// notebooks, tags and resources. It replaces the notes.cache index and the per object
+// .info files which required one QSettings parse per object at startup.
+// Note contents (note-<guid>.enml) and resource data are not part of the snapshot.
+class CacheSnapshot
+{
+public:
+    CacheSnapshot();
+
+    // Reads the whole file in one go. Returns false if the file is missing, has the
+    // wrong magic or an unsupported version. The snapshot is empty in that case.
+    // Version 1 files have no sync state and load with an empty one. Resources in version 1
+    // and 2 files have no guid and size. Notes in files before version 4 have no content hash.
+    bool load(const QString &fileName);
+
+    // Atomically replaces the file on disk.
+    bool save(const QString &fileName) const;
+
+    // Imports the old format (notes.cache + note-*.info, notebook-*.info, tag-*.info).
+    // Returns false if there is no old cache to import.
+    bool importLegacy(const QString &storageLocation);
+
+    // Removes the files imported by importLegacy(). Call this after the snapshot has been saved.
+    void removeLegacyFiles(const QString &storageLocation) const;
+
+    void clear();
+
+    QList<NoteRecord> notes;
+    QList<NotebookRecord> notebooks;
+    QList<TagRecord> tags;
+    SyncStateRecord syncState;
+
+private:
+    static const quint32 s_magic;
+    static const quint32 s_version;
+};
+
+#endif // CACHESNAPSHOT_H
@@ -0,0 +1,221 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cachewriter.h"
+#include "logging.h"
+
+#include <QMutexLocker>
+#include <QElapsedTimer>
+
+const int CacheWriter::s_batchDelay = 500;
+
+CacheWriter::CacheWriter(QObject *parent):
+    QThread(parent),
+    m_quit(false),
+    m_flushRequested(false),
+    m_queuedGeneration(0),
+    m_writtenGeneration(0)
+{
+}
+
+CacheWriter::~CacheWriter()
+{
+    m_mutex.lock();
+    m_quit = true;
+    m_wakeUp.wakeAll();
+    m_mutex.unlock();
+
+    // run() writes out everything pending before returning
+    wait();
+}
+
+void CacheWriter::reset(const QString &fileName, const CacheSnapshot &snapshot)
+{
+    flush();
+
+    QMutexLocker locker(&m_mutex);
+    m_fileName = fileName;
+    m_notes.clear();
+    m_notebooks.clear();
+    m_tags.clear();
+    m_syncState = snapshot.syncState;
+    foreach (const NoteRecord &record, snapshot.notes) {
+        m_notes.insert(record.guid, record);
+    }
+    foreach (const NotebookRecord &record, snapshot.notebooks) {
+        m_notebooks.insert(record.guid, record);
+    }
+    foreach (const TagRecord &record, snapshot.tags) {
+        m_tags.insert(record.guid, record);
+    }
+}
+
+void CacheWriter::upsert(const NoteRecord &record)
+{
+    QMutexLocker locker(&m_mutex);
+    m_removedNotes.remove(record.guid);
+    m_dirtyNotes.insert(record.guid, record);
+    changed();
+}
+
+void CacheWriter::upsert(const NotebookRecord &record)
+{
+    QMutexLocker locker(&m_mutex);
+    m_removedNotebooks.remove(record.guid);
+    m_dirtyNotebooks.insert(record.guid, record);
+    changed();
+}
+
+void CacheWriter::upsert(const TagRecord &record)
+{
+    QMutexLocker locker(&m_mutex);
+    m_removedTags.remove(record.guid);
+    m_dirtyTags.insert(record.guid, record);
+    changed();
+}
+
+void CacheWriter::removeNote(const QString &guid)
+{
+    QMutexLocker locker(&m_mutex);
+    m_dirtyNotes.remove(guid);
+    m_removedNotes.insert(guid);
+    changed();
+}
+
+void CacheWriter::removeNotebook(const QString &guid)
+{
+    QMutexLocker locker(&m_mutex);
+    m_dirtyNotebooks.remove(guid);
+    m_removedNotebooks.insert(guid);
+    changed();
+}
+
+void CacheWriter::removeTag(const QString &guid)
+{
+    QMutexLocker locker(&m_mutex);
+    m_dirtyTags.remove(guid);
+    m_removedTags.insert(guid);
+    changed();
+}
+
+void CacheWriter::setSyncState(const SyncStateRecord &record)
+{
+    QMutexLocker locker(&m_mutex);
+    m_syncState = record;
+    changed();
+}
+
+void CacheWriter::flush()
+{
+    QMutexLocker locker(&m_mutex);
+    if (!isRunning()) {
+        return;
+    }
+    quint64 target = m_queuedGeneration;
+    while (m_writtenGeneration < target) {
+        m_flushRequested = true;
+        m_wakeUp.wakeAll();
+        m_flushed.wait(&m_mutex);
+    }
+}
+
+// Must be called with m_mutex locked
+void CacheWriter::changed()
+{
+    // Only wake up the writer if it's idle. If it's already collecting a batch
+    // we don't want to cut the batch delay short.
+    if (m_queuedGeneration++ == m_writtenGeneration) {
+        m_wakeUp.wakeAll();
+    }
+}
+
+void CacheWriter::run()
+{
+    QMutexLocker locker(&m_mutex);
+    forever {
+        while (!m_quit && m_queuedGeneration == m_writtenGeneration) {
+            m_wakeUp.wait(&m_mutex);
+        }
+        if (m_queuedGeneration == m_writtenGeneration) {
+            // Quitting and nothing left to do
+            break;
+        }
+
+        // Give hot edits some time to pile up unless somebody is waiting for us
+        if (!m_quit && !m_flushRequested) {
+            m_wakeUp.wait(&m_mutex, s_batchDelay);
+        }
+
+        quint64 generation = m_queuedGeneration;
+        QString fileName = m_fileName;
+        QHash<QString, NoteRecord> dirtyNotes;
+        QHash<QString, NotebookRecord> dirtyNotebooks;
+        QHash<QString, TagRecord> dirtyTags;
+        QSet<QString> removedNotes;
+        QSet<QString> removedNotebooks;
+        QSet<QString> removedTags;
+        SyncStateRecord syncState = m_syncState;
+        dirtyNotes.swap(m_dirtyNotes);
+        dirtyNotebooks.swap(m_dirtyNotebooks);
+        dirtyTags.swap(m_dirtyTags);
+        removedNotes.swap(m_removedNotes);
+        removedNotebooks.swap(m_removedNotebooks);
+        removedTags.swap(m_removedTags);
+
+        locker.unlock();
+
+        QElapsedTimer timer;
+        timer.start();
+
+        foreach (const QString &guid, removedNotes) {
+            m_notes.remove(guid);
+        }
+        foreach (const QString &guid, removedNotebooks) {
+            m_notebooks.remove(guid);
+        }
+        foreach (const QString &guid, removedTags) {
+            m_tags.remove(guid);
+        }
+        foreach (const NoteRecord &record, dirtyNotes) {
+            m_notes.insert(record.guid, record);
+        }
+        foreach (const NotebookRecord &record, dirtyNotebooks) {
+            m_notebooks.insert(record.guid, record);
+        }
+        foreach (const TagRecord &record, dirtyTags) {
+            m_tags.insert(record.guid, record);
+        }
+
+        if (!fileName.isEmpty()) {
+            CacheSnapshot snapshot;
+            snapshot.notes = m_notes.values();
+            snapshot.notebooks = m_notebooks.values();
+            snapshot.tags = m_tags.values();
+            snapshot.syncState = syncState;
+            snapshot.save(fileName);
+            qCDebug(dcStorage) << "Wrote batch of" << dirtyNotes.count() + removedNotes.count() << "note changes in" << timer.elapsed() << "ms";
+        }
+
+        locker.relock();
+        m_writtenGeneration = generation;
+        if (m_writtenGeneration == m_queuedGeneration) {
+            m_flushRequested = false;
+        }
+        m_flushed.wakeAll();
+    }
+}
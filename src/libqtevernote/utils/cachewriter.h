@@ -0,0 +1,91 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CACHEWRITER_H
+#define CACHEWRITER_H
+
+#include "cachesnapshot.h"
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QHash>
+#include <QSet>
+
+// Writes the snapshot file in the background.
+// The NotesStore hands in the records of changed objects. Those are kept in a dirty set
+// where later changes to the same object replace earlier ones. The writer thread picks
+// up everything that piled up and writes it to disk in one go, so a burst of changes
+// results in a single write (and a single fsync) instead of one per object.
+class CacheWriter : public QThread
+{
+    Q_OBJECT
+public:
+    explicit CacheWriter(QObject *parent = 0);
+    ~CacheWriter();
+
+    // Writes out anything pending for the previous file and then starts over with
+    // the given file, using snapshot as its current content.
+    void reset(const QString &fileName, const CacheSnapshot &snapshot);
+
+    void upsert(const NoteRecord &record);
+    void upsert(const NotebookRecord &record);
+    void upsert(const TagRecord &record);
+    void removeNote(const QString &guid);
+    void removeNotebook(const QString &guid);
+    void removeTag(const QString &guid);
+    void setSyncState(const SyncStateRecord &record);
+
+    // Blocks until everything queued so far has been written to disk.
+    void flush();
+
+protected:
+    void run() override;
+
+private:
+    void changed();
+
+    // Time we wait for more changes to come in before writing a batch.
+    static const int s_batchDelay;
+
+    QMutex m_mutex;
+    QWaitCondition m_wakeUp;
+    QWaitCondition m_flushed;
+    bool m_quit;
+    bool m_flushRequested;
+    quint64 m_queuedGeneration;
+    quint64 m_writtenGeneration;
+
+    // Guarded by m_mutex
+    QString m_fileName;
+    QHash<QString, NoteRecord> m_dirtyNotes;
+    QHash<QString, NotebookRecord> m_dirtyNotebooks;
+    QHash<QString, TagRecord> m_dirtyTags;
+    QSet<QString> m_removedNotes;
+    QSet<QString> m_removedNotebooks;
+    QSet<QString> m_removedTags;
+    SyncStateRecord m_syncState;
+
+    // The current content of the file. Only touched by the writer thread,
+    // and by reset() while the writer is idle.
+    QHash<QString, NoteRecord> m_notes;
+    QHash<QString, NotebookRecord> m_notebooks;
+    QHash<QString, TagRecord> m_tags;
+};
+
+#endif // CACHEWRITER_H
@@ -0,0 +1,122 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "contentcompressor.h"
+#include "logging.h"
+
+#include <QtEndian>
+
+#include <cstring>
+
+#include <zlib.h>
+
+// "ENZ1", followed by the uncompressed size as big endian quint32
+static const char s_magic[] = { 'E', 'N', 'Z', '1' };
+static const int s_headerSize = sizeof(s_magic) + sizeof(quint32);
+
+// Anything bigger than this is a damaged header. Evernote notes are limited to a few MB.
+static const quint32 s_maxContentSize = 64 * 1024 * 1024;
+
+// Strings which show up in most notes. zlib can refer back to those from the very start
+// of the data. Matches towards the end are cheaper, so the most common ones go last.
+static const char s_dictionary[] =
+        "<table><tr><td></td></tr></table><ol><li></li></ol><h1></h1><h2></h2><h3></h3>"
+        "<blockquote></blockquote><hr/><font face=\"\" color=\"\" size=\"\"></font>"
+        "<a href=\"http://</a><a href=\"https://</a>"
+        "<en-media hash=\"\" type=\"application/pdf\"/><en-media hash=\"\" type=\"image/jpeg\"/>"
+        "<en-media hash=\"\" type=\"image/png\"/>"
+        "<span style=\"font-weight:600;\"></span><span style=\"font-style:italic;\"></span>"
+        "<span style=\"text-decoration: underline;\"></span><span style=\"\"></span>"
+        "<p style=\"padding-left:30px;\"><p style=\"margin-top:0px; margin-bottom:0px; margin-left:0px; margin-right:0px; text-indent:0px;\">"
+        "</p><p></p><ul><li></li></ul><b></b><i></i><u></u>"
+        "<en-todo checked=\"true\"/><en-todo checked=\"false\"/>"
+        "&amp;&lt;&gt;&quot;&nbsp;<br/></div><div><div></div><br/></div>"
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+        "<!DOCTYPE en-note SYSTEM \"http://xml.evernote.com/pub/enml2.dtd\">"
+        "<en-note><div></div></en-note>";
+
+QByteArray ContentCompressor::compress(const QByteArray &data)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit(&stream, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        qCWarning(dcStorage) << "Cannot initialize zlib:" << stream.msg;
+        return QByteArray();
+    }
+    deflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(s_dictionary), sizeof(s_dictionary) - 1);
+
+    QByteArray result(s_headerSize + deflateBound(&stream, data.size()), Qt::Uninitialized);
+    memcpy(result.data(), s_magic, sizeof(s_magic));
+    qToBigEndian<quint32>(data.size(), reinterpret_cast<uchar*>(result.data() + sizeof(s_magic)));
+
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+    stream.avail_in = data.size();
+    stream.next_out = reinterpret_cast<Bytef*>(result.data() + s_headerSize);
+    stream.avail_out = result.size() - s_headerSize;
+
+    int ret = deflate(&stream, Z_FINISH);
+    deflateEnd(&stream);
+    if (ret != Z_STREAM_END) {
+        qCWarning(dcStorage) << "Error compressing content:" << ret;
+        return QByteArray();
+    }
+    result.resize(s_headerSize + stream.total_out);
+    return result;
+}
+
+QByteArray ContentCompressor::uncompress(const QByteArray &data)
+{
+    if (!isCompressed(data)) {
+        return QByteArray();
+    }
+    quint32 size = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(data.constData() + sizeof(s_magic)));
+    if (size > s_maxContentSize) {
+        return QByteArray();
+    }
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit(&stream) != Z_OK) {
+        qCWarning(dcStorage) << "Cannot initialize zlib:" << stream.msg;
+        return QByteArray();
+    }
+
+    // One extra byte so a stream which is longer than announced doesn't look complete
+    QByteArray result(size + 1, Qt::Uninitialized);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData() + s_headerSize));
+    stream.avail_in = data.size() - s_headerSize;
+    stream.next_out = reinterpret_cast<Bytef*>(result.data());
+    stream.avail_out = result.size();
+
+    int ret = inflate(&stream, Z_FINISH);
+    if (ret == Z_NEED_DICT) {
+        inflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(s_dictionary), sizeof(s_dictionary) - 1);
+        ret = inflate(&stream, Z_FINISH);
+    }
+    inflateEnd(&stream);
+    if (ret != Z_STREAM_END || stream.total_out != size) {
+        return QByteArray();
+    }
+    result.resize(size);
+    return result;
+}
+
+bool ContentCompressor::isCompressed(const QByteArray &data)
+{
+    return data.size() >= s_headerSize && memcmp(data.constData(), s_magic, sizeof(s_magic)) == 0;
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONTENTCOMPRESSOR_H
+#define CONTENTCOMPRESSOR_H
+
+#include <QByteArray>
+
+// Compresses note content for the on-disk cache.
+// Uses zlib, primed with a dictionary of ENML boilerplate. Notes are mostly small and
+// consist to a good part of the same markup, which plain deflate can't take advantage of
+// as it starts from scratch for every note.
+// Compressed data starts with a short header, so it can be told apart from plain ENML
+// written by older versions.
+class ContentCompressor
+{
+public:
+    static QByteArray compress(const QByteArray &data);
+
+    // Returns a null QByteArray if data is damaged
+    static QByteArray uncompress(const QByteArray &data);
+
+    static bool isCompressed(const QByteArray &data);
+};
+
+#endif // CONTENTCOMPRESSOR_H
@@ -29,6 +29,7 @@
 #include <QUrl>
 #include <QUrlQuery>
 #include <QStandardPaths>
+#include <QImageReader>
 
 // ENML spec: http://xml.evernote.com/pub/enml2.dtd
 // QML supported HTML subset: http://qt-project.org/doc/qt-5.0/qtgui/richtext-html-subset.html
@@ -168,8 +169,8 @@ QString EnmlDocument::convert(const QString &noteGuid, EnmlDocument::Type type)
                     if (type == TypeRichText) {
                         writer.writeAttribute("src", composeMediaTypeUrl(mediaType, noteGuid, hash));
                     } else if (type  == TypeHtml) {
-                        if (NotesStore::instance()->note(noteGuid)->resource(hash)) {
-                            QString fileName = NotesStore::instance()->note(noteGuid)->resource(hash)->fileName();
+                        if (NotesStore::instance()->noteView(noteGuid)->resource(hash)) {
+                            QString fileName = NotesStore::instance()->noteView(noteGuid)->resource(hash)->fileName();
                             QString imagePath = NotesStore::instance()->storageLocation() + hash + "." + fileName.split('.').last();
                             writer.writeAttribute("src", imagePath);
                         }
@@ -180,9 +181,14 @@ QString EnmlDocument::convert(const QString &noteGuid, EnmlDocument::Type type)
                     // We don't even need to take care about what sizes we write back to Evernote as other
                     // Evernote clients ignore and override/change that too.
                     if (type == TypeRichText) {
-                        //get the size of the original image
-                        QImage image = QImage::fromData(NotesStore::instance()->note(noteGuid)->resource(hash)->data());
-                        int originalWidthInGus = image.width() * gu(1) / 8;
+                        //get the size of the original image. Only the header is read for that.
+                        QImageReader imageReader(NotesStore::instance()->noteView(noteGuid)->resource(hash)->hashedFilePath());
+                        QSize originalSize = imageReader.size();
+                        if (!originalSize.isValid()) {
+                            // Not every format can tell without decoding
+                            originalSize = imageReader.read().size();
+                        }
+                        int originalWidthInGus = originalSize.width() * gu(1) / 8;
                         int imageWidth = m_renderWidth >= 0 && originalWidthInGus > m_renderWidth ? m_renderWidth : originalWidthInGus;
                         writer.writeAttribute("width", QString::number(imageWidth));
                     } else if (type == TypeHtml) {
@@ -195,8 +201,8 @@ QString EnmlDocument::convert(const QString &noteGuid, EnmlDocument::Type type)
                         QString imagePath = "file:///usr/share/icons/suru/mimetypes/scalable/audio-x-generic-symbolic.svg";
                         writer.writeAttribute("src", imagePath);
                         writer.writeAttribute("id", "en-attachment/" + hash + "/" + mediaType);
-                        if (NotesStore::instance()->note(noteGuid)->resource(hash)) {
-                            writer.writeCharacters(NotesStore::instance()->note(noteGuid)->resource(hash)->fileName());
+                        if (NotesStore::instance()->noteView(noteGuid)->resource(hash)) {
+                            writer.writeCharacters(NotesStore::instance()->noteView(noteGuid)->resource(hash)->fileName());
                         }
                     }
                 } else if (mediaType == "application/pdf") {
@@ -206,8 +212,8 @@ QString EnmlDocument::convert(const QString &noteGuid, EnmlDocument::Type type)
                         QString imagePath = "file:///usr/share/icons/suru/mimetypes/scalable/application-pdf-symbolic.svg";
                         writer.writeAttribute("src", imagePath);
                         writer.writeAttribute("id", "en-attachment/" + hash + "/" + mediaType);
-                        if (NotesStore::instance()->note(noteGuid)->resource(hash)) {
-                            writer.writeCharacters(NotesStore::instance()->note(noteGuid)->resource(hash)->fileName());
+                        if (NotesStore::instance()->noteView(noteGuid)->resource(hash)) {
+                            writer.writeCharacters(NotesStore::instance()->noteView(noteGuid)->resource(hash)->fileName());
                         }
                     }
                 } else {
@@ -218,8 +224,8 @@ QString EnmlDocument::convert(const QString &noteGuid, EnmlDocument::Type type)
                         QString imagePath = "file:///usr/share/icons/suru/mimetypes/scalable/empty-symbolic.svg";
                         writer.writeAttribute("src", imagePath);
                         writer.writeAttribute("id", "en-attachment/" + hash + "/" + mediaType);
-                        if (NotesStore::instance()->note(noteGuid)->resource(hash)) {
-                            writer.writeCharacters(NotesStore::instance()->note(noteGuid)->resource(hash)->fileName());
+                        if (NotesStore::instance()->noteView(noteGuid)->resource(hash)) {
+                            writer.writeCharacters(NotesStore::instance()->noteView(noteGuid)->resource(hash)->fileName());
                         }
                     }
                 }
@@ -306,7 +312,7 @@ QString EnmlDocument::composeMediaTypeUrl(const QString &mediaType, const QStrin
     QUrlQuery arguments;
     arguments.addQueryItem("noteGuid", noteGuid);
     arguments.addQueryItem("hash", hash);
-    arguments.addQueryItem("loaded", NotesStore::instance()->note(noteGuid)->resource(hash)->isCached() ? "true" : "false");
+    arguments.addQueryItem("loaded", NotesStore::instance()->noteView(noteGuid)->resource(hash)->isCached() ? "true" : "false");
     url.setQuery(arguments);
     return url.toString();
 }
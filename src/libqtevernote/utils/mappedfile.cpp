@@ -0,0 +1,88 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mappedfile.h"
+#include "logging.h"
+
+#include <QFile>
+
+struct MappedFile::Mapping
+{
+    Mapping(const QString &fileName): file(fileName), data(nullptr), size(0) {}
+    ~Mapping() {
+        if (data) {
+            file.unmap(data);
+        }
+    }
+
+    QFile file;
+    uchar *data;
+    int size;
+    // Used if mapping isn't possible, e.g. for empty files
+    QByteArray buffer;
+};
+
+MappedFile::MappedFile()
+{
+}
+
+MappedFile::MappedFile(const QString &fileName):
+    m_mapping(new Mapping(fileName))
+{
+    if (!m_mapping->file.open(QFile::ReadOnly)) {
+        m_mapping.clear();
+        return;
+    }
+
+    m_mapping->data = m_mapping->file.map(0, m_mapping->file.size());
+    if (m_mapping->data) {
+        m_mapping->size = m_mapping->file.size();
+    } else {
+        qCDebug(dcStorage) << "Cannot map" << fileName << "Reading it instead.";
+        m_mapping->buffer = m_mapping->file.readAll();
+        m_mapping->size = m_mapping->buffer.size();
+    }
+    // The mapping stays valid after closing the file
+    m_mapping->file.close();
+}
+
+bool MappedFile::isValid() const
+{
+    return !m_mapping.isNull();
+}
+
+const char *MappedFile::data() const
+{
+    if (!m_mapping) {
+        return nullptr;
+    }
+    if (m_mapping->data) {
+        return reinterpret_cast<const char*>(m_mapping->data);
+    }
+    return m_mapping->buffer.constData();
+}
+
+int MappedFile::size() const
+{
+    return m_mapping ? m_mapping->size : 0;
+}
+
+QByteArray MappedFile::bytes() const
+{
+    return QByteArray::fromRawData(data(), size());
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QString>
+
+class QFile;
+
+// Read-only, memory mapped view of a file.
+// Copies share the same mapping, which is released once the last copy is gone. Readers get
+// the pages straight from the page cache instead of a private heap copy of the file.
+// Files are replaced, not rewritten in place, so a mapping always sees consistent content.
+class MappedFile
+{
+public:
+    MappedFile();
+    explicit MappedFile(const QString &fileName);
+
+    bool isValid() const;
+    const char *data() const;
+    int size() const;
+
+    // Wraps the mapped pages without copying. The returned QByteArray must not outlive this
+    // MappedFile (or a copy of it).
+    QByteArray bytes() const;
+
+private:
+    struct Mapping;
+    QSharedPointer<Mapping> m_mapping;
+};
+
+#endif // MAPPEDFILE_H
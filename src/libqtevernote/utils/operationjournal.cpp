@@ -0,0 +1,322 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "operationjournal.h"
+#include "logging.h"
+
+#include <QDataStream>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSaveFile>
+
+// Rewrite the log when it holds more than this many records and most of them are obsolete
+static const int s_compactionThreshold = 1000;
+
+// Each record is: quint32 payload length, quint16 checksum of the payload, payload
+static const int s_recordHeaderSize = sizeof(quint32) + sizeof(quint16);
+
+class JournalCompactionTask: public QRunnable
+{
+public:
+    JournalCompactionTask(OperationJournal *journal, const QString &fileName, const QList<OperationJournal::Entry> &entries):
+        m_journal(journal), m_fileName(fileName), m_entries(entries) {}
+    void run() override { m_journal->compact(m_fileName, m_entries); }
+private:
+    OperationJournal *m_journal;
+    QString m_fileName;
+    QList<OperationJournal::Entry> m_entries;
+};
+
+OperationJournal::OperationJournal():
+    m_lastSequence(0),
+    m_recordCount(0),
+    m_compacting(false),
+    m_compactionBacklogCount(0)
+{
+    m_compactionPool.setMaxThreadCount(1);
+}
+
+OperationJournal::~OperationJournal()
+{
+    close();
+}
+
+void OperationJournal::open(const QString &fileName)
+{
+    close();
+
+    QMutexLocker locker(&m_mutex);
+    m_file.setFileName(fileName);
+    if (!readRecords()) {
+        qCWarning(dcStorage) << "Journal" << fileName << "has a damaged tail. Dropping it.";
+    }
+    if (!m_file.open(QFile::WriteOnly | QFile::Append)) {
+        qCWarning(dcStorage) << "Cannot open journal for writing:" << fileName;
+    }
+    qCDebug(dcStorage) << "Journal opened with" << m_pending.count() << "pending operations.";
+}
+
+void OperationJournal::close()
+{
+    m_compactionPool.waitForDone();
+
+    QMutexLocker locker(&m_mutex);
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+    m_pending.clear();
+    m_pendingByGuid.clear();
+    m_lastSequence = 0;
+    m_recordCount = 0;
+}
+
+quint64 OperationJournal::append(Operation operation, const QString &guid, const QString &argument)
+{
+    QMutexLocker locker(&m_mutex);
+
+    Entry entry;
+    entry.sequence = ++m_lastSequence;
+    entry.operation = operation;
+    entry.guid = guid;
+    entry.argument = argument;
+
+    m_pending.insert(entry.sequence, entry);
+    m_pendingByGuid.insert(guid, entry.sequence);
+    writeRecord(operationPayload(entry));
+
+    return entry.sequence;
+}
+
+void OperationJournal::acknowledge(const QString &guid, quint64 sequence)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_pendingByGuid.contains(guid)) {
+        return;
+    }
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream << (quint8)RecordAcknowledge << guid << sequence;
+    writeRecord(payload);
+
+    applyAcknowledge(guid, sequence);
+
+    if (!m_compacting && m_recordCount > s_compactionThreshold && m_recordCount > 2 * m_pending.count()) {
+        startCompaction();
+    }
+}
+
+void OperationJournal::renameGuid(const QString &oldGuid, const QString &newGuid)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_pendingByGuid.contains(oldGuid)) {
+        return;
+    }
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream << (quint8)RecordRename << oldGuid << newGuid;
+    writeRecord(payload);
+
+    applyRename(oldGuid, newGuid);
+}
+
+quint64 OperationJournal::lastSequence() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_lastSequence;
+}
+
+QList<OperationJournal::Entry> OperationJournal::pending() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_pending.values();
+}
+
+// Must be called with m_mutex locked
+void OperationJournal::writeRecord(const QByteArray &payload)
+{
+    QByteArray record = frame(payload);
+    if (m_compacting) {
+        m_compactionBacklog.append(record);
+        m_compactionBacklogCount++;
+    }
+    // Flushing hands the data over to the kernel, so it survives the app crashing
+    m_file.write(record);
+    m_file.flush();
+    m_recordCount++;
+}
+
+// Must be called with m_mutex locked
+bool OperationJournal::readRecords()
+{
+    if (!m_file.exists()) {
+        return true;
+    }
+    if (!m_file.open(QFile::ReadOnly)) {
+        qCWarning(dcStorage) << "Cannot open journal for reading:" << m_file.fileName();
+        return true;
+    }
+    QByteArray data = m_file.readAll();
+    m_file.close();
+
+    int pos = 0;
+    bool intact = true;
+    while (pos < data.size()) {
+        if (data.size() - pos < s_recordHeaderSize) {
+            intact = false;
+            break;
+        }
+        QDataStream header(data.mid(pos, s_recordHeaderSize));
+        quint32 length;
+        quint16 checksum;
+        header >> length >> checksum;
+        if ((quint32)(data.size() - pos - s_recordHeaderSize) < length) {
+            intact = false;
+            break;
+        }
+        QByteArray payload = data.mid(pos + s_recordHeaderSize, length);
+        if (qChecksum(payload.constData(), payload.length()) != checksum) {
+            intact = false;
+            break;
+        }
+
+        QDataStream stream(payload);
+        quint8 type;
+        stream >> type;
+        switch (type) {
+        case RecordOperation: {
+            Entry entry;
+            quint8 operation;
+            stream >> entry.sequence >> operation >> entry.guid >> entry.argument;
+            entry.operation = (Operation)operation;
+            m_pending.insert(entry.sequence, entry);
+            m_pendingByGuid.insert(entry.guid, entry.sequence);
+            m_lastSequence = qMax(m_lastSequence, entry.sequence);
+            break;
+        }
+        case RecordAcknowledge: {
+            QString guid;
+            quint64 sequence;
+            stream >> guid >> sequence;
+            applyAcknowledge(guid, sequence);
+            break;
+        }
+        case RecordRename: {
+            QString oldGuid;
+            QString newGuid;
+            stream >> oldGuid >> newGuid;
+            applyRename(oldGuid, newGuid);
+            break;
+        }
+        }
+        m_recordCount++;
+        pos += s_recordHeaderSize + length;
+    }
+
+    if (!intact) {
+        // A crash while appending left a partial record. Cut it off so new records
+        // are appended after the last good one.
+        m_file.resize(pos);
+    }
+    return intact;
+}
+
+// Must be called with m_mutex locked
+void OperationJournal::applyAcknowledge(const QString &guid, quint64 sequence)
+{
+    foreach (quint64 pendingSequence, m_pendingByGuid.values(guid)) {
+        if (pendingSequence <= sequence) {
+            m_pending.remove(pendingSequence);
+            m_pendingByGuid.remove(guid, pendingSequence);
+        }
+    }
+}
+
+// Must be called with m_mutex locked
+void OperationJournal::applyRename(const QString &oldGuid, const QString &newGuid)
+{
+    foreach (quint64 sequence, m_pendingByGuid.values(oldGuid)) {
+        m_pending[sequence].guid = newGuid;
+        m_pendingByGuid.insert(newGuid, sequence);
+    }
+    m_pendingByGuid.remove(oldGuid);
+}
+
+// Must be called with m_mutex locked
+void OperationJournal::startCompaction()
+{
+    // The compacted file starts with what is pending right now, everything appended from
+    // here on goes to the backlog. Both have to start at the same point.
+    m_compacting = true;
+    m_compactionBacklog.clear();
+    m_compactionBacklogCount = 0;
+    m_compactionPool.start(new JournalCompactionTask(this, m_file.fileName(), m_pending.values()));
+}
+
+void OperationJournal::compact(const QString &fileName, const QList<Entry> &entries)
+{
+    // Write out the pending operations while appends keep going to the old file
+    QSaveFile compacted(fileName);
+    if (!compacted.open(QFile::WriteOnly)) {
+        qCWarning(dcStorage) << "Cannot compact journal" << fileName;
+        QMutexLocker locker(&m_mutex);
+        m_compacting = false;
+        m_compactionBacklog.clear();
+        return;
+    }
+    foreach (const Entry &entry, entries) {
+        compacted.write(frame(operationPayload(entry)));
+    }
+
+    QMutexLocker locker(&m_mutex);
+    // Anything that was appended in the meantime goes on top
+    compacted.write(m_compactionBacklog);
+    int backlogCount = m_compactionBacklogCount;
+    m_compactionBacklog.clear();
+    m_compacting = false;
+
+    if (!compacted.commit()) {
+        qCWarning(dcStorage) << "Error writing compacted journal" << fileName;
+        return;
+    }
+
+    m_file.close();
+    if (!m_file.open(QFile::WriteOnly | QFile::Append)) {
+        qCWarning(dcStorage) << "Cannot reopen journal for writing:" << fileName;
+    }
+    m_recordCount = entries.count() + backlogCount;
+    qCDebug(dcStorage) << "Journal compacted." << m_pending.count() << "pending operations left.";
+}
+
+QByteArray OperationJournal::frame(const QByteArray &payload)
+{
+    QByteArray record;
+    QDataStream stream(&record, QIODevice::WriteOnly);
+    stream << (quint32)payload.length() << qChecksum(payload.constData(), payload.length());
+    record.append(payload);
+    return record;
+}
+
+QByteArray OperationJournal::operationPayload(const Entry &entry)
+{
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream << (quint8)RecordOperation << entry.sequence << (quint8)entry.operation << entry.guid << entry.argument;
+    return payload;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPERATIONJOURNAL_H
+#define OPERATIONJOURNAL_H
+
+#include <QString>
+#include <QFile>
+#include <QMap>
+#include <QMultiHash>
+#include <QMutex>
+#include <QThreadPool>
+
+// Append-only log of local changes which haven't been pushed to the server yet.
+//
+// Each local mutation gets a sequence number and is appended as a checksummed record.
+// Once the server confirmed a change, an acknowledge record is appended. On startup the
+// log is read back and everything that hasn't been acknowledged is what still needs to
+// be pushed, without having to look at all the notes.
+// The log is rewritten with only the pending operations every now and then. This happens
+// on a worker thread, appends are not blocked by it.
+class OperationJournal
+{
+public:
+    enum Operation {
+        OperationCreateNote,
+        OperationSaveNote,
+        OperationDeleteNote,
+        OperationTagNote,
+        OperationUntagNote,
+        OperationCreateNotebook,
+        OperationSaveNotebook,
+        OperationExpungeNotebook,
+        OperationCreateTag,
+        OperationSaveTag,
+        OperationExpungeTag
+    };
+
+    struct Entry {
+        quint64 sequence;
+        Operation operation;
+        QString guid;
+        QString argument;
+    };
+
+    OperationJournal();
+    ~OperationJournal();
+
+    // Reads the pending operations from the given file and keeps it open for appending.
+    void open(const QString &fileName);
+    void close();
+
+    // Returns the sequence number of the new entry
+    quint64 append(Operation operation, const QString &guid, const QString &argument = QString());
+
+    // Marks all operations on guid up to and including sequence as done.
+    void acknowledge(const QString &guid, quint64 sequence);
+
+    // Objects created locally get a new guid once they are created on the server.
+    void renameGuid(const QString &oldGuid, const QString &newGuid);
+
+    quint64 lastSequence() const;
+
+    // All not yet acknowledged operations, ordered by sequence
+    QList<Entry> pending() const;
+
+private:
+    enum RecordType {
+        RecordOperation,
+        RecordAcknowledge,
+        RecordRename
+    };
+
+    void writeRecord(const QByteArray &payload);
+    bool readRecords();
+    void applyAcknowledge(const QString &guid, quint64 sequence);
+    void applyRename(const QString &oldGuid, const QString &newGuid);
+    void startCompaction();
+    void compact(const QString &fileName, const QList<Entry> &entries);
+
+    static QByteArray frame(const QByteArray &payload);
+    static QByteArray operationPayload(const Entry &entry);
+
+    mutable QMutex m_mutex;
+    QFile m_file;
+    quint64 m_lastSequence;
+
+    QMap<quint64, Entry> m_pending;
+    QMultiHash<QString, quint64> m_pendingByGuid;
+    int m_recordCount;
+
+    // Records appended while a compaction is running. They are written to the compacted file
+    // after it's been created.
+    bool m_compacting;
+    QByteArray m_compactionBacklog;
+    int m_compactionBacklogCount;
+    QThreadPool m_compactionPool;
+
+    friend class JournalCompactionTask;
+};
+
+#endif // OPERATIONJOURNAL_H
@@ -68,8 +68,9 @@ void OrganizerAdapter::startSync()
 
 void OrganizerAdapter::writeReminders()
 {
-    foreach (Note* note, NotesStore::instance()->notes()) {
-        if (note->reminder() && note->hasReminderTime() && !note->reminderDone() && !note->deleted()) {
+    for (int i = 0; i < NotesStore::instance()->count(); i++) {
+        const NoteData *note = NotesStore::instance()->noteData(i);
+        if (note->reminder() && !note->reminderTime.isNull() && !note->reminderDone() && !note->deleted) {
             QOrganizerTodo item;
             organizerEventFromNote(note, item);
 
@@ -82,17 +83,17 @@ void OrganizerAdapter::writeReminders()
     }
 }
 
-void OrganizerAdapter::organizerEventFromNote(Note *note, QOrganizerTodo &item)
+void OrganizerAdapter::organizerEventFromNote(const NoteData *note, QOrganizerTodo &item)
 {
     item.setCollectionId(m_collection.id());
     item.setAllDay(false);
-    item.setStartDateTime(note->reminderTime().toUTC());
-    item.setDisplayLabel(note->title());
-    item.setDescription(note->guid());
+    item.setStartDateTime(note->reminderTime.toUTC());
+    item.setDisplayLabel(note->title);
+    item.setDescription(note->guid);
 
     QOrganizerItemVisualReminder visual;
     visual.setSecondsBeforeStart(0);
-    visual.setMessage(note->title());
+    visual.setMessage(note->title);
     item.saveDetail(&visual);
 
     QOrganizerItemAudibleReminder audible;
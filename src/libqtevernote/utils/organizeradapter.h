@@ -27,7 +27,7 @@ private slots:
     void deleteStateChanged(QOrganizerAbstractRequest::State state);
 
 private:
-    void organizerEventFromNote(Note *note, QOrganizerTodo &item);
+    void organizerEventFromNote(const NoteData *note, QOrganizerTodo &item);
     void loadReminders();
     void writeReminders();
 
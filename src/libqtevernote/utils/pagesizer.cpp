@@ -0,0 +1,71 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pagesizer.h"
+
+#include <QtMath>
+
+PageSizer::PageSizer(int minimum, int initial, int maximum, int targetMsecs):
+    m_minimum(minimum),
+    m_initial(initial),
+    m_maximum(maximum),
+    m_targetMsecs(targetMsecs)
+{
+    reset();
+}
+
+int PageSizer::pageSize() const
+{
+    return m_pageSize;
+}
+
+void PageSizer::addSample(int items, qint64 msecs)
+{
+    if (items <= 0 || msecs <= 0) {
+        return;
+    }
+
+    if (m_roundTrip < 0) {
+        // A single page can't tell the two apart. Assume half and half, the
+        // following pages correct that.
+        m_roundTrip = msecs / 2.0;
+        m_perItem = msecs / 2.0 / items;
+    } else {
+        // The fastest page is an upper bound for the round trip
+        m_roundTrip = qMin(m_roundTrip, (qreal)msecs);
+        qreal perItem = qMax((qreal)0.01, (msecs - m_roundTrip) / items);
+        m_perItem = (m_perItem + perItem) / 2;
+    }
+
+    // Large enough for the round trip to be at most a quarter of the page's time,
+    // or as large as fits into the target time, whichever is more
+    qreal forRoundTrip = 3 * m_roundTrip / m_perItem;
+    qreal forTarget = (m_targetMsecs - m_roundTrip) / m_perItem;
+    int pageSize = qFloor(qMax(forRoundTrip, forTarget));
+
+    // Don't jump around on a single odd sample
+    pageSize = qBound(m_pageSize / 2, pageSize, m_pageSize * 2);
+    m_pageSize = qBound(m_minimum, pageSize, m_maximum);
+}
+
+void PageSizer::reset()
+{
+    m_pageSize = m_initial;
+    m_roundTrip = -1;
+    m_perItem = -1;
+}
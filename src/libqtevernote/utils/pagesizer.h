@@ -0,0 +1,54 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PAGESIZER_H
+#define PAGESIZER_H
+
+#include <QtGlobal>
+
+// Picks how many items to ask for per page of a paginated listing. Each request costs a
+// round trip no matter how little it returns, each item adds its share of transfer and
+// processing time. From the time pages took, the round trip and the time per item are
+// estimated. Pages are made large enough for the round trip to be a small part of the
+// time they take, but not so large that one takes much longer than targetMsecs.
+class PageSizer
+{
+public:
+    PageSizer(int minimum, int initial, int maximum, int targetMsecs);
+
+    int pageSize() const;
+
+    // A page of items entries took msecs from sending the request to having the reply
+    void addSample(int items, qint64 msecs);
+
+    // Forgets the estimates, e.g. when connecting to another server
+    void reset();
+
+private:
+    int m_minimum;
+    int m_initial;
+    int m_maximum;
+    int m_targetMsecs;
+
+    int m_pageSize;
+    // Estimates in milliseconds, negative while there's no sample yet
+    qreal m_roundTrip;
+    qreal m_perItem;
+};
+
+#endif // PAGESIZER_H
@@ -0,0 +1,184 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "resourcecache.h"
+#include "logging.h"
+
+#include <QDir>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRegExp>
+#include <QRunnable>
+
+#include <algorithm>
+#include <utime.h>
+
+// Unreferenced files younger than this are left alone. They might belong to a note which
+// got its resources after the pass has been started.
+static const int s_orphanGracePeriod = 10 * 60;
+// A download keeps writing to its .part file. One that hasn't been touched for this long
+// has been left behind by a crash or a download which got stuck.
+static const int s_partialDownloadTimeout = 30 * 60;
+
+class ResourceCacheTask: public QRunnable
+{
+public:
+    ResourceCacheTask(ResourceCache *cache, const QString &directory, const QHash<QString, bool> &references, qint64 budget):
+        m_cache(cache), m_directory(directory), m_references(references), m_budget(budget) {}
+    void run() override { m_cache->run(m_directory, m_references, m_budget); }
+private:
+    ResourceCache *m_cache;
+    QString m_directory;
+    QHash<QString, bool> m_references;
+    qint64 m_budget;
+};
+
+struct CacheEntry
+{
+    QString path;
+    QString hash;
+    qint64 size;
+    QDateTime lastUsed;
+};
+
+static bool lessRecentlyUsed(const CacheEntry &a, const CacheEntry &b)
+{
+    return a.lastUsed < b.lastUsed;
+}
+
+ResourceCache::ResourceCache(QObject *parent):
+    QObject(parent),
+    m_budget(256 * 1024 * 1024),
+    m_collecting(false)
+{
+    m_pool.setMaxThreadCount(1);
+    connect(this, &ResourceCache::collected, this, [this]() { m_collecting = false; });
+}
+
+ResourceCache::~ResourceCache()
+{
+    m_pool.waitForDone();
+}
+
+qint64 ResourceCache::budget() const
+{
+    return m_budget;
+}
+
+void ResourceCache::setBudget(qint64 budget)
+{
+    m_budget = budget;
+}
+
+void ResourceCache::collect(const QString &directory, const QHash<QString, bool> &references)
+{
+    if (m_collecting) {
+        return;
+    }
+    m_collecting = true;
+    m_pool.start(new ResourceCacheTask(this, directory, references, m_budget));
+}
+
+void ResourceCache::touch(const QString &filePath)
+{
+    // Sets both, access and modification time, to now. The modification time is
+    // what the cleanup pass looks at, as atime is often not maintained.
+    utime(QFile::encodeName(filePath).constData(), nullptr);
+}
+
+void ResourceCache::run(const QString &directory, const QHash<QString, bool> &references, qint64 budget)
+{
+    QElapsedTimer timer;
+    timer.start();
+    QDateTime orphanDeadline = QDateTime::currentDateTime().addSecs(-s_orphanGracePeriod);
+    QDateTime partialDeadline = QDateTime::currentDateTime().addSecs(-s_partialDownloadTimeout);
+
+    QRegExp resourcePattern("^([0-9a-f]{32})\\..+");
+    QRegExp scaledPattern(".+_[0-9]+x[0-9]+\\.jpg");
+
+    QList<CacheEntry> scaledCopies;
+    QList<CacheEntry> originals;
+    qint64 total = 0;
+    int orphans = 0;
+    int partials = 0;
+
+    QDir dir(directory);
+    foreach (const QFileInfo &info, dir.entryInfoList(QDir::Files)) {
+        if (info.suffix() == QLatin1String("part")) {
+            // Downloads in progress are neither in use nor to be evicted
+            if (info.lastModified() < partialDeadline) {
+                QFile::remove(info.filePath());
+                partials++;
+            }
+            continue;
+        }
+        if (!resourcePattern.exactMatch(info.fileName())) {
+            // Not a resource. Notes, snapshot, journal...
+            continue;
+        }
+        CacheEntry entry;
+        entry.path = info.filePath();
+        entry.hash = resourcePattern.cap(1);
+        entry.size = info.size();
+        entry.lastUsed = info.lastModified();
+
+        if (!references.contains(entry.hash)) {
+            if (entry.lastUsed < orphanDeadline) {
+                QFile::remove(entry.path);
+                orphans++;
+            }
+            continue;
+        }
+
+        total += entry.size;
+        if (scaledPattern.exactMatch(info.fileName())) {
+            scaledCopies.append(entry);
+        } else if (!references.value(entry.hash)) {
+            originals.append(entry);
+        }
+    }
+
+    qint64 totalBefore = total;
+    QStringList evictedHashes;
+    if (total > budget) {
+        std::sort(scaledCopies.begin(), scaledCopies.end(), lessRecentlyUsed);
+        std::sort(originals.begin(), originals.end(), lessRecentlyUsed);
+
+        // Scaled copies are cheap to recreate, so all of those go before any original
+        QList<CacheEntry> candidates = scaledCopies + originals;
+        for (int i = 0; i < candidates.count() && total > budget; i++) {
+            const CacheEntry &entry = candidates.at(i);
+            // Skip files which have been used since we looked at them
+            if (QFileInfo(entry.path).lastModified() > entry.lastUsed) {
+                continue;
+            }
+            if (!QFile::remove(entry.path)) {
+                continue;
+            }
+            total -= entry.size;
+            if (i >= scaledCopies.count()) {
+                evictedHashes.append(entry.hash);
+            }
+        }
+    }
+
+    qCDebug(dcStorage) << "Resource cache cleanup took" << timer.elapsed() << "ms. Removed" << orphans << "orphaned files and" << partials << "stale partial downloads, evicted"
+                       << (totalBefore - total) / 1024 << "KiB," << evictedHashes.count() << "of them originals." << total / 1024 << "KiB in use.";
+    emit collected(evictedHashes);
+}
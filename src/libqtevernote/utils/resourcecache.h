@@ -0,0 +1,69 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RESOURCECACHE_H
+#define RESOURCECACHE_H
+
+#include <QObject>
+#include <QHash>
+#include <QStringList>
+#include <QThreadPool>
+
+// Keeps the resource files in the storage directory within a disk budget.
+// Resource files are content addressed: <hash>.<ext> for the original and
+// <hash>.<ext>_<W>x<H>.jpg for the scaled copies made for the ui. Downloads are written to
+// <hash>.<ext>.part first, those are only removed once they are stale.
+//
+// A cleanup pass runs on a worker thread. It removes files for hashes no note refers to
+// any more, and then, if the rest is over budget, evicts the least recently used scaled
+// copies first and then the least recently used originals which aren't pinned. Evicted
+// originals are fetched from the server again when the note is loaded.
+class ResourceCache: public QObject
+{
+    Q_OBJECT
+public:
+    explicit ResourceCache(QObject *parent = 0);
+    ~ResourceCache();
+
+    // In bytes
+    qint64 budget() const;
+    void setBudget(qint64 budget);
+
+    // Starts a cleanup pass over directory. references holds the hashes of all resources
+    // still used by a note, mapped to whether the original must be kept (e.g. because it
+    // hasn't been uploaded yet). Does nothing if a pass is still running.
+    void collect(const QString &directory, const QHash<QString, bool> &references);
+
+    // Marks the file as recently used
+    static void touch(const QString &filePath);
+
+signals:
+    // Emitted once a pass is done, with the hashes of the referenced originals which got evicted
+    void collected(const QStringList &evictedHashes);
+
+private:
+    void run(const QString &directory, const QHash<QString, bool> &references, qint64 budget);
+
+    qint64 m_budget;
+    bool m_collecting;
+    QThreadPool m_pool;
+
+    friend class ResourceCacheTask;
+};
+
+#endif // RESOURCECACHE_H
@@ -0,0 +1,89 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tokenbucket.h"
+
+#include <QtMath>
+
+TokenBucket::TokenBucket(int capacity, qreal rate):
+    m_capacity(capacity),
+    m_rate(rate),
+    m_tokens(capacity)
+{
+    m_clock.start();
+}
+
+int TokenBucket::capacity() const
+{
+    return m_capacity;
+}
+
+void TokenBucket::setCapacity(int capacity)
+{
+    refill();
+    m_capacity = qMax(1, capacity);
+    m_tokens = qMin(m_tokens, (qreal)m_capacity);
+}
+
+qreal TokenBucket::rate() const
+{
+    return m_rate;
+}
+
+void TokenBucket::setRate(qreal rate)
+{
+    refill();
+    m_rate = rate;
+}
+
+bool TokenBucket::tryTake()
+{
+    if (m_rate <= 0) {
+        return true;
+    }
+    refill();
+    if (m_tokens < 1) {
+        return false;
+    }
+    m_tokens -= 1;
+    return true;
+}
+
+int TokenBucket::msecsUntilAvailable()
+{
+    if (m_rate <= 0) {
+        return 0;
+    }
+    refill();
+    if (m_tokens >= 1) {
+        return 0;
+    }
+    return qCeil((1 - m_tokens) * 1000 / m_rate);
+}
+
+void TokenBucket::drain()
+{
+    refill();
+    m_tokens = 0;
+}
+
+void TokenBucket::refill()
+{
+    qint64 elapsed = m_clock.restart();
+    m_tokens = qMin((qreal)m_capacity, m_tokens + elapsed * qMax(m_rate, (qreal)0) / 1000);
+}
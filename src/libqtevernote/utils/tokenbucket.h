@@ -0,0 +1,56 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TOKENBUCKET_H
+#define TOKENBUCKET_H
+
+#include <QElapsedTimer>
+
+// Client side throttling of requests. Holds up to capacity tokens, refilling at rate tokens
+// per second. Every request takes one, so bursts are fine but a bulk sync is slowed down to
+// the rate before the server needs to tell us to back off. A rate of 0 doesn't throttle.
+class TokenBucket
+{
+public:
+    TokenBucket(int capacity, qreal rate);
+
+    int capacity() const;
+    void setCapacity(int capacity);
+
+    qreal rate() const;
+    void setRate(qreal rate);
+
+    // Takes a token if one is available
+    bool tryTake();
+
+    // Milliseconds until the next token is available, 0 if there is one now
+    int msecsUntilAvailable();
+
+    // Empties the bucket, e.g. after the server told us we were too fast
+    void drain();
+
+private:
+    void refill();
+
+    int m_capacity;
+    qreal m_rate;
+    qreal m_tokens;
+    QElapsedTimer m_clock;
+};
+
+#endif // TOKENBUCKET_H
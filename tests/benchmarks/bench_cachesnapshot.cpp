@@ -0,0 +1,185 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/cachesnapshot.h"
+
+#include <QDir>
+#include <QSettings>
+#include <QTemporaryDir>
+#include <QtTest>
+
+// Startup cost of the metadata cache: loading the snapshot file compared to reading the
+// old notes.cache index with one .info file per object.
+class CacheSnapshotBenchmark: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void load_data();
+    void load();
+    void save_data();
+    void save();
+    void importLegacy_data();
+    void importLegacy();
+
+private:
+    void addRows();
+    QString directory(int notes) const;
+
+    QTemporaryDir m_dir;
+};
+
+static NoteRecord makeNote(int i)
+{
+    NoteRecord note;
+    note.guid = QString("0c6d3b6e-6f1a-4a5e-9f0b-%1").arg(i, 12, 10, QChar('0'));
+    note.updateSequenceNumber = 1000 + i;
+    note.lastSyncedSequenceNumber = note.updateSequenceNumber;
+    note.notebookGuid = QString("notebook-%1").arg(i % 10);
+    note.created = QDateTime(QDate(2015, 1, 1), QTime(12, 0), Qt::UTC).addSecs(i * 60);
+    note.updated = note.created.addSecs(3600);
+    note.title = QString("Note number %1").arg(i);
+    note.tagGuids << QString("tag-%1").arg(i % 20);
+    note.tagline = QString("The first few words of note %1, as they show up in the list").arg(i);
+    if (i % 5 == 0) {
+        ResourceRecord resource;
+        resource.hash = QString("%1").arg(i, 32, 16, QChar('0'));
+        resource.fileName = "photo.jpg";
+        resource.type = "image/jpeg";
+        note.resources.append(resource);
+    }
+    return note;
+}
+
+void CacheSnapshotBenchmark::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+
+    QList<int> sizes;
+    sizes << 1000 << 10000;
+    foreach (int count, sizes) {
+        QString path = directory(count);
+        QVERIFY(QDir().mkpath(path));
+
+        CacheSnapshot snapshot;
+        QSettings cacheFile(path + "notes.cache", QSettings::IniFormat);
+        for (int i = 0; i < 10; i++) {
+            NotebookRecord notebook;
+            notebook.guid = QString("notebook-%1").arg(i);
+            notebook.name = QString("Notebook %1").arg(i);
+            snapshot.notebooks.append(notebook);
+            cacheFile.setValue("notebooks/" + notebook.guid, 1);
+            QSettings infoFile(path + "notebook-" + notebook.guid + ".info", QSettings::IniFormat);
+            infoFile.setValue("name", notebook.name);
+        }
+        for (int i = 0; i < 20; i++) {
+            TagRecord tag;
+            tag.guid = QString("tag-%1").arg(i);
+            tag.name = QString("tag %1").arg(i);
+            snapshot.tags.append(tag);
+            cacheFile.setValue("tags/" + tag.guid, 1);
+            QSettings infoFile(path + "tag-" + tag.guid + ".info", QSettings::IniFormat);
+            infoFile.setValue("name", tag.name);
+        }
+        for (int i = 0; i < count; i++) {
+            NoteRecord note = makeNote(i);
+            snapshot.notes.append(note);
+            cacheFile.setValue("notes/" + note.guid, note.updateSequenceNumber);
+            QSettings infoFile(path + "note-" + note.guid + ".info", QSettings::IniFormat);
+            infoFile.setValue("created", note.created);
+            infoFile.setValue("title", note.title);
+            infoFile.setValue("updated", note.updated);
+            infoFile.setValue("notebookGuid", note.notebookGuid);
+            infoFile.setValue("tagGuids", note.tagGuids);
+            infoFile.setValue("tagline", note.tagline);
+            infoFile.setValue("lastSyncedSequenceNumber", note.lastSyncedSequenceNumber);
+            foreach (const ResourceRecord &resource, note.resources) {
+                infoFile.setValue("resources/" + resource.hash + "/fileName", resource.fileName);
+                infoFile.setValue("resources/" + resource.hash + "/type", resource.type);
+            }
+        }
+        QVERIFY(snapshot.save(path + "notes.snapshot"));
+    }
+}
+
+QString CacheSnapshotBenchmark::directory(int notes) const
+{
+    return m_dir.path() + QString("/%1/").arg(notes);
+}
+
+void CacheSnapshotBenchmark::addRows()
+{
+    QTest::addColumn<int>("notes");
+
+    QTest::newRow("1000 notes") << 1000;
+    QTest::newRow("10000 notes") << 10000;
+}
+
+void CacheSnapshotBenchmark::load_data()
+{
+    addRows();
+}
+
+void CacheSnapshotBenchmark::load()
+{
+    QFETCH(int, notes);
+
+    CacheSnapshot snapshot;
+    QBENCHMARK {
+        QVERIFY(snapshot.load(directory(notes) + "notes.snapshot"));
+    }
+    QCOMPARE(snapshot.notes.count(), notes);
+}
+
+void CacheSnapshotBenchmark::save_data()
+{
+    addRows();
+}
+
+void CacheSnapshotBenchmark::save()
+{
+    QFETCH(int, notes);
+
+    CacheSnapshot snapshot;
+    QVERIFY(snapshot.load(directory(notes) + "notes.snapshot"));
+    QBENCHMARK {
+        QVERIFY(snapshot.save(directory(notes) + "saved.snapshot"));
+    }
+}
+
+void CacheSnapshotBenchmark::importLegacy_data()
+{
+    addRows();
+}
+
+void CacheSnapshotBenchmark::importLegacy()
+{
+    QFETCH(int, notes);
+
+    CacheSnapshot snapshot;
+    QBENCHMARK {
+        QVERIFY(snapshot.importLegacy(directory(notes)));
+    }
+    QCOMPARE(snapshot.notes.count(), notes);
+}
+
+QTEST_GUILESS_MAIN(CacheSnapshotBenchmark)
+
+#include "bench_cachesnapshot.moc"
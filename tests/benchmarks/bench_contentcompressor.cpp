@@ -0,0 +1,125 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/contentcompressor.h"
+
+#include <QtTest>
+
+// Size and speed of the content cache compression. qCompress() is plain zlib without the
+// ENML dictionary, for comparison.
+class ContentCompressorBenchmark: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void compress_data();
+    void compress();
+    void uncompress_data();
+    void uncompress();
+    void plainZlib_data();
+    void plainZlib();
+};
+
+static QByteArray makeNote(int paragraphs)
+{
+    QByteArray note = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+                      "<!DOCTYPE en-note SYSTEM \"http://xml.evernote.com/pub/enml2.dtd\">"
+                      "<en-note>";
+    for (int i = 0; i < paragraphs; i++) {
+        switch (i % 4) {
+        case 0:
+            note += "<div>Meeting notes for week " + QByteArray::number(i) + ", see the attached plan</div>";
+            break;
+        case 1:
+            note += "<div><en-todo checked=\"false\"/>Call the office about item " + QByteArray::number(i * 7) + "<br/></div>";
+            break;
+        case 2:
+            note += "<div><span style=\"font-weight:600;\">Important:</span> bring " + QByteArray::number(i) + " copies</div>";
+            break;
+        case 3:
+            note += "<div><en-media hash=\"" + QByteArray::number(i * 7919, 16).rightJustified(32, '0') + "\" type=\"image/jpeg\"/></div>";
+            break;
+        }
+    }
+    note += "</en-note>";
+    return note;
+}
+
+static void addRows()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    QTest::newRow("short note") << makeNote(2);
+    QTest::newRow("medium note") << makeNote(20);
+    QTest::newRow("long note") << makeNote(2000);
+}
+
+void ContentCompressorBenchmark::compress_data()
+{
+    addRows();
+}
+
+void ContentCompressorBenchmark::compress()
+{
+    QFETCH(QByteArray, data);
+
+    QByteArray compressed;
+    QBENCHMARK {
+        compressed = ContentCompressor::compress(data);
+    }
+    qDebug() << data.size() << "bytes compressed to" << compressed.size()
+             << QString("(%1%)").arg(100.0 * compressed.size() / data.size(), 0, 'f', 1);
+}
+
+void ContentCompressorBenchmark::uncompress_data()
+{
+    addRows();
+}
+
+void ContentCompressorBenchmark::uncompress()
+{
+    QFETCH(QByteArray, data);
+
+    QByteArray compressed = ContentCompressor::compress(data);
+    QByteArray uncompressed;
+    QBENCHMARK {
+        uncompressed = ContentCompressor::uncompress(compressed);
+    }
+    QCOMPARE(uncompressed, data);
+}
+
+void ContentCompressorBenchmark::plainZlib_data()
+{
+    addRows();
+}
+
+void ContentCompressorBenchmark::plainZlib()
+{
+    QFETCH(QByteArray, data);
+
+    QByteArray compressed;
+    QBENCHMARK {
+        compressed = qCompress(data);
+    }
+    qDebug() << data.size() << "bytes compressed to" << compressed.size()
+             << QString("(%1%)").arg(100.0 * compressed.size() / data.size(), 0, 'f', 1);
+}
+
+QTEST_GUILESS_MAIN(ContentCompressorBenchmark)
+
+#include "bench_contentcompressor.moc"
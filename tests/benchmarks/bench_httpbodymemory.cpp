@@ -0,0 +1,148 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Memory THttpClient needs to read a large response body with Content-Length, like a resource
+// download. The replies are generated on the fly by a fake transport and never held in memory,
+// so the growth of the peak RSS is what the client buffered.
+//
+//   bench_httpbodymemory [megabytes]
+
+#include <transport/THttpClient.h>
+#include <transport/TVirtualTransport.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/resource.h>
+
+using namespace apache::thrift::transport;
+
+class FakeServer : public TVirtualTransport<FakeServer>
+{
+public:
+    FakeServer(uint32_t bodySize, int replies):
+        m_bodySize(bodySize),
+        m_replies(replies),
+        m_inBody(false),
+        m_bodyPos(0),
+        m_headerPos(0)
+    {
+    }
+
+    bool isOpen() { return true; }
+    void open() {}
+    void close() {}
+    void write(const uint8_t *, uint32_t) {}
+    void flush() {}
+
+    uint32_t read(uint8_t *buffer, uint32_t len)
+    {
+        if (!m_inBody) {
+            if (m_replies == 0) {
+                return 0;
+            }
+            if (m_header.empty()) {
+                char header[128];
+                snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Length: %u\r\n\r\n", m_bodySize);
+                m_header = header;
+                m_headerPos = 0;
+            }
+            uint32_t count = std::min<uint32_t>(len, m_header.size() - m_headerPos);
+            memcpy(buffer, m_header.data() + m_headerPos, count);
+            m_headerPos += count;
+            if (m_headerPos == m_header.size()) {
+                m_header.clear();
+                m_inBody = true;
+                m_bodyPos = 0;
+            }
+            return count;
+        }
+
+        uint32_t count = std::min(len, m_bodySize - m_bodyPos);
+        for (uint32_t i = 0; i < count; i++) {
+            buffer[i] = bodyByte(m_bodyPos + i);
+        }
+        m_bodyPos += count;
+        if (m_bodyPos == m_bodySize) {
+            m_inBody = false;
+            m_replies--;
+        }
+        return count;
+    }
+
+    static uint8_t bodyByte(uint32_t pos)
+    {
+        return static_cast<uint8_t>(pos * 7);
+    }
+
+private:
+    uint32_t m_bodySize;
+    int m_replies;
+    bool m_inBody;
+    uint32_t m_bodyPos;
+    std::string m_header;
+    size_t m_headerPos;
+};
+
+static long maxRssMegabytes()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t size = (argc > 1 ? atoi(argv[1]) : 200) * 1024u * 1024u;
+
+    boost::shared_ptr<FakeServer> server(new FakeServer(size, 2));
+    THttpClient client(server, "localhost", "/");
+    long before = maxRssMegabytes();
+
+    // The first reply is read completely, the second only in part and then drained by readEnd()
+    for (int i = 0; i < 2; i++) {
+        client.write(reinterpret_cast<const uint8_t*>("x"), 1);
+        client.flush();
+
+        uint32_t wanted = i == 0 ? size : 1000000;
+        uint32_t got = 0;
+        bool matches = true;
+        uint8_t buffer[65536];
+        while (got < wanted) {
+            uint32_t count = client.read(buffer, std::min<uint32_t>(sizeof(buffer), wanted - got));
+            if (count == 0) {
+                fprintf(stderr, "Short reply %d\n", i);
+                return 1;
+            }
+            for (uint32_t j = 0; j < count; j++) {
+                matches &= buffer[j] == FakeServer::bodyByte(got + j);
+            }
+            got += count;
+        }
+        client.readEnd();
+        printf("reply %d: read %u of %u bytes, %s\n", i, got, size, matches ? "data matches" : "DATA MISMATCH");
+        if (!matches) {
+            return 1;
+        }
+    }
+
+    printf("peak RSS grew by %ld MB reading %u MB bodies\n", maxRssMegabytes() - before, size >> 20);
+    return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Bytes on the wire for note sized replies with and without gzip negotiation. The decoded
+// replies are checked against each other. Run against the local stand-in:
+//
+//   python3 httpsstandin.py --port 4433 --gzip [--chunked] &
+//   bench_httpgzip 4433 [calls]
+
+#include <Thrift.h>
+#include <transport/THttpClient.h>
+#include <transport/TSSLSocket.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace apache::thrift::transport;
+
+// The stand-in doesn't answer TLS shutdowns, don't report that
+static void silent(const char *)
+{
+}
+
+static const size_t s_noteSize = 60000;
+static const size_t s_requestSize = 7;
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s PORT [CALLS]\n", argv[0]);
+        return 1;
+    }
+    int port = atoi(argv[1]);
+    int calls = argc > 2 ? atoi(argv[2]) : 100;
+
+    apache::thrift::GlobalOutput.setOutputFunction(silent);
+
+    boost::shared_ptr<TSSLSocketFactory> factory(new TSSLSocketFactory());
+    factory->authenticate(false);
+
+    std::string note;
+    for (int gzip = 1; gzip >= 0; gzip--) {
+        boost::shared_ptr<TSocket> socket = factory->createSocket("127.0.0.1", port);
+        boost::shared_ptr<TBufferedTransport> buffered(new TBufferedTransport(socket));
+        THttpClient client(buffered, "localhost", "/");
+        client.setAcceptGzip(gzip);
+        client.open();
+
+        double msecs = 0;
+        for (int i = 0; i < calls; i++) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            char request[s_requestSize + 1];
+            snprintf(request, sizeof(request), "req%04d", i % 10000);
+            client.write(reinterpret_cast<const uint8_t*>(request), s_requestSize);
+            client.flush();
+
+            // Odd sized reads, so they don't line up with what inflate produces
+            std::string reply;
+            uint8_t buffer[700];
+            while (reply.size() < s_noteSize + s_requestSize) {
+                uint32_t count = client.read(buffer, std::min<size_t>(sizeof(buffer), s_noteSize + s_requestSize - reply.size()));
+                if (count == 0) {
+                    fprintf(stderr, "Short reply %d\n", i);
+                    return 1;
+                }
+                reply.append(reinterpret_cast<char*>(buffer), count);
+            }
+            client.readEnd();
+            msecs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            if (reply.compare(s_noteSize, s_requestSize, request) != 0) {
+                fprintf(stderr, "Reply %d doesn't match its request\n", i);
+                return 1;
+            }
+            if (note.empty()) {
+                note = reply.substr(0, s_noteSize);
+            } else if (reply.compare(0, s_noteSize, note) != 0) {
+                fprintf(stderr, "Reply %d carries a different note\n", i);
+                return 1;
+            }
+        }
+        client.close();
+
+        printf("%-12s %llu bytes on the wire for %llu decoded (%.1f%%), %.3f ms/call\n",
+               gzip ? "gzip:" : "uncompressed:",
+               static_cast<unsigned long long>(client.getBodyBytesReceived()),
+               static_cast<unsigned long long>(client.getBodyBytesDecoded()),
+               100.0 * client.getBodyBytesReceived() / client.getBodyBytesDecoded(),
+               msecs / calls);
+    }
+    return 0;
+}
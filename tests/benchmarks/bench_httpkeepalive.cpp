@@ -0,0 +1,128 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Cost of a Thrift call over HTTPS with the connection kept alive, compared to opening a new
+// connection for every call. Run against the local stand-in:
+//
+//   python3 httpsstandin.py --port 4433 [--chunked] &
+//   bench_httpkeepalive 4433 [calls]
+//
+// The last scenario waits for the stand-in to drop the idle connection, which takes a few seconds.
+
+#include <Thrift.h>
+#include <transport/THttpClient.h>
+#include <transport/TSSLSocket.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+using namespace apache::thrift::transport;
+
+// The stand-in doesn't answer TLS shutdowns, don't report that for every connection
+static void silent(const char *)
+{
+}
+
+static const size_t s_padding = 3000;
+static const size_t s_requestSize = 7;
+static const size_t s_replySize = s_padding + s_requestSize + 4;
+
+// Sends one request and checks the reply carries it. Returns the stand-in's connection count.
+static int call(THttpClient *client, int i)
+{
+    char request[s_requestSize + 1];
+    snprintf(request, sizeof(request), "req%04d", i % 10000);
+    client->write(reinterpret_cast<const uint8_t*>(request), s_requestSize);
+    client->flush();
+
+    std::string reply;
+    uint8_t buffer[512];
+    while (reply.size() < s_replySize) {
+        uint32_t count = client->read(buffer, sizeof(buffer));
+        if (count == 0) {
+            break;
+        }
+        reply.append(reinterpret_cast<char*>(buffer), count);
+    }
+    client->readEnd();
+
+    if (reply.size() != s_replySize || reply.compare(s_padding, s_requestSize, request) != 0) {
+        fprintf(stderr, "Reply %d doesn't match its request\n", i);
+        exit(1);
+    }
+    return atoi(reply.c_str() + s_padding + s_requestSize);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s PORT [CALLS]\n", argv[0]);
+        return 1;
+    }
+    int port = atoi(argv[1]);
+    int calls = argc > 2 ? atoi(argv[2]) : 300;
+
+    apache::thrift::GlobalOutput.setOutputFunction(silent);
+
+    boost::shared_ptr<TSSLSocketFactory> factory(new TSSLSocketFactory());
+    factory->authenticate(false);
+
+    for (int reuse = 1; reuse >= 0; reuse--) {
+        boost::shared_ptr<TSocket> socket = factory->createSocket("127.0.0.1", port);
+        boost::shared_ptr<TBufferedTransport> buffered(new TBufferedTransport(socket));
+        THttpClient client(buffered, "localhost", "/");
+        client.open();
+
+        int firstConnection = 0;
+        int lastConnection = 0;
+        double msecs = 0;
+        for (int i = 0; i < calls; i++) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            if (!reuse && i > 0) {
+                client.close();
+                client.open();
+            }
+            lastConnection = call(&client, i);
+            msecs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (i == 0) {
+                firstConnection = lastConnection;
+            }
+        }
+        client.close();
+        printf("%-26s %6.3f ms/call, %d connections for %d calls\n",
+               reuse ? "one connection:" : "new connection per call:",
+               msecs / calls, lastConnection - firstConnection + 1, calls);
+    }
+
+    // The stand-in closes connections idle for 5 s. The next call must notice and reconnect.
+    boost::shared_ptr<TSocket> socket = factory->createSocket("127.0.0.1", port);
+    boost::shared_ptr<TBufferedTransport> buffered(new TBufferedTransport(socket));
+    THttpClient client(buffered, "localhost", "/");
+    client.setIdleTimeout(60);
+    client.open();
+    int before = call(&client, 0);
+    sleep(7);
+    int after = call(&client, 1);
+    client.close();
+    printf("%-26s %s\n", "after server closed:", after > before ? "reconnected" : "FAILED, same connection");
+    return after > before ? 0 : 1;
+}
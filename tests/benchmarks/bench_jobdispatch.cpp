@@ -0,0 +1,192 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QtTest>
+#include <QEventLoop>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+
+// Overhead of dispatching jobs which do no work. Jobs used to be QThreads, started one per job
+// and deleted once finished. Now they are runnables on the EvernoteConnection's worker pool,
+// whose threads never expire. As in the job queue, the next job is started from the main thread
+// once the previous one has finished.
+class JobDispatchBenchmark: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void threadPerJob_data();
+    void threadPerJob();
+    void workerPool_data();
+    void workerPool();
+
+private:
+    void addRows();
+};
+
+class ThreadJob: public QThread
+{
+    Q_OBJECT
+protected:
+    void run() override
+    {
+        emit jobDone();
+    }
+
+signals:
+    void jobDone();
+};
+
+class PoolJob: public QObject, public QRunnable
+{
+    Q_OBJECT
+public:
+    PoolJob()
+    {
+        // Deleted from the main thread, like the job queue does
+        setAutoDelete(false);
+    }
+
+    void run() override
+    {
+        emit jobDone();
+        emit jobFinished();
+    }
+
+signals:
+    void jobDone();
+    void jobFinished();
+};
+
+// Runs the jobs one after another and waits in an event loop until all of them are done
+class JobRunner: public QObject
+{
+    Q_OBJECT
+public:
+    JobRunner(QThreadPool *pool, int jobs):
+        m_pool(pool),
+        m_jobs(jobs),
+        m_started(0),
+        m_done(0)
+    {
+    }
+
+    void exec()
+    {
+        startNextJob();
+        m_loop.exec();
+    }
+
+    int done() const { return m_done; }
+
+private slots:
+    void jobDone()
+    {
+        m_done++;
+    }
+
+    void jobFinished()
+    {
+        // A thread emits finished() right before it ends
+        QThread *thread = qobject_cast<QThread*>(sender());
+        if (thread) {
+            thread->wait();
+        }
+        sender()->deleteLater();
+        if (m_started == m_jobs) {
+            m_loop.quit();
+        } else {
+            startNextJob();
+        }
+    }
+
+private:
+    void startNextJob()
+    {
+        m_started++;
+        if (m_pool) {
+            PoolJob *job = new PoolJob();
+            connect(job, &PoolJob::jobDone, this, &JobRunner::jobDone);
+            connect(job, &PoolJob::jobFinished, this, &JobRunner::jobFinished);
+            m_pool->start(job);
+        } else {
+            ThreadJob *job = new ThreadJob();
+            connect(job, &ThreadJob::jobDone, this, &JobRunner::jobDone);
+            connect(job, &QThread::finished, this, &JobRunner::jobFinished);
+            job->start();
+        }
+    }
+
+    QThreadPool *m_pool;
+    int m_jobs;
+    int m_started;
+    int m_done;
+    QEventLoop m_loop;
+};
+
+void JobDispatchBenchmark::addRows()
+{
+    QTest::addColumn<int>("jobs");
+
+    QTest::newRow("1 job") << 1;
+    QTest::newRow("100 jobs") << 100;
+    QTest::newRow("1000 jobs") << 1000;
+}
+
+void JobDispatchBenchmark::threadPerJob_data()
+{
+    addRows();
+}
+
+void JobDispatchBenchmark::threadPerJob()
+{
+    QFETCH(int, jobs);
+
+    QBENCHMARK {
+        JobRunner runner(nullptr, jobs);
+        runner.exec();
+        QCOMPARE(runner.done(), jobs);
+    }
+    // Let the last threads go
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+}
+
+void JobDispatchBenchmark::workerPool_data()
+{
+    addRows();
+}
+
+void JobDispatchBenchmark::workerPool()
+{
+    QFETCH(int, jobs);
+
+    QThreadPool pool;
+    pool.setExpiryTimeout(-1);
+
+    QBENCHMARK {
+        JobRunner runner(&pool, jobs);
+        runner.exec();
+        QCOMPARE(runner.done(), jobs);
+    }
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+}
+
+QTEST_GUILESS_MAIN(JobDispatchBenchmark)
+
+#include "bench_jobdispatch.moc"
@@ -0,0 +1,156 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "notedata.h"
+#include "note.h"
+#include "utils/cachesnapshot.h"
+
+#include <QtTest>
+
+#include <malloc.h>
+
+// Memory and time it takes to set up the notes of a large account at startup. The NotesStore
+// keeps a NoteData record per note and creates Note objects on demand. For comparison, a Note
+// QObject per note on top of that, as it used to be. The old Note also had a QFile and two
+// connections per note, so that's a lower bound for the old cost.
+class NoteRecordsBenchmark: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void records_data();
+    void records();
+    void objects_data();
+    void objects();
+
+private:
+    void addRows();
+
+    QList<NoteRecord> m_records;
+};
+
+static NoteRecord makeNote(int i)
+{
+    NoteRecord note;
+    note.guid = QString("0c6d3b6e-6f1a-4a5e-9f0b-%1").arg(i, 12, 10, QChar('0'));
+    note.updateSequenceNumber = 1000 + i;
+    note.lastSyncedSequenceNumber = note.updateSequenceNumber;
+    note.notebookGuid = QString("notebook-%1").arg(i % 10);
+    note.created = QDateTime(QDate(2015, 1, 1), QTime(12, 0), Qt::UTC).addSecs(i * 60);
+    note.updated = note.created.addSecs(3600);
+    note.title = QString("Note number %1").arg(i);
+    note.tagGuids << QString("tag-%1").arg(i % 20);
+    note.tagline = QString("The first few words of note %1, as they show up in the list").arg(i);
+    return note;
+}
+
+// Heap bytes in use. RSS doesn't go down when memory is freed, so it can't be compared
+// between rows.
+static qint64 heapInUse()
+{
+    return mallinfo().uordblks;
+}
+
+static QList<NoteDataPointer> createRecords(const QList<NoteRecord> &records, int count)
+{
+    QList<NoteDataPointer> notes;
+    notes.reserve(count);
+    for (int i = 0; i < count; i++) {
+        notes.append(NoteDataPointer(new NoteData(records.at(i))));
+    }
+    return notes;
+}
+
+static QList<Note*> createObjects(const QList<NoteRecord> &records, int count)
+{
+    QList<Note*> notes;
+    notes.reserve(count);
+    for (int i = 0; i < count; i++) {
+        const NoteRecord &record = records.at(i);
+        Note *note = new Note(record.guid, record.updateSequenceNumber);
+        note->setTitle(record.title);
+        note->setNotebookGuid(record.notebookGuid);
+        note->setTagGuids(record.tagGuids);
+        note->setCreated(record.created);
+        note->setUpdated(record.updated);
+        notes.append(note);
+    }
+    return notes;
+}
+
+void NoteRecordsBenchmark::initTestCase()
+{
+    for (int i = 0; i < 100000; i++) {
+        m_records.append(makeNote(i));
+    }
+}
+
+void NoteRecordsBenchmark::addRows()
+{
+    QTest::addColumn<int>("notes");
+
+    QTest::newRow("10000 notes") << 10000;
+    QTest::newRow("50000 notes") << 50000;
+    QTest::newRow("100000 notes") << 100000;
+}
+
+void NoteRecordsBenchmark::records_data()
+{
+    addRows();
+}
+
+void NoteRecordsBenchmark::records()
+{
+    QFETCH(int, notes);
+
+    qint64 before = heapInUse();
+    QList<NoteDataPointer> data = createRecords(m_records, notes);
+    qDebug() << "Records use" << (heapInUse() - before) / 1024 << "KB," << (heapInUse() - before) / notes << "bytes per note";
+    data.clear();
+
+    QBENCHMARK {
+        data = createRecords(m_records, notes);
+    }
+    QCOMPARE(data.count(), notes);
+}
+
+void NoteRecordsBenchmark::objects_data()
+{
+    addRows();
+}
+
+void NoteRecordsBenchmark::objects()
+{
+    QFETCH(int, notes);
+
+    qint64 before = heapInUse();
+    QList<Note*> objects = createObjects(m_records, notes);
+    qDebug() << "Objects use" << (heapInUse() - before) / 1024 << "KB," << (heapInUse() - before) / notes << "bytes per note";
+    qDeleteAll(objects);
+
+    QBENCHMARK {
+        objects = createObjects(m_records, notes);
+        qDeleteAll(objects);
+    }
+}
+
+QTEST_GUILESS_MAIN(NoteRecordsBenchmark)
+
+#include "bench_noterecords.moc"
@@ -0,0 +1,160 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "notedata.h"
+#include "notesnapshot.h"
+#include "notesstore.h"
+#include "resource.h"
+#include "utils/mappedfile.h"
+
+#include <QtTest>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QStandardPaths>
+#include <QThreadPool>
+
+#include <string>
+
+// Latency from saving a note to its job having the data, for a note with 20 MB of attachments.
+// The main thread takes a NoteSnapshot, which references the resources by their cached files,
+// and hands it to a worker thread. The worker maps the files while building the request.
+class NoteSnapshotBenchmark: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void snapshot();
+    void handOver();
+    void serializeResources();
+
+private:
+    NoteData m_data;
+    QStringList m_files;
+};
+
+static const int s_resourceCount = 20;
+static const int s_resourceSize = 1024 * 1024;
+
+// Runs on a pool thread like a job, keeping its own copy of the snapshot
+class SnapshotReceiver: public QRunnable
+{
+public:
+    SnapshotReceiver(const NoteSnapshot &snapshot, QSemaphore *started):
+        m_snapshot(snapshot),
+        m_started(started)
+    {
+    }
+
+    void run() override
+    {
+        NoteSnapshot snapshot = m_snapshot;
+        Q_UNUSED(snapshot);
+        m_started->release();
+    }
+
+private:
+    NoteSnapshot m_snapshot;
+    QSemaphore *m_started;
+};
+
+void NoteSnapshotBenchmark::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(QDir().mkpath(NotesStore::instance()->storageLocation()));
+
+    m_data.guid = "0c6d3b6e-6f1a-4a5e-9f0b-000000000001";
+    m_data.title = "Photos";
+    QString enml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+                   "<!DOCTYPE en-note SYSTEM \"http://xml.evernote.com/pub/enml2.dtd\"><en-note>";
+
+    for (int i = 0; i < s_resourceCount; i++) {
+        QByteArray payload(s_resourceSize, char('a' + i));
+        ResourceRecord resource;
+        resource.hash = QCryptographicHash::hash(payload, QCryptographicHash::Md5).toHex();
+        resource.fileName = QString("photo%1.jpg").arg(i);
+        resource.type = "image/jpeg";
+        resource.size = payload.size();
+        m_data.resources.append(resource);
+        enml += "<div><en-media hash=\"" + resource.hash + "\" type=\"image/jpeg\"/></div>";
+
+        QFile file(Resource::cachePath(resource.hash, resource.fileName));
+        QVERIFY(file.open(QFile::WriteOnly));
+        QCOMPARE(file.write(payload), qint64(payload.size()));
+        m_files.append(file.fileName());
+    }
+    enml += "</en-note>";
+    m_data.content.setEnml(enml);
+}
+
+void NoteSnapshotBenchmark::cleanupTestCase()
+{
+    foreach (const QString &fileName, m_files) {
+        QFile::remove(fileName);
+    }
+}
+
+void NoteSnapshotBenchmark::snapshot()
+{
+    NoteSnapshot snapshot;
+    QBENCHMARK {
+        snapshot = NoteSnapshot(m_data);
+    }
+    QCOMPARE(snapshot.resources().count(), s_resourceCount);
+}
+
+void NoteSnapshotBenchmark::handOver()
+{
+    QThreadPool pool;
+    pool.setMaxThreadCount(1);
+    QSemaphore started;
+
+    // Warm up the thread, a job pool keeps its threads around
+    pool.start(new SnapshotReceiver(NoteSnapshot(m_data), &started));
+    started.acquire();
+
+    QBENCHMARK {
+        pool.start(new SnapshotReceiver(NoteSnapshot(m_data), &started));
+        started.acquire();
+    }
+}
+
+void NoteSnapshotBenchmark::serializeResources()
+{
+    NoteSnapshot snapshot(m_data);
+    qint64 total = 0;
+    QBENCHMARK {
+        total = 0;
+        for (int i = 0; i < s_resourceCount; i++) {
+            // What SaveNoteJob does to fill in the thrift request
+            MappedFile data = snapshot.resourceData(i);
+            std::string body(data.data(), data.size());
+            total += body.size();
+        }
+    }
+    QCOMPARE(total, qint64(s_resourceCount) * s_resourceSize);
+}
+
+QTEST_GUILESS_MAIN(NoteSnapshotBenchmark)
+
+#include "bench_notesnapshot.moc"
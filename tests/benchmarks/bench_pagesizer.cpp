@@ -0,0 +1,119 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Simulated time to list all notes of a large account. Compares the old listing, 50 notes per
+// page fetched strictly one after another, to pages sized by the real PageSizer with two of
+// them in flight, as NotesStore does it. The model has one connection serving requests in
+// order, a fixed round trip per request, transfer time per note and the time merging a note
+// takes on the main thread.
+//
+//   bench_pagesizer [notes]
+
+#include "utils/pagesizer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+
+struct Link
+{
+    const char *name;
+    double roundTrip;
+    double perNote;
+};
+
+static const double s_mergePerNote = 0.15;
+static const int s_pagesInFlight = 2;
+
+static double sequential(int total, const Link &link)
+{
+    double msecs = 0;
+    for (int offset = 0; offset < total; offset += 50) {
+        int count = std::min(50, total - offset);
+        msecs += link.roundTrip + count * link.perNote + count * s_mergePerNote;
+    }
+    return msecs;
+}
+
+static double pipelined(int total, const Link &link, int *pages, int *lastPageSize)
+{
+    struct Page
+    {
+        int count;
+        double duration;
+        double done;
+    };
+
+    // Same parameters as NotesStore's
+    PageSizer pageSizer(25, 50, 250, 2000);
+    std::deque<Page> inFlight;
+    double connectionFree = 0;
+    int offset = 0;
+    *pages = 0;
+
+    // The first page goes out alone, it tells how many notes there are
+    int count = std::min(pageSizer.pageSize(), total);
+    double duration = link.roundTrip + count * link.perNote;
+    inFlight.push_back({count, duration, duration});
+    connectionFree = duration;
+    offset = pageSizer.pageSize();
+    (*pages)++;
+
+    double now = 0;
+    while (!inFlight.empty()) {
+        Page page = inFlight.front();
+        inFlight.pop_front();
+        now = std::max(now, page.done);
+        pageSizer.addSample(page.count, static_cast<qint64>(page.duration));
+
+        // The next pages are requested before this one is merged
+        while (static_cast<int>(inFlight.size()) < s_pagesInFlight && offset < total) {
+            int size = pageSizer.pageSize();
+            int count = std::min(size, total - offset);
+            double duration = link.roundTrip + count * link.perNote;
+            connectionFree = std::max(now, connectionFree) + duration;
+            inFlight.push_back({count, duration, connectionFree});
+            offset += size;
+            (*pages)++;
+        }
+        now += page.count * s_mergePerNote;
+    }
+    *lastPageSize = pageSizer.pageSize();
+    return now;
+}
+
+int main(int argc, char **argv)
+{
+    int total = argc > 1 ? atoi(argv[1]) : 40000;
+    const Link links[] = {
+        { "80 ms RTT", 80, 0.05 },
+        { "300 ms RTT", 300, 0.4 },
+        { "600 ms RTT", 600, 1.5 }
+    };
+
+    printf("Listing %d notes\n", total);
+    for (const Link &link : links) {
+        int pages = 0;
+        int lastPageSize = 0;
+        double adaptive = pipelined(total, link, &pages, &lastPageSize);
+        printf("%-11s sequential/50 %6.1f s   pipelined/adaptive %6.1f s in %d pages, last page size %d\n",
+               link.name, sequential(total, link) / 1000, adaptive / 1000, pages, lastPageSize);
+    }
+    return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Bookkeeping cost of reconciling a full notes listing with the local notes. The listing
+// holds all local notes but a few, in random order. Std containers stand in for the Qt ones
+// NotesStore uses, the operations are the same:
+//  old: a list of unhandled guids, removeAll() for every listed note, and two indexOf()
+//       lookups in the note list plus a removal for every leftover
+//  new: a set of unhandled guids, a remove() for every listed note, and all leftovers
+//       dropped in one pass over the note list
+//
+//   bench_reconcile [notes] [gone]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds(Clock::time_point from, Clock::time_point to)
+{
+    return std::chrono::duration<double>(to - from).count();
+}
+
+static std::string createGuid(std::mt19937_64 &random)
+{
+    char guid[37];
+    snprintf(guid, sizeof(guid), "%08x-%04x-%04x-%04x-%012llx",
+             static_cast<unsigned>(random()), static_cast<unsigned>(random() & 0xffff),
+             static_cast<unsigned>(random() & 0xffff), static_cast<unsigned>(random() & 0xffff),
+             static_cast<unsigned long long>(random() & 0xffffffffffffULL));
+    return guid;
+}
+
+int main(int argc, char **argv)
+{
+    int total = argc > 1 ? atoi(argv[1]) : 100000;
+    int gone = argc > 2 ? atoi(argv[2]) : 1000;
+
+    std::mt19937_64 random(42);
+    std::vector<std::string> localNotes;
+    for (int i = 0; i < total; i++) {
+        localNotes.push_back(createGuid(random));
+    }
+    // The first ones were deleted on the server
+    std::vector<std::string> listing(localNotes.begin() + gone, localNotes.end());
+    std::shuffle(listing.begin(), listing.end(), random);
+
+    printf("%d local notes, %d of them gone from the server\n", total, gone);
+
+    {
+        Clock::time_point start = Clock::now();
+        std::vector<std::string> unhandled = localNotes;
+        std::vector<std::string> notes = localNotes;
+        for (const std::string &guid : listing) {
+            unhandled.erase(std::remove(unhandled.begin(), unhandled.end(), guid), unhandled.end());
+        }
+        Clock::time_point listed = Clock::now();
+        for (const std::string &guid : unhandled) {
+            // remoteNoteGone() and removeNote() both looked the note up
+            std::find(notes.begin(), notes.end(), guid);
+            notes.erase(std::find(notes.begin(), notes.end(), guid));
+        }
+        Clock::time_point done = Clock::now();
+        printf("old: %.3f s for the listing, %.3f s for the leftovers, %zu notes left\n",
+               seconds(start, listed), seconds(listed, done), notes.size());
+    }
+
+    {
+        Clock::time_point start = Clock::now();
+        std::unordered_set<std::string> unhandled(localNotes.begin(), localNotes.end());
+        std::vector<std::string> notes = localNotes;
+        for (const std::string &guid : listing) {
+            unhandled.erase(guid);
+        }
+        Clock::time_point listed = Clock::now();
+        std::vector<std::string> remaining;
+        remaining.reserve(notes.size());
+        for (const std::string &guid : notes) {
+            if (!unhandled.count(guid)) {
+                remaining.push_back(guid);
+            }
+        }
+        notes.swap(remaining);
+        Clock::time_point done = Clock::now();
+        printf("new: %.3f s for the listing, %.3f s for the leftovers, %zu notes left\n",
+               seconds(start, listed), seconds(listed, done), notes.size());
+    }
+    return 0;
+}
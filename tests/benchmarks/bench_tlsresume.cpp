@@ -0,0 +1,114 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Cost of connecting when all sockets come from one TSSLSocketFactory, which resumes TLS
+// sessions, compared to a factory per socket, which does a full handshake every time. Each
+// connect is followed by two calls. Run against the local stand-in:
+//
+//   python3 httpsstandin.py --port 4433 &
+//   bench_tlsresume 4433 [connects]
+
+#include <Thrift.h>
+#include <transport/THttpClient.h>
+#include <transport/TSSLSocket.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace apache::thrift::transport;
+
+// The stand-in doesn't answer TLS shutdowns, don't report that for every connection
+static void silent(const char *)
+{
+}
+
+static const size_t s_replySize = 3000 + 7 + 4;
+
+static void call(THttpClient *client)
+{
+    client->write(reinterpret_cast<const uint8_t*>("req0000"), 7);
+    client->flush();
+
+    std::string reply;
+    uint8_t buffer[512];
+    while (reply.size() < s_replySize) {
+        uint32_t count = client->read(buffer, sizeof(buffer));
+        if (count == 0) {
+            fprintf(stderr, "Short reply\n");
+            exit(1);
+        }
+        reply.append(reinterpret_cast<char*>(buffer), count);
+    }
+    client->readEnd();
+}
+
+static boost::shared_ptr<TSSLSocketFactory> createFactory()
+{
+    boost::shared_ptr<TSSLSocketFactory> factory(new TSSLSocketFactory());
+    factory->authenticate(false);
+    return factory;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s PORT [CONNECTS]\n", argv[0]);
+        return 1;
+    }
+    int port = atoi(argv[1]);
+    int connects = argc > 2 ? atoi(argv[2]) : 200;
+
+    apache::thrift::GlobalOutput.setOutputFunction(silent);
+
+    for (int shared = 1; shared >= 0; shared--) {
+        boost::shared_ptr<TSSLSocketFactory> sharedFactory = createFactory();
+        uint64_t full = 0;
+        uint64_t resumed = 0;
+        double msecs = 0;
+
+        for (int i = 0; i < connects; i++) {
+            boost::shared_ptr<TSSLSocketFactory> factory = shared ? sharedFactory : createFactory();
+            boost::shared_ptr<TSocket> socket = factory->createSocket("127.0.0.1", port);
+            boost::shared_ptr<TBufferedTransport> buffered(new TBufferedTransport(socket));
+            THttpClient client(buffered, "localhost", "/");
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            client.open();
+            call(&client);
+            call(&client);
+            msecs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            client.close();
+
+            if (!shared) {
+                full += factory->fullHandshakes();
+                resumed += factory->resumedHandshakes();
+            }
+        }
+        if (shared) {
+            full = sharedFactory->fullHandshakes();
+            resumed = sharedFactory->resumedHandshakes();
+        }
+
+        printf("%-20s %6.3f ms per connect and 2 calls, %llu full and %llu resumed handshakes\n",
+               shared ? "shared factory:" : "factory per socket:", msecs / connects,
+               static_cast<unsigned long long>(full), static_cast<unsigned long long>(resumed));
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+# -*- Mode: Python; coding: utf-8; indent-tabs-mode: nil; tab-width: 4 -*-
+#
+# Copyright: 2015 Canonical, Ltd
+#
+# This file is part of reminders
+#
+# reminders is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; version 3.
+#
+# reminders is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+"""Local HTTPS stand-in for the Evernote servers, used by the HTTP benchmarks.
+
+Every POST is answered with 3000 bytes of padding, followed by the request
+body and the number of connections accepted so far, right aligned in four
+characters. The client can check that it got its own reply back and see
+whether its calls shared a connection. Idle connections are closed after
+five seconds, which is announced with "Keep-Alive: timeout=5".
+
+With --gzip the padding is a 60000 byte ENML-like note instead, and the
+reply is gzip compressed if the request accepts it.
+
+A self-signed certificate is created with the openssl tool unless one is
+given with --cert and --key.
+"""
+
+import argparse
+import gzip
+import http.server
+import os
+import random
+import ssl
+import subprocess
+import tempfile
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    timeout = 5
+    wbufsize = 65536
+    disable_nagle_algorithm = True
+
+    connections = 0
+    chunked = False
+    note = None
+
+    def setup(self):
+        Handler.connections += 1
+        super().setup()
+
+    def do_POST(self):
+        request = self.rfile.read(int(self.headers['Content-Length']))
+        body = self.make_body(request)
+        compress = (self.note is not None and
+                    "gzip" in self.headers.get("Accept-Encoding", ""))
+        if compress:
+            body = gzip.compress(body)
+
+        self.send_response(200)
+        self.send_header("Content-Type", "application/x-thrift")
+        if compress:
+            self.send_header("Content-Encoding", "gzip")
+        self.send_header("Keep-Alive", "timeout=%d" % self.timeout)
+        if self.chunked:
+            self.send_header("Transfer-Encoding", "chunked")
+            self.end_headers()
+            for i in range(0, len(body), 1000):
+                chunk = body[i:i + 1000]
+                self.wfile.write(b"%x\r\n" % len(chunk) + chunk + b"\r\n")
+            self.wfile.write(b"0\r\n\r\n")
+        else:
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+    def make_body(self, request):
+        if self.note is not None:
+            return self.note + request
+        return (b"x" * 3000 + request +
+                str(Handler.connections).encode().rjust(4))
+
+    def log_message(self, *args):
+        pass
+
+
+def make_note(size):
+    random.seed(1)
+    words = ("note notebook tag resource guid en-note div span todo checked "
+             "reminder title content created updated").split()
+    divs = "".join("<div>%s %s %d</div>" % (random.choice(words),
+                                           random.choice(words),
+                                           random.randint(0, 99999))
+                   for _ in range(size // 20))
+    note = '<?xml version="1.0"?><en-note>' + divs + "</en-note>"
+    return note.encode()[:size]
+
+
+def make_certificate(directory):
+    cert = os.path.join(directory, "cert.pem")
+    key = os.path.join(directory, "key.pem")
+    subprocess.check_call(
+        ["openssl", "req", "-x509", "-newkey", "rsa:2048", "-nodes",
+         "-subj", "/CN=localhost", "-days", "1",
+         "-keyout", key, "-out", cert],
+        stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    return cert, key
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", type=int, default=4433)
+    parser.add_argument("--chunked", action="store_true",
+                        help="send replies with chunked transfer encoding")
+    parser.add_argument("--gzip", action="store_true",
+                        help="reply with a note, compressed if accepted")
+    parser.add_argument("--cert")
+    parser.add_argument("--key")
+    args = parser.parse_args()
+
+    Handler.chunked = args.chunked
+    if args.gzip:
+        Handler.note = make_note(60000)
+
+    with tempfile.TemporaryDirectory() as directory:
+        cert, key = args.cert, args.key
+        if not cert:
+            cert, key = make_certificate(directory)
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(cert, key)
+
+        server = http.server.ThreadingHTTPServer(("127.0.0.1", args.port),
+                                                 Handler)
+        server.socket = context.wrap_socket(server.socket, server_side=True)
+        print("Listening on https://127.0.0.1:%d" % args.port, flush=True)
+        try:
+            server.serve_forever()
+        except KeyboardInterrupt:
+            pass
+
+
+if __name__ == "__main__":
+    main()
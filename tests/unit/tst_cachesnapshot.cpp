@@ -0,0 +1,340 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/cachesnapshot.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtTest>
+
+static const quint32 s_magic = 0x4E534E50;
+
+// Writes the records the way older versions of the snapshot did
+class LegacyWriter
+{
+public:
+    LegacyWriter(QIODevice *device, quint32 version): m_stream(device), m_version(version)
+    {
+        m_stream.setVersion(QDataStream::Qt_5_0);
+        m_stream << s_magic << version;
+    }
+
+    void write(const QList<NotebookRecord> &notebooks, const QList<TagRecord> &tags,
+               const QList<NoteRecord> &notes, const SyncStateRecord &syncState)
+    {
+        m_stream << notebooks << tags;
+        m_stream << (quint32)notes.count();
+        foreach (const NoteRecord &note, notes) {
+            writeNote(note);
+        }
+        if (m_version >= 2) {
+            m_stream << syncState;
+        }
+    }
+
+private:
+    void writeNote(const NoteRecord &record)
+    {
+        m_stream << record.guid
+                 << record.updateSequenceNumber
+                 << record.lastSyncedSequenceNumber
+                 << record.notebookGuid
+                 << record.created
+                 << record.updated
+                 << record.title
+                 << record.tagGuids
+                 << record.reminderOrder
+                 << record.reminderTime
+                 << record.reminderDoneTime
+                 << record.deleted
+                 << record.needsContentSync
+                 << record.tagline;
+        m_stream << (quint32)record.resources.count();
+        foreach (const ResourceRecord &resource, record.resources) {
+            m_stream << resource.hash << resource.fileName << resource.type;
+            if (m_version >= 3) {
+                m_stream << resource.guid << resource.size;
+            }
+        }
+        if (m_version >= 4) {
+            m_stream << record.contentHash << record.contentLength;
+        }
+    }
+
+    QDataStream m_stream;
+    quint32 m_version;
+};
+
+class CacheSnapshotTest: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void roundTrip();
+    void loadOlderVersion_data();
+    void loadOlderVersion();
+    void rejectInvalid_data();
+    void rejectInvalid();
+
+private:
+    QString snapshotFile() const;
+    void fill(CacheSnapshot *snapshot) const;
+
+    QTemporaryDir *m_dir;
+};
+
+void CacheSnapshotTest::init()
+{
+    m_dir = new QTemporaryDir;
+    QVERIFY(m_dir->isValid());
+}
+
+void CacheSnapshotTest::cleanup()
+{
+    delete m_dir;
+}
+
+QString CacheSnapshotTest::snapshotFile() const
+{
+    return m_dir->path() + "/notes.snapshot";
+}
+
+void CacheSnapshotTest::fill(CacheSnapshot *snapshot) const
+{
+    NotebookRecord notebook;
+    notebook.guid = "notebook-1";
+    notebook.updateSequenceNumber = 12;
+    notebook.lastSyncedSequenceNumber = 11;
+    notebook.name = "Travel";
+    notebook.published = true;
+    notebook.lastUpdated = QDateTime(QDate(2015, 3, 1), QTime(10, 0), Qt::UTC);
+    notebook.isDefaultNotebook = true;
+    snapshot->notebooks.append(notebook);
+
+    TagRecord tag;
+    tag.guid = "tag-1";
+    tag.updateSequenceNumber = 13;
+    tag.lastSyncedSequenceNumber = 13;
+    tag.name = "todo";
+    snapshot->tags.append(tag);
+
+    NoteRecord note;
+    note.guid = "note-1";
+    note.updateSequenceNumber = 20;
+    note.lastSyncedSequenceNumber = 19;
+    note.notebookGuid = notebook.guid;
+    note.created = QDateTime(QDate(2015, 3, 2), QTime(9, 30), Qt::UTC);
+    note.updated = QDateTime(QDate(2015, 3, 4), QTime(18, 15), Qt::UTC);
+    note.title = "Packing list";
+    note.tagGuids << tag.guid;
+    note.reminderOrder = 1425300000000;
+    note.reminderTime = QDateTime(QDate(2015, 3, 5), QTime(8, 0), Qt::UTC);
+    note.needsContentSync = true;
+    note.tagline = "Passport, tickets";
+    ResourceRecord resource;
+    resource.hash = "0123456789abcdef0123456789abcdef";
+    resource.fileName = "map.png";
+    resource.type = "image/png";
+    resource.guid = "resource-1";
+    resource.size = 48213;
+    note.resources.append(resource);
+    note.contentHash = QByteArray::fromHex("fedcba9876543210fedcba9876543210");
+    note.contentLength = 1234;
+    snapshot->notes.append(note);
+
+    NoteRecord deletedNote;
+    deletedNote.guid = "note-2";
+    deletedNote.notebookGuid = notebook.guid;
+    deletedNote.title = "Old";
+    deletedNote.deleted = true;
+    snapshot->notes.append(deletedNote);
+
+    snapshot->syncState.updateCount = 20;
+    snapshot->syncState.lastSyncTime = QDateTime(QDate(2015, 3, 4), QTime(18, 20), Qt::UTC);
+}
+
+void CacheSnapshotTest::roundTrip()
+{
+    CacheSnapshot saved;
+    fill(&saved);
+    QVERIFY(saved.save(snapshotFile()));
+
+    CacheSnapshot loaded;
+    QVERIFY(loaded.load(snapshotFile()));
+
+    QCOMPARE(loaded.notebooks.count(), 1);
+    const NotebookRecord &notebook = loaded.notebooks.first();
+    QCOMPARE(notebook.guid, saved.notebooks.first().guid);
+    QCOMPARE(notebook.updateSequenceNumber, 12);
+    QCOMPARE(notebook.lastSyncedSequenceNumber, 11);
+    QCOMPARE(notebook.name, QStringLiteral("Travel"));
+    QCOMPARE(notebook.published, true);
+    QCOMPARE(notebook.lastUpdated, saved.notebooks.first().lastUpdated);
+    QCOMPARE(notebook.isDefaultNotebook, true);
+    QCOMPARE(notebook.deleted, false);
+
+    QCOMPARE(loaded.tags.count(), 1);
+    QCOMPARE(loaded.tags.first().guid, QStringLiteral("tag-1"));
+    QCOMPARE(loaded.tags.first().name, QStringLiteral("todo"));
+    QCOMPARE(loaded.tags.first().updateSequenceNumber, 13);
+
+    QCOMPARE(loaded.notes.count(), 2);
+    const NoteRecord &note = loaded.notes.first();
+    const NoteRecord &savedNote = saved.notes.first();
+    QCOMPARE(note.guid, savedNote.guid);
+    QCOMPARE(note.updateSequenceNumber, savedNote.updateSequenceNumber);
+    QCOMPARE(note.lastSyncedSequenceNumber, savedNote.lastSyncedSequenceNumber);
+    QCOMPARE(note.notebookGuid, savedNote.notebookGuid);
+    QCOMPARE(note.created, savedNote.created);
+    QCOMPARE(note.updated, savedNote.updated);
+    QCOMPARE(note.title, savedNote.title);
+    QCOMPARE(note.tagGuids, savedNote.tagGuids);
+    QCOMPARE(note.reminderOrder, savedNote.reminderOrder);
+    QCOMPARE(note.reminderTime, savedNote.reminderTime);
+    QVERIFY(note.reminderDoneTime.isNull());
+    QCOMPARE(note.deleted, false);
+    QCOMPARE(note.needsContentSync, true);
+    QCOMPARE(note.tagline, savedNote.tagline);
+    QCOMPARE(note.resources.count(), 1);
+    QCOMPARE(note.resources.first().hash, savedNote.resources.first().hash);
+    QCOMPARE(note.resources.first().fileName, savedNote.resources.first().fileName);
+    QCOMPARE(note.resources.first().type, savedNote.resources.first().type);
+    QCOMPARE(note.resources.first().guid, savedNote.resources.first().guid);
+    QCOMPARE(note.resources.first().size, savedNote.resources.first().size);
+    QCOMPARE(note.contentHash, savedNote.contentHash);
+    QCOMPARE(note.contentLength, savedNote.contentLength);
+    QCOMPARE(loaded.notes.last().deleted, true);
+
+    QCOMPARE(loaded.syncState.updateCount, 20);
+    QCOMPARE(loaded.syncState.lastSyncTime, saved.syncState.lastSyncTime);
+}
+
+void CacheSnapshotTest::loadOlderVersion_data()
+{
+    QTest::addColumn<quint32>("version");
+
+    QTest::newRow("version 1") << (quint32)1;
+    QTest::newRow("version 2") << (quint32)2;
+    QTest::newRow("version 3") << (quint32)3;
+}
+
+void CacheSnapshotTest::loadOlderVersion()
+{
+    QFETCH(quint32, version);
+
+    CacheSnapshot saved;
+    fill(&saved);
+    QFile file(snapshotFile());
+    QVERIFY(file.open(QFile::WriteOnly));
+    LegacyWriter writer(&file, version);
+    writer.write(saved.notebooks, saved.tags, saved.notes, saved.syncState);
+    file.close();
+
+    CacheSnapshot loaded;
+    QVERIFY(loaded.load(snapshotFile()));
+    QCOMPARE(loaded.notebooks.count(), 1);
+    QCOMPARE(loaded.notebooks.first().name, QStringLiteral("Travel"));
+    QCOMPARE(loaded.tags.count(), 1);
+    QCOMPARE(loaded.tags.first().name, QStringLiteral("todo"));
+    QCOMPARE(loaded.notes.count(), 2);
+
+    const NoteRecord &note = loaded.notes.first();
+    QCOMPARE(note.guid, QStringLiteral("note-1"));
+    QCOMPARE(note.title, QStringLiteral("Packing list"));
+    QCOMPARE(note.tagline, QStringLiteral("Passport, tickets"));
+    QCOMPARE(note.resources.count(), 1);
+    QCOMPARE(note.resources.first().hash, saved.notes.first().resources.first().hash);
+    QCOMPARE(note.resources.first().type, QStringLiteral("image/png"));
+    // Not stored before version 4
+    QVERIFY(note.contentHash.isEmpty());
+    QCOMPARE(note.contentLength, 0);
+    QCOMPARE(loaded.notes.last().guid, QStringLiteral("note-2"));
+    QCOMPARE(loaded.notes.last().deleted, true);
+
+    if (version >= 3) {
+        QCOMPARE(note.resources.first().guid, QStringLiteral("resource-1"));
+        QCOMPARE(note.resources.first().size, (qint64)48213);
+    } else {
+        QVERIFY(note.resources.first().guid.isEmpty());
+        QCOMPARE(note.resources.first().size, (qint64)0);
+    }
+
+    if (version >= 2) {
+        QCOMPARE(loaded.syncState.updateCount, 20);
+        QCOMPARE(loaded.syncState.lastSyncTime, saved.syncState.lastSyncTime);
+    } else {
+        QCOMPARE(loaded.syncState.updateCount, 0);
+        QVERIFY(loaded.syncState.lastSyncTime.isNull());
+    }
+
+    // Saving again writes the current version, the data survives that
+    QVERIFY(loaded.save(snapshotFile()));
+    CacheSnapshot reloaded;
+    QVERIFY(reloaded.load(snapshotFile()));
+    QCOMPARE(reloaded.notes.count(), 2);
+    QCOMPARE(reloaded.notes.first().title, QStringLiteral("Packing list"));
+}
+
+void CacheSnapshotTest::rejectInvalid_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    // init() doesn't run for the data functions
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    CacheSnapshot snapshot;
+    fill(&snapshot);
+    QVERIFY(snapshot.save(dir.path() + "/notes.snapshot"));
+    QFile file(dir.path() + "/notes.snapshot");
+    QVERIFY(file.open(QFile::ReadOnly));
+    QByteArray valid = file.readAll();
+
+    QByteArray badMagic = valid;
+    badMagic[0] = 'X';
+    QByteArray futureVersion = valid;
+    futureVersion[7] = 99;
+
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("bad magic") << badMagic;
+    QTest::newRow("version 0") << QByteArray::fromHex("4e534e5000000000");
+    QTest::newRow("future version") << futureVersion;
+    QTest::newRow("truncated") << valid.left(valid.size() - 5);
+}
+
+void CacheSnapshotTest::rejectInvalid()
+{
+    QFETCH(QByteArray, data);
+
+    QFile file(snapshotFile());
+    QVERIFY(file.open(QFile::WriteOnly | QFile::Truncate));
+    file.write(data);
+    file.close();
+
+    CacheSnapshot loaded;
+    QVERIFY(!loaded.load(snapshotFile()));
+    QVERIFY(loaded.notes.isEmpty());
+    QVERIFY(loaded.notebooks.isEmpty());
+    QVERIFY(loaded.tags.isEmpty());
+}
+
+QTEST_GUILESS_MAIN(CacheSnapshotTest)
+
+#include "tst_cachesnapshot.moc"
@@ -0,0 +1,116 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/contentcompressor.h"
+
+#include <QtEndian>
+#include <QtTest>
+
+static const char s_enml[] =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+        "<!DOCTYPE en-note SYSTEM \"http://xml.evernote.com/pub/enml2.dtd\">"
+        "<en-note><div>Shopping</div><div><en-todo checked=\"false\"/>Milk<br/></div>"
+        "<div><en-todo checked=\"true\"/>Bread<br/></div>"
+        "<div><en-media hash=\"0123456789abcdef0123456789abcdef\" type=\"image/png\"/></div></en-note>";
+
+class ContentCompressorTest: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip_data();
+    void roundTrip();
+    void plainContent();
+    void rejectDamaged_data();
+    void rejectDamaged();
+};
+
+void ContentCompressorTest::roundTrip_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    QByteArray random(256 * 1024, Qt::Uninitialized);
+    qsrand(42);
+    for (int i = 0; i < random.size(); i++) {
+        random[i] = qrand() & 0xff;
+    }
+
+    QTest::newRow("empty") << QByteArray("");
+    QTest::newRow("note") << QByteArray(s_enml);
+    QTest::newRow("long note") << QByteArray(s_enml).repeated(500);
+    QTest::newRow("incompressible") << random;
+}
+
+void ContentCompressorTest::roundTrip()
+{
+    QFETCH(QByteArray, data);
+
+    QByteArray compressed = ContentCompressor::compress(data);
+    QVERIFY(!compressed.isNull());
+    QVERIFY(ContentCompressor::isCompressed(compressed));
+    QCOMPARE(ContentCompressor::uncompress(compressed), data);
+}
+
+void ContentCompressorTest::plainContent()
+{
+    QByteArray enml(s_enml);
+    QVERIFY(!ContentCompressor::isCompressed(enml));
+    QVERIFY(ContentCompressor::uncompress(enml).isNull());
+
+    // The dictionary is what makes small notes worth compressing
+    QVERIFY(ContentCompressor::compress(enml).size() < enml.size() / 2);
+}
+
+void ContentCompressorTest::rejectDamaged_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    QByteArray compressed = ContentCompressor::compress(QByteArray(s_enml).repeated(10));
+    QByteArray badMagic = compressed;
+    badMagic[3] = '2';
+    QByteArray tooLarge = compressed;
+    qToBigEndian<quint32>(0x7fffffff, reinterpret_cast<uchar*>(tooLarge.data() + 4));
+    QByteArray shorter = compressed;
+    qToBigEndian<quint32>(qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(compressed.constData() + 4)) - 1,
+                          reinterpret_cast<uchar*>(shorter.data() + 4));
+    QByteArray longer = compressed;
+    qToBigEndian<quint32>(qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(compressed.constData() + 4)) + 1,
+                          reinterpret_cast<uchar*>(longer.data() + 4));
+    QByteArray corrupt = compressed;
+    corrupt[compressed.size() / 2] = corrupt.at(compressed.size() / 2) ^ 0x55;
+
+    QTest::newRow("header only") << compressed.left(8);
+    QTest::newRow("partial header") << compressed.left(6);
+    QTest::newRow("bad magic") << badMagic;
+    QTest::newRow("size too large") << tooLarge;
+    QTest::newRow("size too small") << shorter;
+    QTest::newRow("size too big") << longer;
+    QTest::newRow("truncated") << compressed.left(compressed.size() - 10);
+    QTest::newRow("corrupt") << corrupt;
+}
+
+void ContentCompressorTest::rejectDamaged()
+{
+    QFETCH(QByteArray, data);
+
+    QVERIFY(ContentCompressor::uncompress(data).isNull());
+}
+
+QTEST_GUILESS_MAIN(ContentCompressorTest)
+
+#include "tst_contentcompressor.moc"
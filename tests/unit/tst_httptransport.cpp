@@ -0,0 +1,186 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <transport/THttpClient.h>
+#include <transport/TBufferTransports.h>
+#include <transport/TVirtualTransport.h>
+
+#include <QtTest>
+
+#include <string>
+
+using namespace apache::thrift::transport;
+
+// Answers every request with a response whose body repeats the letter of the connection
+// it was sent on. Data arrives in packets of different sizes, like from a network.
+class FakeServer: public TVirtualTransport<FakeServer>
+{
+public:
+    static const uint32_t s_bodySize = 200000;
+    static const uint32_t s_chunkSize = 1000;
+
+    FakeServer(bool chunked, bool connectionClose, uint32_t hangupAt):
+        m_chunked(chunked), m_connectionClose(connectionClose), m_hangupAt(hangupAt),
+        m_connections(0), m_open(false), m_pos(0) {}
+
+    bool isOpen() { return m_open; }
+    void open() { m_open = true; m_connections++; m_data.clear(); m_pos = 0; }
+    void close() { m_open = false; }
+    void write(const uint8_t*, uint32_t) {}
+
+    void flush()
+    {
+        char letter = 'A' + m_connections;
+        m_data += "HTTP/1.1 200 OK\r\n";
+        if (m_connectionClose) {
+            m_data += "Connection: close\r\n";
+        }
+        if (m_chunked) {
+            m_data += "Transfer-Encoding: chunked\r\n\r\n";
+            for (uint32_t sent = 0; sent < s_bodySize; sent += s_chunkSize) {
+                m_data += QByteArray::number(std::min(s_chunkSize, s_bodySize - sent), 16).toStdString() + "\r\n";
+                m_data.append(std::min(s_chunkSize, s_bodySize - sent), letter);
+                m_data += "\r\n";
+            }
+            m_data += "0\r\n\r\n";
+        } else {
+            m_data += "Content-Length: " + QByteArray::number(s_bodySize).toStdString() + "\r\n\r\n";
+            m_data.append(s_bodySize, letter);
+        }
+        if (m_connectionClose) {
+            // Whatever comes after the response is not to be read any more
+            m_data += "HTTP/1.1 400 Bad Request\r\n\r\n";
+        }
+    }
+
+    uint32_t read(uint8_t* buf, uint32_t len)
+    {
+        if (m_hangupAt > 0 && m_connections == 1 && m_pos >= m_hangupAt) {
+            return 0;
+        }
+        uint32_t packet = 400 + (m_pos * 7919) % 1200;
+        uint32_t n = std::min<uint32_t>(std::min(len, packet), m_data.size() - m_pos);
+        memcpy(buf, m_data.data() + m_pos, n);
+        m_pos += n;
+        return n;
+    }
+
+    int connections() const { return m_connections; }
+
+private:
+    bool m_chunked;
+    bool m_connectionClose;
+    uint32_t m_hangupAt;
+    int m_connections;
+    bool m_open;
+    std::string m_data;
+    size_t m_pos;
+};
+
+const uint32_t FakeServer::s_bodySize;
+const uint32_t FakeServer::s_chunkSize;
+
+static int s_refills = 0;
+static int s_interruptAt = 0;
+
+static bool interruptCheck()
+{
+    return ++s_refills == s_interruptAt;
+}
+
+class HttpTransportTest: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void reconnect_data();
+    void reconnect();
+};
+
+void HttpTransportTest::reconnect_data()
+{
+    QTest::addColumn<bool>("chunked");
+    QTest::addColumn<int>("interruptAt");
+    QTest::addColumn<uint32_t>("hangupAt");
+    QTest::addColumn<bool>("connectionClose");
+
+    for (int chunked = 0; chunked < 2; chunked++) {
+        const char *framing = chunked ? "chunked" : "content-length";
+        // A cancelled job stops reading in the middle of a response
+        for (int interruptAt = 1; interruptAt <= 12; interruptAt++) {
+            QTest::newRow(QString("%1, interrupted at refill %2").arg(framing).arg(interruptAt).toLatin1())
+                    << (bool)chunked << interruptAt << (uint32_t)0 << false;
+        }
+        QTest::newRow(QString("%1, hangup in the body").arg(framing).toLatin1())
+                << (bool)chunked << 0 << (uint32_t)3000 << false;
+        QTest::newRow(QString("%1, connection close").arg(framing).toLatin1())
+                << (bool)chunked << 0 << (uint32_t)0 << true;
+    }
+}
+
+void HttpTransportTest::reconnect()
+{
+    QFETCH(bool, chunked);
+    QFETCH(int, interruptAt);
+    QFETCH(uint32_t, hangupAt);
+    QFETCH(bool, connectionClose);
+
+    boost::shared_ptr<FakeServer> server(new FakeServer(chunked, connectionClose, hangupAt));
+    // A read buffer larger than what THttpTransport asks for, so input is left over in it
+    boost::shared_ptr<TBufferedTransport> buffered(new TBufferedTransport(server, 4096));
+    THttpClient http(buffered, "localhost", "/");
+    http.setInterruptCheck(interruptCheck);
+    http.open();
+    s_refills = 0;
+    s_interruptAt = interruptAt;
+
+    // The first response is read to the end only with "Connection: close"
+    http.write((const uint8_t*)"x", 1);
+    http.flush();
+    try {
+        uint8_t buf[16];
+        uint32_t got = 0;
+        while (got < FakeServer::s_bodySize) {
+            got += http.read(buf, std::min<uint32_t>(sizeof(buf), FakeServer::s_bodySize - got));
+        }
+        http.readEnd();
+        QVERIFY(connectionClose);
+    } catch (const TTransportException &) {
+        QVERIFY(!connectionClose);
+    }
+
+    // The next request goes out on a new connection and gets its own response only
+    s_interruptAt = 0;
+    http.write((const uint8_t*)"x", 1);
+    http.flush();
+    QByteArray body(FakeServer::s_bodySize, '\0');
+    uint32_t got = 0;
+    while (got < FakeServer::s_bodySize) {
+        uint32_t n = http.read((uint8_t*)body.data() + got, FakeServer::s_bodySize - got);
+        QVERIFY(n > 0);
+        got += n;
+    }
+    http.readEnd();
+
+    QCOMPARE(server->connections(), 2);
+    QCOMPARE(body, QByteArray(FakeServer::s_bodySize, 'A' + 2));
+}
+
+QTEST_GUILESS_MAIN(HttpTransportTest)
+
+#include "tst_httptransport.moc"
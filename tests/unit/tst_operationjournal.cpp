@@ -0,0 +1,189 @@
+/*
+ * Copyright: 2015 Canonical, Ltd
+ *
+ * This file is part of reminders
+ *
+ * reminders is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 3.
+ *
+ * reminders is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/operationjournal.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtTest>
+
+class OperationJournalTest: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void replay();
+    void damagedTail_data();
+    void damagedTail();
+    void compaction();
+
+private:
+    QString journalFile() const;
+
+    QTemporaryDir *m_dir;
+};
+
+void OperationJournalTest::init()
+{
+    m_dir = new QTemporaryDir;
+    QVERIFY(m_dir->isValid());
+}
+
+void OperationJournalTest::cleanup()
+{
+    delete m_dir;
+}
+
+QString OperationJournalTest::journalFile() const
+{
+    return m_dir->path() + "/journal";
+}
+
+void OperationJournalTest::replay()
+{
+    OperationJournal journal;
+    journal.open(journalFile());
+    QCOMPARE(journal.pending().count(), 0);
+
+    quint64 create = journal.append(OperationJournal::OperationCreateNote, "local-1");
+    quint64 save = journal.append(OperationJournal::OperationSaveNote, "local-1");
+    quint64 tag = journal.append(OperationJournal::OperationTagNote, "note-2", "tag-1");
+    journal.append(OperationJournal::OperationDeleteNote, "note-3");
+    QCOMPARE(journal.lastSequence(), (quint64)4);
+
+    journal.renameGuid("local-1", "note-1");
+    journal.acknowledge("note-1", create);
+    journal.acknowledge("note-3", journal.lastSequence());
+    journal.close();
+
+    journal.open(journalFile());
+    QList<OperationJournal::Entry> pending = journal.pending();
+    QCOMPARE(pending.count(), 2);
+    QCOMPARE(pending.at(0).sequence, save);
+    QCOMPARE(pending.at(0).operation, OperationJournal::OperationSaveNote);
+    QCOMPARE(pending.at(0).guid, QStringLiteral("note-1"));
+    QCOMPARE(pending.at(1).sequence, tag);
+    QCOMPARE(pending.at(1).operation, OperationJournal::OperationTagNote);
+    QCOMPARE(pending.at(1).guid, QStringLiteral("note-2"));
+    QCOMPARE(pending.at(1).argument, QStringLiteral("tag-1"));
+
+    // Sequence numbers keep counting up from where they were
+    QCOMPARE(journal.lastSequence(), (quint64)4);
+    QCOMPARE(journal.append(OperationJournal::OperationSaveNote, "note-2"), (quint64)5);
+}
+
+void OperationJournalTest::damagedTail_data()
+{
+    QTest::addColumn<int>("cut");
+    QTest::addColumn<bool>("flip");
+
+    // Crashing while appending leaves part of a record behind
+    QTest::newRow("partial header") << 3 << false;
+    QTest::newRow("partial payload") << 10 << false;
+    QTest::newRow("bad checksum") << 0 << true;
+}
+
+void OperationJournalTest::damagedTail()
+{
+    QFETCH(int, cut);
+    QFETCH(bool, flip);
+
+    OperationJournal journal;
+    journal.open(journalFile());
+    journal.append(OperationJournal::OperationSaveNote, "note-1");
+    journal.append(OperationJournal::OperationSaveNote, "note-2");
+    journal.close();
+
+    QFile file(journalFile());
+    qint64 intactSize = file.size();
+
+    journal.open(journalFile());
+    journal.append(OperationJournal::OperationSaveNote, "note-3");
+    journal.close();
+
+    QVERIFY(file.open(QFile::ReadWrite));
+    if (cut > 0) {
+        QVERIFY(file.resize(intactSize + cut));
+    }
+    if (flip) {
+        file.seek(file.size() - 1);
+        char last;
+        file.getChar(&last);
+        file.seek(file.size() - 1);
+        file.putChar(last ^ 0x01);
+    }
+    file.close();
+
+    journal.open(journalFile());
+    QCOMPARE(journal.pending().count(), 2);
+    QCOMPARE(QFile(journalFile()).size(), intactSize);
+
+    // New records go right after the last good one
+    journal.append(OperationJournal::OperationSaveNote, "note-4");
+    journal.close();
+    journal.open(journalFile());
+    QList<OperationJournal::Entry> pending = journal.pending();
+    QCOMPARE(pending.count(), 3);
+    QCOMPARE(pending.last().guid, QStringLiteral("note-4"));
+}
+
+void OperationJournalTest::compaction()
+{
+    OperationJournal journal;
+    journal.open(journalFile());
+
+    // Acknowledging most of the operations makes the journal compact itself several
+    // times. Renames and acknowledges keep coming in while the worker writes the
+    // compacted file.
+    QMap<quint64, QString> expected;
+    for (int i = 0; i < 5000; i++) {
+        QString guid = QStringLiteral("local-%1").arg(i);
+        quint64 sequence = journal.append(OperationJournal::OperationCreateNote, guid);
+        if (i % 3 == 0) {
+            QString newGuid = QStringLiteral("note-%1").arg(i);
+            journal.renameGuid(guid, newGuid);
+            guid = newGuid;
+        }
+        if (i % 10 != 0) {
+            journal.acknowledge(guid, sequence);
+        } else {
+            expected.insert(sequence, guid);
+        }
+    }
+    journal.close();
+
+    QFile file(journalFile());
+    // Without compaction, 5000 creations, 4500 acknowledges and 1667 renames take over 450 KB
+    QVERIFY(file.size() < 200 * 1024);
+
+    journal.open(journalFile());
+    QList<OperationJournal::Entry> pending = journal.pending();
+    QCOMPARE(pending.count(), expected.count());
+    for (int i = 0; i < pending.count(); i++) {
+        QVERIFY(expected.contains(pending.at(i).sequence));
+        QCOMPARE(pending.at(i).guid, expected.value(pending.at(i).sequence));
+    }
+    QCOMPARE(journal.lastSequence(), (quint64)5000);
+}
+
+QTEST_GUILESS_MAIN(OperationJournalTest)
+
+#include "tst_operationjournal.moc"